@@ -44,6 +44,7 @@
 #include "utils/Hub.hxx"
 #include "utils/GcTcpHub.hxx"
 #include "utils/ClientConnection.hxx"
+#include "utils/SocketCanHub.hxx"
 #include "executor/Executor.hxx"
 #include "executor/Service.hxx"
 
@@ -58,6 +59,7 @@ OVERRIDE_CONST(gridconnect_buffer_delay_usec, 2000);
 
 int port = 12021;
 const char *device_path = nullptr;
+const char *socketcan_ifname = nullptr;
 int upstream_port = 12021;
 const char *upstream_host = nullptr;
 bool timestamped = false;
@@ -68,7 +70,8 @@ bool printpackets = false;
 void usage(const char *e)
 {
     fprintf(stderr, "Usage: %s [-p port] [-d device_path] [-u upstream_host] "
-                    "[-q upstream_port] [-m] [-n mdns_name] [-t] [-l]\n\n",
+                    "[-q upstream_port] [-s can_interface] [-m] [-n mdns_name] "
+                    "[-t] [-l]\n\n",
             e);
     fprintf(stderr, "GridConnect CAN HUB.\nListens to a specific TCP port, "
                     "reads CAN packets from the incoming connections using "
@@ -79,6 +82,11 @@ void usage(const char *e)
     fprintf(stderr, "\t-d device   is a path to a physical device doing "
                     "serial-CAN or USB-CAN. If specified, opens device and "
                     "adds it to the hub.\n");
+#if defined(__linux__)
+    fprintf(stderr, "\t-s can_interface   is the name of a SocketCAN network "
+                    "interface, such as can0. If specified, adds it to the "
+                    "hub.\n");
+#endif
     fprintf(stderr, "\t-u upstream_host   is the host name for an upstream "
                     "hub. If specified, this hub will connect to an upstream "
                     "hub.\n");
@@ -100,7 +108,7 @@ void usage(const char *e)
 void parse_args(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "hp:d:u:q:tlmn:")) >= 0)
+    while ((opt = getopt(argc, argv, "hp:d:u:q:s:tlmn:")) >= 0)
     {
         switch (opt)
         {
@@ -110,6 +118,9 @@ void parse_args(int argc, char *argv[])
             case 'd':
                 device_path = optarg;
                 break;
+            case 's':
+                socketcan_ifname = optarg;
+                break;
             case 'p':
                 port = atoi(optarg);
                 break;
@@ -178,6 +189,19 @@ int appl_main(int argc, char *argv[])
             new DeviceConnectionClient("device", &can_hub0, device_path));
     }
 
+#if defined(__linux__)
+    if (socketcan_ifname)
+    {
+        int fd = SocketCanHubPort::open_socket(socketcan_ifname);
+        if (fd < 0)
+        {
+            perror(socketcan_ifname);
+            exit(1);
+        }
+        new SocketCanHubPort(&can_hub0, fd);
+    }
+#endif
+
     while (1)
     {
         for (const auto &p : connections)
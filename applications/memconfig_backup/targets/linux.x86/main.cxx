@@ -0,0 +1,447 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file main.cxx
+ *
+ * An application for backing up and restoring the memory spaces of every
+ * node on the bus, talking to many nodes at the same time.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+#include "os/os.h"
+#include "utils/constants.hxx"
+#include "utils/Hub.hxx"
+#include "utils/GridConnectHub.hxx"
+#include "utils/FileUtils.hxx"
+#include "utils/StringPrintf.hxx"
+#include "executor/Executor.hxx"
+#include "executor/Service.hxx"
+
+#include "openlcb/IfCan.hxx"
+#include "openlcb/DatagramCan.hxx"
+#include "openlcb/If.hxx"
+#include "openlcb/AliasAllocator.hxx"
+#include "openlcb/ConfigUpdateFlow.hxx"
+#include "openlcb/DefaultNode.hxx"
+#include "openlcb/NodeBrowser.hxx"
+#include "openlcb/MemoryConfig.hxx"
+#include "openlcb/MemoryConfigBackup.hxx"
+#include "utils/socket_listener.hxx"
+
+NO_THREAD nt;
+Executor<1> g_executor(nt);
+Service g_service(&g_executor);
+CanHubFlow can_hub0(&g_service);
+
+static const openlcb::NodeID NODE_ID = 0x05010101181EULL;
+/// Node ID of the first simulated node.
+static const openlcb::NodeID VIRTUAL_NODE_ID_BASE = 0x050101011A00ULL;
+
+openlcb::IfCan g_if_can(&g_executor, &can_hub0, 3, 1000, 2);
+openlcb::InitializeFlow g_init_flow{&g_service};
+static openlcb::AddAliasAllocator g_alias_allocator(NODE_ID, &g_if_can);
+openlcb::DefaultNode g_node(&g_if_can, NODE_ID);
+openlcb::ConfigUpdateFlow g_config_flow(&g_if_can);
+
+namespace openlcb
+{
+Pool *const g_incoming_datagram_allocator = mainBufferPool;
+}
+
+static int port = 12021;
+static const char *host = "localhost";
+static const char *device_path = nullptr;
+static const char *filename = nullptr;
+static std::vector<uint8_t> memory_spaces;
+static unsigned parallelism = 8;
+static unsigned max_pending = 2;
+static unsigned discovery_msec = 1000;
+static unsigned virtual_node_count = 0;
+static unsigned virtual_space_size = 1024;
+static unsigned latency_msec = 0;
+static bool use_streams = false;
+static bool do_backup = false;
+static bool do_restore = false;
+
+void usage(const char *e)
+{
+    fprintf(stderr,
+        "Usage: %s ([-i destination_host] [-p port] | [-d device_path] | [-V "
+        "count [-z size] [-L msec]]) [-s memory_space_id[,memory_space_id...]] "
+        "[-j "
+        "parallel] [-q pending] [-t msec] [-S] (-b|-r) -f filename\n",
+        e);
+    fprintf(stderr, "Connects to an openlcb bus, discovers all nodes, and "
+                    "backs up (-b) the given memory spaces of every node into "
+                    "a file, or restores (-r) a previously made backup.\n");
+    fprintf(stderr,
+        "The bus connection will be through an OpenLCB HUB on "
+        "destination_host:port with OpenLCB over TCP "
+        "(in GridConnect format) protocol, or through the CAN-USB device "
+        "(also in GridConnect protocol) found at device_path. Device takes "
+        "precedence over TCP host:port specification.");
+    fprintf(stderr, "The default target is localhost:12021.\n");
+    fprintf(stderr, "-V count simulates a bus with count virtual nodes in "
+                    "this process instead of connecting anywhere. Each "
+                    "virtual node has a config memory space (0xFD) of size "
+                    "bytes (-z, default 1024). -L msec delays every CAN frame "
+                    "between the virtual nodes and us, like a bus behind "
+                    "gateways.\n");
+    fprintf(stderr, "memory_space_id defines which memory spaces to back up, "
+                    "as comma separated hex numbers. Spaces that a node does "
+                    "not have are skipped. Default is '-s FD'.\n");
+    fprintf(stderr, "-j parallel is how many nodes to talk to at the same "
+                    "time (default 8).\n");
+    fprintf(stderr, "-q pending is how many read/write datagrams to keep "
+                    "outstanding per node (default 2).\n");
+    fprintf(stderr, "-t msec is how long to wait for nodes to respond to the "
+                    "discovery (default 1000).\n");
+    fprintf(stderr, "-S uses stream reads for the backup where the node "
+                    "supports them. Restore always uses datagram writes.\n");
+    fprintf(stderr, "-b or -r  defines whether to back up or restore.\n");
+    exit(1);
+}
+
+void parse_args(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "hp:i:d:V:z:L:s:j:q:t:Sf:br")) >= 0)
+    {
+        switch (opt)
+        {
+            case 'h':
+                usage(argv[0]);
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'i':
+                host = optarg;
+                break;
+            case 'd':
+                device_path = optarg;
+                break;
+            case 'V':
+                virtual_node_count = atoi(optarg);
+                break;
+            case 'z':
+                virtual_space_size = atoi(optarg);
+                break;
+            case 'L':
+                latency_msec = atoi(optarg);
+                break;
+            case 's':
+            {
+                char *p = optarg;
+                while (*p)
+                {
+                    char *end;
+                    memory_spaces.push_back(strtol(p, &end, 16));
+                    if (end == p || (*end && *end != ','))
+                    {
+                        usage(argv[0]);
+                    }
+                    p = *end ? end + 1 : end;
+                }
+                break;
+            }
+            case 'j':
+                parallelism = atoi(optarg);
+                break;
+            case 'q':
+                max_pending = atoi(optarg);
+                break;
+            case 't':
+                discovery_msec = atoi(optarg);
+                break;
+            case 'S':
+                use_streams = true;
+                break;
+            case 'f':
+                filename = optarg;
+                break;
+            case 'b':
+                do_backup = true;
+                break;
+            case 'r':
+                do_restore = true;
+                break;
+            default:
+                fprintf(stderr, "Unknown option %c\n", opt);
+                usage(argv[0]);
+        }
+    }
+    if (!filename || !parallelism)
+    {
+        usage(argv[0]);
+    }
+    if ((do_backup ? 1 : 0) + (do_restore ? 1 : 0) != 1)
+    {
+        fprintf(stderr, "Must set exactly one of option -b and option -r.\n\n");
+        usage(argv[0]);
+    }
+    if (memory_spaces.empty())
+    {
+        memory_spaces.push_back(openlcb::MemoryConfigDefs::SPACE_CONFIG);
+    }
+}
+
+/// Forwards CAN frames from one hub to another with a fixed delay.
+class LatencyLink : public StateFlow<Buffer<CanHubData>, QList<1>>
+{
+public:
+    /// Constructor.
+    /// @param from hub to take the frames from.
+    /// @param to hub to deliver the frames to.
+    /// @param latency_nsec delay of each frame.
+    LatencyLink(CanHubFlow *from, CanHubFlow *to, long long latency_nsec)
+        : StateFlow<Buffer<CanHubData>, QList<1>>(from->service())
+        , to_(to)
+        , latencyNsec_(latency_nsec)
+    {
+        from->register_port(this);
+    }
+
+    /// Sets the link that carries frames the other way, so that we do not
+    /// bounce frames back. @param peer the other link.
+    void set_peer(LatencyLink *peer)
+    {
+        peer_ = peer;
+    }
+
+    void send(Buffer<CanHubData> *msg, unsigned prio = UINT_MAX) override
+    {
+        arrivals_.push_back(os_get_time_monotonic());
+        StateFlow<Buffer<CanHubData>, QList<1>>::send(msg, prio);
+    }
+
+private:
+    Action entry() override
+    {
+        long long due = arrivals_.front() + latencyNsec_;
+        arrivals_.pop_front();
+        long long now = os_get_time_monotonic();
+        if (due > now)
+        {
+            return sleep_and_call(&timer_, due - now, STATE(forward));
+        }
+        return call_immediately(STATE(forward));
+    }
+
+    Action forward()
+    {
+        message()->data()->skipMember_ = peer_;
+        to_->send(transfer_message());
+        return exit();
+    }
+
+    /// Where to deliver the frames.
+    CanHubFlow *to_;
+    /// Link in the opposite direction.
+    LatencyLink *peer_{nullptr};
+    /// How long to delay each frame.
+    long long latencyNsec_;
+    /// Arrival time of the queued frames.
+    std::deque<long long> arrivals_;
+    /// Helper for sleeping.
+    StateFlowTimer timer_{this};
+};
+
+/// A simulated node with a config memory space, attached to a CAN hub with
+/// its own interface.
+class VirtualNode
+{
+public:
+    /// Constructor. @param executor where the node's flows run; @param hub
+    /// the simulated bus; @param id node ID; @param size size of the config
+    /// space.
+    VirtualNode(ExecutorBase *executor, CanHubFlow *hub, openlcb::NodeID id,
+        unsigned size)
+        : iface_(executor, hub, 3, 20, 1)
+        , alloc_(id, &iface_)
+        , node_(&iface_, id)
+        , data_(size, 0)
+    {
+        for (unsigned i = 0; i < size; ++i)
+        {
+            data_[i] = (id * 13 + i * 7) & 0xff;
+        }
+        memCfg_.registry()->insert(
+            &node_, openlcb::MemoryConfigDefs::SPACE_CONFIG, &space_);
+        iface_.add_addressed_message_support();
+        iface_.alias_allocator()->send(iface_.alias_allocator()->alloc());
+    }
+
+private:
+    openlcb::IfCan iface_;
+    openlcb::AddAliasAllocator alloc_;
+    openlcb::DefaultNode node_;
+    openlcb::CanDatagramService dg_{&iface_, 2, 2};
+    openlcb::MemoryConfigHandler memCfg_{&dg_, &node_, 1};
+    string data_;
+    openlcb::ReadWriteMemoryBlock space_{&data_[0], (unsigned)data_.size()};
+};
+
+/// Prints the result of a backup or restore operation.
+/// @param backup the finished operation.
+/// @param what name of the operation for the printout.
+void print_stats(openlcb::MemoryConfigBackup *backup, const char *what)
+{
+    for (const auto &f : backup->failures())
+    {
+        fprintf(stderr, "Node %012" PRIx64 " space 0x%02x: error %04x\n",
+            f.node, f.space, f.error);
+    }
+    double sec = backup->elapsed_nsec() / 1e9;
+    fprintf(stderr,
+        "%s: %u records, %u failed, %" PRIu64 " bytes in %.3f sec, "
+        "%.0f bytes/sec.\n",
+        what, (unsigned)backup->records().size(),
+        (unsigned)backup->failures().size(), backup->total_bytes(), sec,
+        sec > 0 ? backup->total_bytes() / sec : 0);
+}
+
+/** Entry point to application.
+ * @param argc number of command line arguments
+ * @param argv array of command line arguments
+ * @return 0, should never return
+ */
+int appl_main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+    std::vector<openlcb::MemoryConfigArchive::Record> records;
+    if (do_restore &&
+        !openlcb::MemoryConfigArchive::parse(
+            read_file_to_string(filename), &records))
+    {
+        fprintf(stderr, "File %s is not a valid backup archive.\n", filename);
+        return 1;
+    }
+    // The objects created here are never freed, because the executor threads
+    // keep running until the process exits.
+    if (virtual_node_count)
+    {
+        // The virtual nodes run on a separate thread so that they are not
+        // competing with the backup tool for the executor.
+        auto *sim_executor = new Executor<1>(nt);
+        CanHubFlow *sim_hub = &can_hub0;
+        if (latency_msec)
+        {
+            sim_hub = new CanHubFlow(new Service(sim_executor));
+            auto *up =
+                new LatencyLink(sim_hub, &can_hub0, MSEC_TO_NSEC(latency_msec));
+            auto *down =
+                new LatencyLink(&can_hub0, sim_hub, MSEC_TO_NSEC(latency_msec));
+            up->set_peer(down);
+            down->set_peer(up);
+        }
+        for (unsigned i = 0; i < virtual_node_count; ++i)
+        {
+            new VirtualNode(sim_executor, sim_hub, VIRTUAL_NODE_ID_BASE + i,
+                virtual_space_size);
+        }
+        sim_executor->start_thread("sim_executor", 0, 1024);
+    }
+    else
+    {
+        int conn_fd = 0;
+        if (device_path)
+        {
+            conn_fd = ::open(device_path, O_RDWR);
+        }
+        else
+        {
+            conn_fd = ConnectSocket(host, port);
+        }
+        HASSERT(conn_fd >= 0);
+        create_gc_port_for_can_hub(&can_hub0, conn_fd);
+    }
+
+    // Every parallel transfer needs a datagram client, plus one for the
+    // memory config handler's responses.
+    auto *datagram_can =
+        new openlcb::CanDatagramService(&g_if_can, 10, parallelism + 1);
+    auto *memcfg = new openlcb::MemoryConfigHandler(datagram_can, &g_node, 10);
+    auto &backup =
+        *new openlcb::MemoryConfigBackup(&g_node, memcfg, parallelism);
+    backup.set_max_pending(max_pending);
+    backup.set_use_streams(use_streams);
+
+    g_if_can.add_addressed_message_support();
+    // Bootstraps the alias allocation process.
+    g_if_can.alias_allocator()->send(g_if_can.alias_allocator()->alloc());
+
+    g_executor.start_thread("g_executor", 0, 1024);
+    usleep(400000);
+
+    SyncNotifiable n;
+    if (do_backup)
+    {
+        auto *browser = new openlcb::NodeBrowser(
+            &g_node, [&backup](openlcb::NodeID id) { backup.add_node(id); });
+        g_executor.sync_run([browser]() { browser->refresh(); });
+        usleep(discovery_msec * 1000);
+        g_executor.sync_run([&backup, &n]() {
+            fprintf(stderr, "Found %u nodes.\n",
+                (unsigned)backup.nodes().size());
+            backup.start_backup(memory_spaces, &n);
+        });
+        n.wait_for_notification();
+        string archive = openlcb::MemoryConfigArchive::header();
+        for (const auto &r : backup.records())
+        {
+            openlcb::MemoryConfigArchive::append(&archive, r);
+        }
+        write_string_to_file(filename, archive);
+        print_stats(&backup, "Backup");
+        fprintf(stderr, "Written %" PRIdPTR " bytes to file %s.\n",
+            archive.size(), filename);
+    }
+    else
+    {
+        g_executor.sync_run([&backup, &records, &n]() {
+            backup.start_restore(std::move(records), &n);
+        });
+        n.wait_for_notification();
+        print_stats(&backup, "Restore");
+    }
+
+    // The executors still have flows and timers running, so we skip the
+    // destructors of the global objects.
+    fflush(stdout);
+    _exit(backup.failures().empty() ? 0 : 1);
+    return 0;
+}
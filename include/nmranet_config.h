@@ -78,6 +78,17 @@ DECLARE_CONST(executor_select_prescaler);
  */
 DECLARE_CONST(executor_max_sleep_msec);
 
+/** Whether Executors should use epoll instead of select to wait for file
+ * descriptors (Linux only). The cost of a wakeup is then proportional to the
+ * number of ready FDs instead of the total number of watched FDs, and there
+ * is no FD_SETSIZE limit. Timer precision drops to milliseconds. */
+DECLARE_CONST(executor_use_epoll);
+
+/** Whether the main buffer pool should be a SlabPool with per-thread caches
+ * instead of a DynamicPool (pthread hosts only). Helps when many threads
+ * allocate and free buffers. */
+DECLARE_CONST(main_buffer_pool_use_slab);
+
 /** Number of packets to queue in the CANbus device driver for send. Each packet
  * takes 16 bytes of RAM. */
 DECLARE_CONST(can_tx_buffer_size);
@@ -116,6 +127,39 @@ DECLARE_CONST(gridconnect_buffer_delay_usec);
  * two threads per client (multi-threaded) execution model. */
 DECLARE_CONST(gridconnect_tcp_use_select);
 
+/** Maximum number of queued event messages (event reports, producer /
+ * consumer identified, identify events etc) that the event service processes
+ * back-to-back without yielding to the executor. Higher values help getting
+ * through the message storms after an Identify Events, lower values reduce
+ * the latency of other work on the same executor. */
+DECLARE_CONST(event_service_batch_size);
+
+/** Number of frames the GcCanRoutingHub queues for each port before it starts
+ * dropping new normal and low priority messages to that port. Control and
+ * high priority frames are dropped at twice this depth. */
+DECLARE_CONST(routing_hub_port_queue_depth);
+
+/** How long (in msec) a port of the GcCanRoutingHub has to be quiet after a
+ * Consumer/Producer Identified or an Initialization Complete before event
+ * reports are filtered for it. Until then the port gets every event report,
+ * so that nodes still identifying their consumers do not miss events. */
+DECLARE_CONST(routing_hub_event_settle_msec);
+
+/** Maximum number of aliases the alias allocator checks at the same time.
+ * All of them send their CID frames back-to-back and share one 200 msec
+ * wait. */
+DECLARE_CONST(alias_allocator_batch_size);
+
+/** Number of aliases a SimpleCanStack reserves at startup. Nodes created
+ * later (e.g. virtual train nodes) take their alias from this pool; each
+ * taken alias is replaced in the background. */
+DECLARE_CONST(reserved_alias_pool_size);
+
+/** If non-zero, the alias allocator holds back replacing taken aliases while
+ * at least this many reserved aliases are available, and then replaces them
+ * all in one batch. */
+DECLARE_CONST(reserved_alias_low_water);
+
 /** Number of entries in the remote alias cache */
 DECLARE_CONST(remote_alias_cache_size);
 
@@ -137,6 +181,11 @@ DECLARE_CONST(num_datagram_clients);
  * datagram handler. */
 DECLARE_CONST(num_memory_spaces);
 
+/** Window size in bytes for memory config reads and writes using streams. The
+ * memory config server allocates a buffer of this size while a stream
+ * transfer is in progress. */
+DECLARE_CONST(memory_config_stream_window);
+
 /** Set to CONSTANT_TRUE if you want to export an "all memory" memory space
  * from the SimpleStack. */
 DECLARE_CONST(enable_all_memory_space);
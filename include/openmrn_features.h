@@ -64,6 +64,13 @@
 #define OPENMRN_FEATURE_EXECUTOR_SELECT
 #endif
 
+#if defined(__linux__) && !defined(__EMSCRIPTEN__) && OPENMRN_HAVE_PSELECT
+/// Compiles support for using ::epoll_pwait instead of ::pselect in the
+/// Executor. Whether it is actually used is decided by the
+/// executor_use_epoll constant.
+#define OPENMRN_HAVE_EPOLL 1
+#endif
+
 #if (defined(ARDUINO) && !defined(ESP32)) || defined(ESP_NONOS) ||             \
     defined(__EMSCRIPTEN__)
 /// A loop() function is calling the executor in the single-threaded OS context.
@@ -107,6 +114,34 @@
 #endif
 #endif
 
+#if OPENMRN_FEATURE_THREAD_PTHREAD
+/// Uses a hierarchical timing wheel in ActiveTimers instead of a sorted
+/// list. Costs a few kilobytes of RAM per executor, but makes scheduling and
+/// cancelling timers O(1).
+#define OPENMRN_FEATURE_TIMER_WHEEL 1
+/// Compiles the SlabPool, a main buffer pool with per-thread caches. Whether
+/// it is actually used is decided by the main_buffer_pool_use_slab constant.
+#define OPENMRN_FEATURE_SLAB_POOL 1
+#endif
+
+#if OPENMRN_FEATURE_THREAD_PTHREAD && !defined(OPENMRN_FEATURE_POOLED_PAYLOAD)
+/// Grows the largest bucket of the main buffer pool to fit the buffer of a
+/// datagram-sized message payload, so that long payloads are recycled by the
+/// pool. This makes every pooled GenMessage a few dozen bytes bigger, so it
+/// is off on MCUs, where long payloads are malloc'd instead. Can be turned on
+/// by defining it to 1 in the build flags.
+#define OPENMRN_FEATURE_POOLED_PAYLOAD 1
+#endif
+
+#if OPENMRN_FEATURE_THREAD_PTHREAD && OPENMRN_HAVE_PSELECT
+/// Compiles the MultiThreadExecutor, which runs executables on a pool of
+/// worker threads, and the locking it needs in ExecutorBase.
+#define OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR 1
+/// Uses a lock-free multi-producer single-consumer queue for Executor::add()
+/// and wakes up the executor thread only when it is parked in select.
+#define OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE 1
+#endif
+
 #if defined(__linux__) || defined(__MACH__) || defined(__FreeRTOS__) ||        \
     defined(ESP32)
 /// Compiles support for BSD sockets API.
@@ -139,6 +174,12 @@
 #define OPENMRN_FEATURE_BSD_SOCKETS_REPORT_EOF_ERROR 1
 #endif
 
+#if (defined(__linux__) || defined(__MACH__)) && !defined(__EMSCRIPTEN__)
+/// Compiles support in HubDeviceSelect for writing several queued buffers
+/// with one writev() (or sendmmsg() on linux datagram sockets) call.
+#define OPENMRN_FEATURE_HUB_WRITE_COALESCING 1
+#endif
+
 #endif
 
 
@@ -71,4 +71,127 @@ StateFlowBase::Action LocalTrackIfSelect::entry() {
     return write_repeated(&helper_, fd_, p, sizeof(*p), STATE(finish));
 }
 
+LocalTrackIfBatch::LocalTrackIfBatch(Service *service, int pool_size,
+    unsigned max_batch, long long max_latency_nsec)
+    : LocalTrackIf(service, pool_size)
+    , maxBatch_(max_batch)
+    , maxLatency_(max_latency_nsec)
+    , batch_(new dcc::Packet[max_batch])
+{
+    HASSERT(max_batch > 0);
+}
+
+void LocalTrackIfBatch::send(Buffer<dcc::Packet> *msg, unsigned prio)
+{
+    LocalTrackIf::send(msg, prio);
+    AtomicHolder h(this);
+    if (waiting_ && !wakeupPending_)
+    {
+        // The timer can only be touched on the executor.
+        wakeupPending_ = true;
+        service()->executor()->add(&wakeup_);
+    }
+}
+
+void LocalTrackIfBatch::Wakeup::run()
+{
+    {
+        AtomicHolder h(parent_);
+        parent_->wakeupPending_ = false;
+    }
+    parent_->timer_.ensure_triggered();
+}
+
+StateFlowBase::Action LocalTrackIfBatch::entry()
+{
+    HASSERT(fd_ >= 0);
+    if (!count_)
+    {
+        deadline_ = os_get_time_monotonic() + maxLatency_;
+    }
+    batch_[count_++] = *message()->data();
+    // The packet is copied, so the buffer can go back to the pool and the
+    // update loop can generate the next packet.
+    release();
+    return call_immediately(STATE(maybe_flush));
+}
+
+StateFlowBase::Action LocalTrackIfBatch::maybe_flush()
+{
+    if (count_ >= maxBatch_)
+    {
+        return call_immediately(STATE(flush));
+    }
+    long long now = os_get_time_monotonic();
+    if (now >= deadline_)
+    {
+        return call_immediately(STATE(flush));
+    }
+    {
+        AtomicHolder h(this);
+        if (!queue_empty())
+        {
+            // Takes the next packet into the batch.
+            return exit();
+        }
+        waiting_ = true;
+    }
+    return sleep_and_call(&timer_, deadline_ - now, STATE(wait_done));
+}
+
+StateFlowBase::Action LocalTrackIfBatch::wait_done()
+{
+    {
+        AtomicHolder h(this);
+        waiting_ = false;
+    }
+    return call_immediately(STATE(maybe_flush));
+}
+
+StateFlowBase::Action LocalTrackIfBatch::flush()
+{
+    size_t len = count_ * sizeof(dcc::Packet);
+    const uint8_t *buf = reinterpret_cast<const uint8_t *>(batch_.get());
+    ssize_t ret = ::write(fd_, buf, len);
+    if (ret == (ssize_t)len)
+    {
+        return call_immediately(STATE(write_done));
+    }
+    if (ret < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            LOG(WARNING, "LocalTrackIfBatch: write error %d, dropping %u "
+                         "packets", errno, count_);
+            count_ = 0;
+            return exit();
+        }
+        ret = 0;
+    }
+    // The device is full. The rest of the batch is written when it becomes
+    // writable; until then no new packets are taken from the queue.
+    ++numBlocked_;
+    blocked_ = true;
+    return write_repeated(
+        &helper_, fd_, buf + ret, len - ret, STATE(write_done));
+}
+
+StateFlowBase::Action LocalTrackIfBatch::write_done()
+{
+    blocked_ = false;
+    if (helper_.hasError_)
+    {
+        LOG(WARNING, "LocalTrackIfBatch: write error, dropping %u packets",
+            count_);
+        helper_.hasError_ = 0;
+    }
+    else
+    {
+        numPackets_ += count_;
+        ++numWrites_;
+    }
+    count_ = 0;
+    return exit();
+}
+
 } // namespace dcc
@@ -36,6 +36,9 @@
 #ifndef _DCC_LOCALTRACKIF_HXX_
 #define _DCC_LOCALTRACKIF_HXX_
 
+#include <atomic>
+#include <memory>
+
 #include "executor/Executor.hxx"
 #include "executor/StateFlow.hxx"
 #include "dcc/Packet.hxx"
@@ -114,6 +117,133 @@ protected:
     StateFlowSelectHelper helper_{this};
 };
 
+/// StateFlow that accepts dcc::Packet structures and sends them to a local
+/// device in batches: several packets are collected and written to the device
+/// with a single write() call.
+///
+/// This is meant for devices that accept a stream of dcc::Packet structures,
+/// such as a pipe or character device to a userspace DCC generator under
+/// Linux. The device must support the select() model and the fd must be in
+/// non-blocking mode.
+///
+/// A batch is written when it has max_batch packets, or when the first packet
+/// in the batch has waited max_latency_nsec. Packets arriving in the meantime
+/// are added to the batch. While the device does not accept data, the
+/// incoming packets stay in the queue, so the pool (and therefore the update
+/// loop) is throttled.
+class LocalTrackIfBatch : public LocalTrackIf
+{
+public:
+    /** Constructs a batching TrackInterface.
+     *
+     * @param service Usually the main executor.
+     * @param pool_size will determine how many packets the current flow's
+     * alloc() will have.
+     * @param max_batch is the maximum number of packets in a write() call.
+     * @param max_latency_nsec is how long a packet may wait for more packets
+     * to arrive before the batch is written out.
+     */
+    LocalTrackIfBatch(Service *service, int pool_size, unsigned max_batch = 8,
+        long long max_latency_nsec = MSEC_TO_NSEC(1));
+
+    /// @return the number of packets written to the device.
+    unsigned num_packets()
+    {
+        return numPackets_;
+    }
+
+    /// @return the number of write() calls that completed a batch.
+    unsigned num_writes()
+    {
+        return numWrites_;
+    }
+
+    /// @return how many times the device did not accept a batch right away,
+    /// i.e. we had to wait for the device to become writable.
+    unsigned num_blocked()
+    {
+        return numBlocked_;
+    }
+
+    /// @return true if we are currently waiting for the device to accept
+    /// data.
+    bool is_blocked()
+    {
+        return blocked_;
+    }
+
+    /// Wakes up the batch timer when a packet arrives while we are waiting.
+    void send(Buffer<dcc::Packet> *msg, unsigned prio = UINT_MAX) OVERRIDE;
+
+protected:
+    Action entry() OVERRIDE;
+
+private:
+    /// Decides whether to write out the batch now, take the next packet from
+    /// the queue or wait for more packets. @return next action.
+    Action maybe_flush();
+    /// Called when the batch timer expired or a new packet arrived while
+    /// waiting. @return next action.
+    Action wait_done();
+    /// Writes the batch to the device. @return next action.
+    Action flush();
+    /// Called when the whole batch was written. @return next action.
+    Action write_done();
+
+    /// Callback on the executor that triggers the timer early when a packet
+    /// arrives.
+    class Wakeup : public Executable
+    {
+    public:
+        /// @param parent owning flow.
+        Wakeup(LocalTrackIfBatch *parent)
+            : parent_(parent)
+        {
+        }
+
+        void run() override;
+
+    private:
+        /// Owning flow.
+        LocalTrackIfBatch *parent_;
+    };
+
+    /// Maximum number of packets in a batch.
+    unsigned maxBatch_;
+    /// Number of packets in the batch.
+    unsigned count_{0};
+    /// Maximum time a packet waits in the batch.
+    long long maxLatency_;
+    /// When the current batch needs to be written at the latest.
+    long long deadline_{0};
+    /// Packets waiting to be written.
+    std::unique_ptr<dcc::Packet[]> batch_;
+    // These are separate members, not bitfields: send() runs on the caller's
+    // thread and the flow on the executor, and neighbouring bitfields share
+    // one memory location.
+    /// True if we are sleeping on the timer and want to be woken up by
+    /// send(). Protected by the atomic of this.
+    bool waiting_{false};
+    /// True if wakeup_ is on the executor queue. Protected by the atomic of
+    /// this.
+    bool wakeupPending_{false};
+    /// True while the device does not accept our data. Read by is_blocked()
+    /// from any thread.
+    std::atomic<bool> blocked_{false};
+    /// Statistics: packets written.
+    unsigned numPackets_{0};
+    /// Statistics: batches written.
+    unsigned numWrites_{0};
+    /// Statistics: how many batches had to wait for the device.
+    unsigned numBlocked_{0};
+    /// Helper for waiting on the device.
+    StateFlowSelectHelper helper_{this};
+    /// Timer for the latency budget.
+    StateFlowTimer timer_{this};
+    /// Executor callback for send().
+    Wakeup wakeup_{this};
+};
+
 } // namespace dcc
 
 #endif // _DCC_LOCALTRACKIF_HXX_
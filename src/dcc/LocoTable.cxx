@@ -0,0 +1,306 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file LocoTable.cxx
+ *
+ * Packed state table for the DCC locomotives of a large command station, with
+ * a single packet source iterating over all of them.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include "dcc/LocoTable.hxx"
+
+#include "dcc/Loco.hxx"
+#include "dcc/Packet.hxx"
+#include "dcc/UpdateLoop.hxx"
+
+namespace dcc
+{
+
+constexpr unsigned LocoTable::NO_SLOT;
+constexpr unsigned LocoTable::MIN_REPEAT_MSEC;
+
+LocoTable::LocoTable(unsigned capacity)
+    : capacity_(capacity)
+    , address_(new uint16_t[capacity])
+    , flags_(new uint8_t[capacity])
+    , speed_(new uint8_t[capacity])
+    , lastSetSpeed_(new uint16_t[capacity])
+    , fn_(new uint32_t[capacity])
+    , lastRefresh_(new uint32_t[capacity])
+{
+    HASSERT(capacity < (1u << (32 - CODE_SHIFT)));
+    memset(flags_.get(), 0, capacity);
+}
+
+LocoTable::~LocoTable()
+{
+    if (numLocos_)
+    {
+        packet_processor_remove_refresh_source(this);
+    }
+}
+
+uint32_t LocoTable::now_msec()
+{
+    return os_get_time_monotonic() / 1000000;
+}
+
+unsigned LocoTable::add_loco(uint16_t address, bool is_long, SpeedMode mode)
+{
+    unsigned slot = 0;
+    while (slot < highWater_ && (flags_[slot] & IN_USE))
+    {
+        ++slot;
+    }
+    if (slot >= capacity_)
+    {
+        return NO_SLOT;
+    }
+    if (slot >= highWater_)
+    {
+        highWater_ = slot + 1;
+    }
+    address_[slot] = address;
+    flags_[slot] = IN_USE | (is_long ? LONG_ADDRESS : 0) |
+        (mode == SPEED_128 ? SPEED128 : 0);
+    speed_[slot] = 0;
+    lastSetSpeed_[slot] = 0;
+    fn_[slot] = 0;
+    lastRefresh_[slot] = now_msec() - MIN_REPEAT_MSEC;
+    if (!numLocos_++)
+    {
+        packet_processor_add_refresh_source(this);
+    }
+    return slot;
+}
+
+void LocoTable::remove_loco(unsigned slot)
+{
+    HASSERT(is_used(slot));
+    flags_[slot] = 0;
+    while (highWater_ && !(flags_[highWater_ - 1] & IN_USE))
+    {
+        --highWater_;
+    }
+    if (!--numLocos_)
+    {
+        packet_processor_remove_refresh_source(this);
+    }
+}
+
+void LocoTable::set_speed(unsigned slot, SpeedType speed)
+{
+    float16_t new_speed = speed.get_wire();
+    if (lastSetSpeed_[slot] == new_speed)
+    {
+        return;
+    }
+    lastSetSpeed_[slot] = new_speed;
+    uint8_t dir = speed.direction() ? REVERSE : 0;
+    if ((flags_[slot] & REVERSE) != dir)
+    {
+        flags_[slot] ^= REVERSE;
+        flags_[slot] |= DIRECTION_CHANGED;
+    }
+    unsigned steps = (flags_[slot] & SPEED128) ? 126 : 28;
+    float f_speed = speed.mph();
+    if (f_speed > 0)
+    {
+        f_speed *= ((steps * 1.0) / 126);
+        unsigned sp = f_speed;
+        sp++; // makes sure it is at least speed step 1.
+        if (sp > steps)
+        {
+            sp = steps;
+        }
+        speed_[slot] = sp;
+    }
+    else
+    {
+        speed_[slot] = 0;
+    }
+    packet_processor_notify_update(this, (slot << CODE_SHIFT) | SPEED);
+}
+
+SpeedType LocoTable::get_speed(unsigned slot)
+{
+    SpeedType v;
+    v.set_wire(lastSetSpeed_[slot]);
+    return v;
+}
+
+void LocoTable::set_emergencystop(unsigned slot)
+{
+    speed_[slot] = 0;
+    SpeedType dir0;
+    dir0.set_direction((flags_[slot] & REVERSE) ? 1 : 0);
+    lastSetSpeed_[slot] = dir0.get_wire();
+    flags_[slot] |= DIRECTION_CHANGED;
+    packet_processor_notify_update(this, (slot << CODE_SHIFT) | ESTOP);
+}
+
+void LocoTable::set_fn(unsigned slot, uint32_t address, uint16_t value)
+{
+    if (address > 28)
+    {
+        // Ignore.
+        return;
+    }
+    uint32_t bit = 1 << address;
+    if (value)
+    {
+        fn_[slot] |= bit;
+    }
+    else
+    {
+        fn_[slot] &= ~bit;
+    }
+    packet_processor_notify_update(
+        this, (slot << CODE_SHIFT) | Dcc28Payload::get_fn_update_code(address));
+}
+
+uint16_t LocoTable::get_fn(unsigned slot, uint32_t address)
+{
+    if (address > 28)
+    {
+        // Unknown.
+        return 0;
+    }
+    return (fn_[slot] >> address) & 1;
+}
+
+void LocoTable::get_next_packet(unsigned code, Packet *packet)
+{
+    uint32_t now = now_msec();
+    if (code)
+    {
+        unsigned slot = code >> CODE_SHIFT;
+        if (!is_used(slot))
+        {
+            // Loco was removed since the update was queued.
+            packet->set_dcc_idle();
+            return;
+        }
+        lastRefresh_[slot] = now;
+        fill_packet(slot, code & ((1 << CODE_SHIFT) - 1), packet);
+        return;
+    }
+    // Background refresh: finds the next slot in use that has not seen a
+    // packet recently. Only the flags and timestamps arrays are touched
+    // while scanning.
+    unsigned slot = nextRefresh_;
+    for (unsigned i = 0; i < highWater_; ++i, ++slot)
+    {
+        if (slot >= highWater_)
+        {
+            slot = 0;
+        }
+        if ((flags_[slot] & IN_USE) &&
+            (uint32_t)(now - lastRefresh_[slot]) >= MIN_REPEAT_MSEC)
+        {
+            nextRefresh_ = slot + 1;
+            lastRefresh_[slot] = now;
+            unsigned phase = (flags_[slot] & REFRESH_MASK) >> REFRESH_SHIFT;
+            unsigned next = phase + 1;
+            if (next > MAX_REFRESH - MIN_REFRESH)
+            {
+                next = 0;
+            }
+            flags_[slot] =
+                (flags_[slot] & ~REFRESH_MASK) | (next << REFRESH_SHIFT);
+            fill_packet(slot, MIN_REFRESH + phase, packet);
+            // Refresh packets go out only once.
+            packet->packet_header.rept_count = 0;
+            return;
+        }
+    }
+    // Everybody got a packet within the last few msec.
+    packet->set_dcc_idle();
+}
+
+void LocoTable::fill_packet(unsigned slot, unsigned code, Packet *packet)
+{
+    packet->start_dcc_packet();
+    if (flags_[slot] & LONG_ADDRESS)
+    {
+        packet->add_dcc_address(DccLongAddress(address_[slot]));
+    }
+    else
+    {
+        packet->add_dcc_address(DccShortAddress(address_[slot]));
+    }
+    // User action. Up repeat count.
+    packet->packet_header.rept_count = 2;
+    bool is_fwd = !(flags_[slot] & REVERSE);
+    switch (code)
+    {
+        case FUNCTION0:
+            packet->add_dcc_function0_4(fn_[slot] & 0x1F);
+            return;
+        case FUNCTION5:
+            packet->add_dcc_function5_8(fn_[slot] >> 5);
+            return;
+        case FUNCTION9:
+            packet->add_dcc_function9_12(fn_[slot] >> 9);
+            return;
+        case FUNCTION13:
+            packet->add_dcc_function13_20(fn_[slot] >> 13);
+            return;
+        case FUNCTION21:
+            packet->add_dcc_function21_28(fn_[slot] >> 21);
+            return;
+        case ESTOP:
+            if (flags_[slot] & SPEED128)
+            {
+                packet->add_dcc_speed128(is_fwd, Packet::EMERGENCY_STOP);
+            }
+            else
+            {
+                packet->add_dcc_speed28(is_fwd, Packet::EMERGENCY_STOP);
+            }
+            packet->packet_header.rept_count = 3;
+            return;
+        default:
+            LOG(WARNING, "Unknown packet generation code: %x", code);
+        // fall through
+        case SPEED:
+            flags_[slot] &= ~DIRECTION_CHANGED;
+            if (flags_[slot] & SPEED128)
+            {
+                packet->add_dcc_speed128(is_fwd, speed_[slot]);
+            }
+            else
+            {
+                packet->add_dcc_speed28(is_fwd, speed_[slot]);
+            }
+            return;
+    }
+}
+
+} // namespace dcc
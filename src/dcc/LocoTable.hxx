@@ -0,0 +1,275 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file LocoTable.hxx
+ *
+ * Packed state table for the DCC locomotives of a large command station, with
+ * a single packet source iterating over all of them.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _DCC_LOCOTABLE_HXX_
+#define _DCC_LOCOTABLE_HXX_
+
+#include <memory>
+
+#include "dcc/Address.hxx"
+#include "dcc/PacketSource.hxx"
+
+namespace dcc
+{
+
+/// Stores the state of many DCC locomotives in contiguous arrays (one array
+/// per field) and generates the refresh packets for all of them by walking
+/// the arrays linearly. The whole table is registered with the update loop as
+/// a single packet source, so the refresh loop does not need to chase a
+/// pointer and a vtable for every locomotive.
+///
+/// Locomotives are identified by a slot index, which stays valid until the
+/// slot is removed. Use LocoTableTrain to expose a slot as an
+/// openlcb::TrainImpl for the TrainService.
+///
+/// The packets generated are the same as for Dcc28Train and Dcc128Train. The
+/// table makes sure that two packets to the same slot are at least
+/// MIN_REPEAT_MSEC apart; if every locomotive was refreshed recently, an idle
+/// packet is generated.
+///
+/// Like the DccTrain objects, this class needs no locking as long as the
+/// throttle side and the update loop do not call it concurrently for the same
+/// slot; the arrays are allocated once in the constructor.
+class LocoTable : public NonTrainPacketSource
+{
+public:
+    /// Which DCC speed step mode a locomotive uses.
+    enum SpeedMode
+    {
+        SPEED_28,
+        SPEED_128,
+    };
+
+    /// Returned by add_loco when the table is full.
+    static constexpr unsigned NO_SLOT = 0xFFFFFFFFu;
+    /// Minimum time between two packets to the same slot.
+    static constexpr unsigned MIN_REPEAT_MSEC = 5;
+
+    /// Constructor. @param capacity is the maximum number of locomotives.
+    LocoTable(unsigned capacity);
+    ~LocoTable();
+
+    /// Allocates a slot for a locomotive with a short address.
+    /// @param a the address; @param mode the speed step mode.
+    /// @return slot index or NO_SLOT if the table is full.
+    unsigned add_loco(DccShortAddress a, SpeedMode mode = SPEED_128)
+    {
+        return add_loco(a.value, false, mode);
+    }
+
+    /// Allocates a slot for a locomotive with a long address.
+    /// @param a the address; @param mode the speed step mode.
+    /// @return slot index or NO_SLOT if the table is full.
+    unsigned add_loco(DccLongAddress a, SpeedMode mode = SPEED_128)
+    {
+        return add_loco(a.value, true, mode);
+    }
+
+    /// Frees a slot. Updates still queued in the update loop for this slot
+    /// will generate idle packets.
+    /// @param slot the slot returned by add_loco.
+    void remove_loco(unsigned slot);
+
+    /// @return the maximum number of locomotives.
+    unsigned capacity()
+    {
+        return capacity_;
+    }
+
+    /// @return the number of slots in use.
+    unsigned size()
+    {
+        return numLocos_;
+    }
+
+    /// @param slot slot index. @return true if the slot is allocated.
+    bool is_used(unsigned slot)
+    {
+        return slot < capacity_ && (flags_[slot] & IN_USE);
+    }
+
+    /// Sets the speed of a locomotive and schedules a speed packet.
+    void set_speed(unsigned slot, SpeedType speed);
+    /// @return the last set speed of a locomotive.
+    SpeedType get_speed(unsigned slot);
+    /// Sends an emergency stop packet to a locomotive.
+    void set_emergencystop(unsigned slot);
+    /// Sets a function of a locomotive and schedules a function packet.
+    void set_fn(unsigned slot, uint32_t address, uint16_t value);
+    /// @return the value of a function of a locomotive.
+    uint16_t get_fn(unsigned slot, uint32_t address);
+    /// @return the DCC address of a locomotive.
+    uint32_t address(unsigned slot)
+    {
+        return address_[slot];
+    }
+    /// @return the address type of a locomotive.
+    TrainAddressType address_type(unsigned slot)
+    {
+        return (flags_[slot] & LONG_ADDRESS)
+            ? TrainAddressType::DCC_LONG_ADDRESS
+            : TrainAddressType::DCC_SHORT_ADDRESS;
+    }
+
+    /// Generates the next packet. @param code is 0 for the next background
+    /// refresh packet, or a value that the table passed to notify_update.
+    /// @param packet is the storage to fill in.
+    void get_next_packet(unsigned code, Packet *packet) override;
+
+    /// We refresh many locomotives and keep their spacing ourselves.
+    bool is_multi_decoder() override
+    {
+        return true;
+    }
+
+private:
+    /// Bits in flags_.
+    enum Flags
+    {
+        IN_USE = 0x01,
+        LONG_ADDRESS = 0x02,
+        SPEED128 = 0x04,
+        /// Set if the direction is reverse.
+        REVERSE = 0x08,
+        DIRECTION_CHANGED = 0x10,
+        /// Which refresh packet comes next (0..MAX_REFRESH-MIN_REFRESH).
+        REFRESH_MASK = 0x60,
+        REFRESH_SHIFT = 5,
+    };
+
+    /// Update codes are the DccTrainUpdateCode in the low bits and the slot
+    /// index above.
+    static constexpr unsigned CODE_SHIFT = 5;
+
+    /// Allocates a slot. @return slot index or NO_SLOT.
+    unsigned add_loco(uint16_t address, bool is_long, SpeedMode mode);
+
+    /// Fills in a packet for a given slot. @param slot the locomotive;
+    /// @param code a DccTrainUpdateCode; @param packet the storage.
+    void fill_packet(unsigned slot, unsigned code, Packet *packet);
+
+    /// @return the current time in msec (wraps around).
+    static uint32_t now_msec();
+
+    /// Maximum number of slots.
+    unsigned capacity_;
+    /// Number of slots in use.
+    unsigned numLocos_{0};
+    /// One past the highest slot in use; the refresh walks up to this.
+    unsigned highWater_{0};
+    /// Next slot to look at for background refresh.
+    unsigned nextRefresh_{0};
+
+    /// DCC address per slot.
+    std::unique_ptr<uint16_t[]> address_;
+    /// Flags per slot, see Flags.
+    std::unique_ptr<uint8_t[]> flags_;
+    /// Current speed step per slot.
+    std::unique_ptr<uint8_t[]> speed_;
+    /// fp16 value of the last set speed per slot.
+    std::unique_ptr<uint16_t[]> lastSetSpeed_;
+    /// Function bits f0-f28 per slot.
+    std::unique_ptr<uint32_t[]> fn_;
+    /// Time of the last packet per slot, in msec.
+    std::unique_ptr<uint32_t[]> lastRefresh_;
+};
+
+/// Adapter exposing one slot of a LocoTable as a TrainImpl, so that it can be
+/// used with openlcb::TrainNode. Does not own the slot.
+class LocoTableTrain : public openlcb::TrainImpl
+{
+public:
+    /// Constructor. @param table the locomotive table; @param slot an
+    /// allocated slot in that table.
+    LocoTableTrain(LocoTable *table, unsigned slot)
+        : table_(table)
+        , slot_(slot)
+    {
+        HASSERT(table_->is_used(slot_));
+    }
+
+    /// @return the slot in the table.
+    unsigned slot()
+    {
+        return slot_;
+    }
+
+    void set_speed(SpeedType speed) override
+    {
+        table_->set_speed(slot_, speed);
+    }
+    SpeedType get_speed() override
+    {
+        return table_->get_speed(slot_);
+    }
+    SpeedType get_commanded_speed() override
+    {
+        return get_speed();
+    }
+    void set_emergencystop() override
+    {
+        table_->set_emergencystop(slot_);
+    }
+    bool get_emergencystop() override
+    {
+        return false;
+    }
+    void set_fn(uint32_t address, uint16_t value) override
+    {
+        table_->set_fn(slot_, address, value);
+    }
+    uint16_t get_fn(uint32_t address) override
+    {
+        return table_->get_fn(slot_, address);
+    }
+    uint32_t legacy_address() override
+    {
+        return table_->address(slot_);
+    }
+    TrainAddressType legacy_address_type() override
+    {
+        return table_->address_type(slot_);
+    }
+
+private:
+    /// Table storing the state.
+    LocoTable *table_;
+    /// Which locomotive we are.
+    unsigned slot_;
+};
+
+} // namespace dcc
+
+#endif // _DCC_LOCOTABLE_HXX_
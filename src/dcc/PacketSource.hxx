@@ -56,6 +56,15 @@ public:
      * tells which recently changed value should be generated. 
      * @param packet is the storage to set the outgoing packet in. */
     virtual void get_next_packet(unsigned code, Packet* packet) = 0;
+
+    /** @return true if this source generates packets for many decoders (such
+     * as a whole locomotive table) and keeps the minimum spacing between
+     * packets to the same decoder by itself. Update loops may then poll this
+     * source in consecutive packet slots. */
+    virtual bool is_multi_decoder()
+    {
+        return false;
+    }
 };
 
 /// Abstract class that is a packet source but not a TrainImpl. Provides dummy
@@ -0,0 +1,266 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file PriorityUpdateLoop.cxx
+ *
+ * Command station update loop that sends changed train state ahead of the
+ * background refresh, and weighs the background refresh by source priority.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include "dcc/PriorityUpdateLoop.hxx"
+#include "dcc/Packet.hxx"
+#include "dcc/PacketSource.hxx"
+
+namespace dcc
+{
+
+constexpr unsigned PriorityUpdateLoop::MAX_URGENT_BURST;
+constexpr long long PriorityUpdateLoop::MIN_REPEAT_NSEC;
+
+PriorityUpdateLoop::PriorityUpdateLoop(
+    Service *service, PacketFlowInterface *track_send, unsigned queue_size)
+    : StateFlow(service)
+    , trackSend_(track_send)
+    , updates_(queue_size)
+{
+    HASSERT(queue_size > 0);
+}
+
+PriorityUpdateLoop::~PriorityUpdateLoop()
+{
+}
+
+size_t PriorityUpdateLoop::find_source(PacketSource *source)
+{
+    size_t i = 0;
+    while (i < sources_.size() && sources_[i].source != source)
+    {
+        ++i;
+    }
+    return i;
+}
+
+bool PriorityUpdateLoop::add_refresh_source(
+    dcc::PacketSource *source, unsigned priority)
+{
+    AtomicHolder h(this);
+    size_t i = find_source(source);
+    if (i < sources_.size())
+    {
+        if (sources_[i].priority >= EXCLUSIVE_MIN_PRIORITY)
+        {
+            --numExclusive_;
+        }
+        sources_[i].priority = priority;
+    }
+    else
+    {
+        sources_.push_back(
+            {source, priority, 0, 0, source->is_multi_decoder()});
+    }
+    if (priority < EXCLUSIVE_MIN_PRIORITY)
+    {
+        return true;
+    }
+    ++numExclusive_;
+    for (const auto &s : sources_)
+    {
+        if (s.priority > priority)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PriorityUpdateLoop::remove_refresh_source(dcc::PacketSource *source)
+{
+    AtomicHolder h(this);
+    size_t i = find_source(source);
+    if (i < sources_.size())
+    {
+        if (sources_[i].priority >= EXCLUSIVE_MIN_PRIORITY)
+        {
+            --numExclusive_;
+        }
+        sources_.erase(sources_.begin() + i);
+    }
+    // Compacts the pending updates in place, dropping the ones for this
+    // source.
+    unsigned kept = 0;
+    for (unsigned j = 0; j < updateCount_; ++j)
+    {
+        if (update_at(j).source != source)
+        {
+            update_at(kept++) = update_at(j);
+        }
+    }
+    updateCount_ = kept;
+    if (lastSource_ == source)
+    {
+        lastSource_ = nullptr;
+    }
+}
+
+void PriorityUpdateLoop::notify_update(PacketSource *source, unsigned code)
+{
+    long long now = os_get_time_monotonic();
+    AtomicHolder h(this);
+    for (unsigned i = 0; i < updateCount_; ++i)
+    {
+        const Update &u = update_at(i);
+        if (u.source == source && u.code == code)
+        {
+            // Already pending; the packet will be generated from the latest
+            // state anyway.
+            return;
+        }
+    }
+    if (updateCount_ >= updates_.size())
+    {
+        ++droppedUpdates_;
+        return;
+    }
+    update_at(updateCount_++) = {source, code, now};
+}
+
+PriorityUpdateLoop::Source *PriorityUpdateLoop::find_exclusive()
+{
+    Source *best = nullptr;
+    for (auto &s : sources_)
+    {
+        if (s.priority >= EXCLUSIVE_MIN_PRIORITY &&
+            (!best || s.priority > best->priority))
+        {
+            best = &s;
+        }
+    }
+    return best;
+}
+
+PriorityUpdateLoop::Source *PriorityUpdateLoop::pick_refresh(long long now)
+{
+    bool too_soon = (now - lastSendTime_) < MIN_REPEAT_NSEC;
+    Source *best = nullptr;
+    for (auto &s : sources_)
+    {
+        s.credit += s.priority + 1;
+        if (too_soon && s.source == lastSource_)
+        {
+            continue;
+        }
+        if (!best || s.credit > best->credit)
+        {
+            best = &s;
+        }
+    }
+    if (best)
+    {
+        best->credit = 0;
+    }
+    return best;
+}
+
+void PriorityUpdateLoop::mark_sent(PacketSource *source, long long now)
+{
+    lastSource_ = source;
+    lastSendTime_ = now;
+    if (!source)
+    {
+        return;
+    }
+    size_t i = find_source(source);
+    if (i >= sources_.size())
+    {
+        return;
+    }
+    if (sources_[i].multiDecoder)
+    {
+        // The source spaces out its own packets, and the time between polls
+        // says nothing about any single decoder.
+        lastSource_ = nullptr;
+        return;
+    }
+    if (sources_[i].lastSent)
+    {
+        refreshInterval_.add(now - sources_[i].lastSent);
+    }
+    sources_[i].lastSent = now;
+}
+
+StateFlowBase::Action PriorityUpdateLoop::entry()
+{
+    long long now = os_get_time_monotonic();
+    PacketSource *source = nullptr;
+    unsigned code = 0;
+    {
+        AtomicHolder h(this);
+        Source *s = nullptr;
+        if (numExclusive_)
+        {
+            s = find_exclusive();
+        }
+        else if (updateCount_ && urgentInARow_ < MAX_URGENT_BURST &&
+            (update_at(0).source != lastSource_ ||
+                now - lastSendTime_ >= MIN_REPEAT_NSEC))
+        {
+            const Update &u = update_at(0);
+            source = u.source;
+            code = u.code;
+            updateLatency_.add(now - u.timestamp);
+            updateHead_ = (updateHead_ + 1) % updates_.size();
+            --updateCount_;
+            ++urgentInARow_;
+        }
+        else
+        {
+            s = pick_refresh(now);
+            urgentInARow_ = 0;
+        }
+        if (s)
+        {
+            source = s->source;
+        }
+        mark_sent(source, now);
+    }
+    if (source)
+    {
+        source->get_next_packet(code, message()->data());
+    }
+    else
+    {
+        // No sources at all, or the only one was just sent to.
+        message()->data()->set_dcc_idle();
+    }
+    // We pass on the filled packet to the track processor.
+    trackSend_->send(transfer_message());
+    return exit();
+}
+
+} // namespace dcc
@@ -0,0 +1,220 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file PriorityUpdateLoop.hxx
+ *
+ * Command station update loop that sends changed train state ahead of the
+ * background refresh, and weighs the background refresh by source priority.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _DCC_PRIORITYUPDATELOOP_HXX_
+#define _DCC_PRIORITYUPDATELOOP_HXX_
+
+#include <vector>
+
+#include "dcc/UpdateLoop.hxx"
+#include "executor/StateFlow.hxx"
+#include "utils/LatencyHistogram.hxx"
+
+namespace dcc
+{
+
+/// Implementation of a command station update loop with prioritization.
+///
+/// - Calls to notify_update() (e.g. a throttle changing the speed) are queued
+///   and sent in the next packet slot, ahead of the background refresh.
+///   Repeated notifications with the same source and code are merged while
+///   pending. At most MAX_URGENT_BURST urgent packets are sent in a row, then
+///   a refresh slot is inserted, so that the refresh never stops entirely.
+///
+/// - Background refresh is weighted by the priority given to
+///   add_refresh_source(): a source with priority p gets (p + 1) times as
+///   many refresh slots as one with priority 0. Every source ages (gains
+///   credit) in each slot it does not get, so low priority sources are never
+///   starved.
+///
+/// - Sources with priority at least EXCLUSIVE_MIN_PRIORITY take all slots
+///   while registered (the highest one wins); updates for other sources are
+///   kept until the exclusive source goes away.
+///
+/// - The same source is not polled in two consecutive slots within
+///   MIN_REPEAT_NSEC; if there is nobody else to send to, an idle packet is
+///   sent. Sources that return true from is_multi_decoder() are exempt.
+///
+/// Usage is the same as with SimpleUpdateLoop: feed it with empty packets from
+/// a pool (e.g. via a PoolToQueueFlow) and pass the track interface to the
+/// constructor.
+class PriorityUpdateLoop : public StateFlow<Buffer<dcc::Packet>, QList<1>>,
+                           private UpdateLoopBase
+{
+public:
+    /// Constructor.
+    /// @param service defines which executor this flow runs on.
+    /// @param track_send where to forward the filled packets.
+    /// @param queue_size how many notify_update() calls can be pending. When
+    /// the queue is full, further updates are dropped (and counted); the
+    /// background refresh will eventually send the new state.
+    PriorityUpdateLoop(Service *service, PacketFlowInterface *track_send,
+        unsigned queue_size = 32);
+    ~PriorityUpdateLoop();
+
+    /// Adds a new refresh source, or changes the priority of an already
+    /// registered one.
+    bool add_refresh_source(
+        dcc::PacketSource *source, unsigned priority) OVERRIDE;
+
+    /// Deletes a packet refresh source, together with its pending updates.
+    void remove_refresh_source(dcc::PacketSource *source) OVERRIDE;
+
+    /// Queues an urgent packet for a source.
+    void notify_update(PacketSource *source, unsigned code) OVERRIDE;
+
+    // Entry to the state flow -- when a new packet needs to be sent.
+    Action entry() OVERRIDE;
+
+    /// @return the distribution of the time from notify_update() to handing
+    /// the packet to the track interface.
+    const LatencyHistogram &update_latency()
+    {
+        return updateLatency_;
+    }
+
+    /// @return the distribution of the time between two consecutive packets
+    /// sent to the same refresh source (update or refresh).
+    const LatencyHistogram &refresh_interval()
+    {
+        return refreshInterval_;
+    }
+
+    /// @return how many notify_update() calls were dropped due to a full
+    /// queue.
+    unsigned dropped_updates()
+    {
+        return droppedUpdates_;
+    }
+
+    /// Clears the latency statistics.
+    void clear_stats()
+    {
+        updateLatency_.clear();
+        refreshInterval_.clear();
+        droppedUpdates_ = 0;
+    }
+
+    /// How many updates to send in a row before a refresh slot is given out.
+    static constexpr unsigned MAX_URGENT_BURST = 4;
+    /// Minimum time between two packets to the same source. If no other
+    /// source can be sent to, an idle packet fills the slot instead.
+    static constexpr long long MIN_REPEAT_NSEC = MSEC_TO_NSEC(5);
+
+private:
+    /// Data we keep about each refresh source.
+    struct Source
+    {
+        /// The registered packet source.
+        PacketSource *source;
+        /// Priority from add_refresh_source.
+        unsigned priority;
+        /// Accumulated refresh credit. The source with the most credit gets
+        /// the next refresh slot.
+        unsigned credit;
+        /// When we last sent a packet for this source, 0 if never.
+        long long lastSent;
+        /// Cached value of source->is_multi_decoder().
+        bool multiDecoder;
+    };
+
+    /// A pending notify_update call.
+    struct Update
+    {
+        /// Which source to poll.
+        PacketSource *source;
+        /// Code to pass to the source.
+        unsigned code;
+        /// When notify_update was called.
+        long long timestamp;
+    };
+
+    /// Picks the exclusive source with the highest priority. Must be called
+    /// under the lock. @return the source or nullptr if there is none.
+    Source *find_exclusive();
+
+    /// Picks the refresh source with the most credit and ages all others.
+    /// Must be called under the lock. @param now current time. @return the
+    /// source or nullptr if nobody may get a packet now.
+    Source *pick_refresh(long long now);
+
+    /// @return the index of the given source in sources_, or sources_.size()
+    /// if not found. Must be called under the lock.
+    size_t find_source(PacketSource *source);
+
+    /// @param i an index into the update queue, 0 is the oldest entry.
+    /// @return the pending update.
+    Update &update_at(unsigned i)
+    {
+        return updates_[(updateHead_ + i) % updates_.size()];
+    }
+
+    /// Records that we are sending a packet to a source. @param s is the
+    /// source (may be nullptr); @param now is the current time.
+    void mark_sent(PacketSource *s, long long now);
+
+    /// Place where we forward the packets filled in.
+    PacketFlowInterface *trackSend_;
+
+    /// Packet sources to ask about refreshing data periodically.
+    std::vector<Source> sources_;
+    /// Ring buffer of pending updates.
+    std::vector<Update> updates_;
+    /// Index of the oldest pending update in updates_.
+    unsigned updateHead_{0};
+    /// Number of pending updates.
+    unsigned updateCount_{0};
+    /// How many of the sources are exclusive.
+    unsigned numExclusive_{0};
+    /// How many urgent packets we sent since the last refresh slot.
+    unsigned urgentInARow_{0};
+    /// Number of dropped updates.
+    unsigned droppedUpdates_{0};
+
+    /// The source we sent the previous packet to, or nullptr for idle or
+    /// a multi-decoder source.
+    PacketSource *lastSource_{nullptr};
+    /// When we sent the previous packet.
+    long long lastSendTime_{0};
+
+    /// Latency from notify_update to send.
+    LatencyHistogram updateLatency_;
+    /// Time between packets to the same source.
+    LatencyHistogram refreshInterval_;
+};
+
+} // namespace dcc
+
+#endif // _DCC_PRIORITYUPDATELOOP_HXX_
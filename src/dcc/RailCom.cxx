@@ -44,7 +44,7 @@ using RailcomDefs::BUSY;
 using RailcomDefs::RESVD1;
 using RailcomDefs::RESVD2;
 using RailcomDefs::RESVD3;
-const uint8_t railcom_decode[256] =
+constexpr uint8_t railcom_decode[256] =
 {      INV,    INV,    INV,    INV,    INV,    INV,    INV,    INV,
        INV,    INV,    INV,    INV,    INV,    INV,    INV,   NACK,
        INV,    INV,    INV,    INV,    INV,    INV,    INV,   0x33,
@@ -189,6 +189,144 @@ void parse_internal(uint8_t fb_channel, uint8_t railcom_channel,
     }
 }
 
+namespace
+{
+
+/// Layout of the entries in railcom_class.
+enum RailcomClassBits
+{
+    /// The low byte is the railcom_decode value of the byte.
+    CLASS_DECODE_MASK = 0xff,
+    /// RailcomPacket type of a datagram starting with this byte.
+    CLASS_TYPE_SHIFT = 8,
+    /// Mask for the type after shifting.
+    CLASS_TYPE_MASK = 0xf,
+    /// Length in bytes of a datagram starting with this byte; 0 if no
+    /// datagram can start with it.
+    CLASS_LEN_SHIFT = 12,
+};
+
+/// @return a railcom_class entry. @param decoded 6-bit value or RailcomDefs
+/// constant; @param type RailcomPacket type; @param len datagram length.
+constexpr uint16_t class_entry(uint8_t decoded, unsigned type, unsigned len)
+{
+    return decoded | (type << CLASS_TYPE_SHIFT) | (len << CLASS_LEN_SHIFT);
+}
+
+/// @return the railcom_class entry for a byte whose first 6-bit value is
+/// not a data value. @param decoded is the railcom_decode value of the byte.
+constexpr uint16_t railcom_classify_special(uint8_t decoded)
+{
+    return decoded == ACK ? class_entry(decoded, RailcomPacket::ACK, 1)
+        : decoded == NACK ? class_entry(decoded, RailcomPacket::NACK, 1)
+        : decoded == BUSY ? class_entry(decoded, RailcomPacket::BUSY, 1)
+                          : class_entry(decoded, RailcomPacket::GARBAGE, 0);
+}
+
+/// @return the railcom_class entry for a byte. @param decoded is the
+/// railcom_decode value of the byte. Mirrors the branches of parse_internal.
+/// This is a single expression so that it is constexpr in C++11 too.
+constexpr uint16_t railcom_classify(uint8_t decoded)
+{
+    return decoded >= 64 ? railcom_classify_special(decoded)
+        : (decoded >> 2) == RMOB_ADRHIGH
+        ? class_entry(decoded, RailcomPacket::MOB_ADRHIGH, 2)
+        : (decoded >> 2) == RMOB_ADRLOW
+        ? class_entry(decoded, RailcomPacket::MOB_ADRLOW, 2)
+        : (decoded >> 2) == RMOB_EXT
+        ? class_entry(decoded, RailcomPacket::MOB_EXT, 2)
+        // 6 bytes for a CV read of four bytes, decided by the caller.
+        : (decoded >> 2) == RMOB_POM
+        ? class_entry(decoded, RailcomPacket::MOB_POM, 2)
+        : (decoded >> 2) == RMOB_DYN
+        ? class_entry(decoded, RailcomPacket::MOB_DYN, 3)
+        : class_entry(decoded, RailcomPacket::GARBAGE, 0);
+}
+
+/// Combined decode and classification table.
+struct RailcomClassTable
+{
+    /// Indexed by the raw byte from the railcom UART.
+    uint16_t entry[256];
+};
+
+/// List of byte values to compute the table for.
+template <unsigned... Is> struct ClassIndices
+{
+};
+
+/// Generates ClassIndices<0, 1, ..., N - 1> as the member type.
+template <unsigned N, unsigned... Is>
+struct MakeClassIndices : MakeClassIndices<N - 1, N - 1, Is...>
+{
+};
+
+/// End of the recursion.
+template <unsigned... Is> struct MakeClassIndices<0, Is...>
+{
+    /// The generated index list.
+    typedef ClassIndices<Is...> type;
+};
+
+/// @return the classification table, computed at compile time.
+template <unsigned... Is>
+constexpr RailcomClassTable make_class_table(ClassIndices<Is...>)
+{
+    return RailcomClassTable{{railcom_classify(railcom_decode[Is])...}};
+}
+
+/// Decode and classification of every byte value, see RailcomClassBits.
+constexpr RailcomClassTable railcom_class =
+    make_class_table(MakeClassIndices<256>::type());
+
+/// Same as parse_internal, but driven by the railcom_class table and writing
+/// into an array.
+///
+/// @param fb_channel hardware channel; @param railcom_channel 1 or 2;
+/// @param ptr raw railcom data; @param size number of bytes in ptr;
+/// @param out where to write the decoded packets.
+/// @return one past the last packet written.
+RailcomPacket *parse_bulk_internal(uint8_t fb_channel, uint8_t railcom_channel,
+    const uint8_t *ptr, unsigned size, RailcomPacket *out)
+{
+    for (unsigned ofs = 0; ofs < size; ++ofs)
+    {
+        uint16_t e = railcom_class.entry[ptr[ofs]];
+        unsigned len = e >> CLASS_LEN_SHIFT;
+        uint8_t type = (e >> CLASS_TYPE_SHIFT) & CLASS_TYPE_MASK;
+        if (len == 1)
+        {
+            *out++ = RailcomPacket(fb_channel, railcom_channel, type, 0);
+            continue;
+        }
+        if (type == RailcomPacket::MOB_POM && size == 6 && ofs == 0 &&
+            railcom_decode[ptr[2]] < 64)
+        {
+            len = 6;
+        }
+        if (!len || ofs + len > size)
+        {
+            *out++ = RailcomPacket(
+                fb_channel, railcom_channel, RailcomPacket::GARBAGE, 0);
+            break;
+        }
+        uint32_t arg = e & 3;
+        for (unsigned i = 1; i < len; ++i)
+        {
+            uint8_t decoded = railcom_decode[ptr[++ofs]];
+            if (decoded >= 64)
+            {
+                type = RailcomPacket::GARBAGE;
+            }
+            arg = (arg << 6) | decoded;
+        }
+        *out++ = RailcomPacket(fb_channel, railcom_channel, type, arg);
+    }
+    return out;
+}
+
+} // namespace
+
 void parse_railcom_data(
     const dcc::Feedback &fb, std::vector<struct RailcomPacket> *output)
 {
@@ -226,4 +364,33 @@ void parse_railcom_data(
     }
 }
 
+unsigned parse_railcom_bulk(
+    const dcc::Feedback *fb, unsigned count, RailcomPacket *output)
+{
+    RailcomPacket *out = output;
+    for (const dcc::Feedback *end = fb + count; fb != end; ++fb)
+    {
+        if (fb->channel == 0xff)
+        {
+            continue; // Occupancy feedback information
+        }
+        if (fb->ch1Size == 1 && railcom_decode[fb->ch1Data[0]] != INV &&
+            fb->ch2Size >= 1)
+        {
+            // Misplaced second window, see parse_railcom_data.
+            uint8_t data[8];
+            data[0] = fb->ch1Data[0];
+            memcpy(data + 1, fb->ch2Data, fb->ch2Size);
+            out = parse_bulk_internal(
+                fb->channel, 2, data, 1 + fb->ch2Size, out);
+            continue;
+        }
+        out = parse_bulk_internal(
+            fb->channel, 1, fb->ch1Data, fb->ch1Size, out);
+        out = parse_bulk_internal(
+            fb->channel, 2, fb->ch2Data, fb->ch2Size, out);
+    }
+    return out - output;
+}
+
 }  // namespace dcc
@@ -99,6 +99,9 @@ namespace RailcomDefs
     static const uint8_t RESVD2 = 0xfa;
     /// Reserved for future expansion.
     static const uint8_t RESVD3 = 0xf8;
+    /// Maximum number of packets parse_railcom_data() generates from one
+    /// feedback (two in channel 1 and six in channel 2).
+    static const unsigned MAX_PACKETS = 8;
 }
 
 /** Table for 8-to-6 decoding of railcom data. This table can be indexed by the
@@ -158,6 +161,11 @@ struct RailcomPacket
         , argument(_argument)
     {
     }
+    /// Default constructor. Leaves the fields uninitialized; used for the
+    /// output arrays of parse_railcom_bulk().
+    RailcomPacket()
+    {
+    }
 };
 
 /** Interprets the data from a railcom feedback. If the railcom data contains
@@ -166,6 +174,19 @@ struct RailcomPacket
 void parse_railcom_data(
     const dcc::Feedback &fb, std::vector<struct RailcomPacket> *output);
 
+/** Interprets the data from an array of railcom feedbacks in one pass. The
+ * result is the same as calling parse_railcom_data() for each feedback and
+ * concatenating the outputs, but every byte is decoded and classified with a
+ * single table lookup, and the packets are written into a flat array.
+ *
+ * @param fb array of feedbacks to decode (e.g. one per detector channel).
+ * @param count number of entries in fb.
+ * @param output where to write the decoded packets. Must have room for
+ * count * RailcomDefs::MAX_PACKETS entries.
+ * @return the number of packets written to output. */
+unsigned parse_railcom_bulk(
+    const dcc::Feedback *fb, unsigned count, RailcomPacket *output);
+
 }  // namespace dcc
 
 #endif // _DCC_RAILCOM_HXX_
@@ -37,6 +37,8 @@
 
 #include "executor/Executor.hxx"
 
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef __WINNT__
@@ -80,6 +82,16 @@ ExecutorBase::ExecutorBase()
     FD_ZERO(&selectWrite_);
     FD_ZERO(&selectExcept_);
     selectNFds_ = 0;
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    selectLock_ = nullptr;
+#endif
+#if OPENMRN_HAVE_EPOLL
+    epollFd_ = -1;
+    if (config_executor_use_epoll() == CONSTANT_TRUE)
+    {
+        enable_epoll();
+    }
+#endif
 }
 
 /** Lookup an executor by its name.
@@ -301,6 +313,10 @@ void *ExecutorBase::entry()
         if (!selectPrescaler_ || ((msg = next(&priority)) == nullptr))
         {
             long long wait_length = activeTimers_.get_next_timeout();
+            if (!empty())
+            {
+                wait_length = 0;
+            }
             wait_with_select(wait_length);
             selectPrescaler_ = config_executor_select_prescaler();
             msg = next(&priority);
@@ -327,8 +343,49 @@ void *ExecutorBase::entry()
     return NULL;
 }
 
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+/// Holds the select lock of an executor for the scope of the object, if the
+/// executor has one.
+class SelectLock
+{
+public:
+    /// Constructor. @param m is the mutex to lock, or nullptr for a
+    /// single-threaded executor.
+    SelectLock(OSMutex *m)
+        : m_(m)
+    {
+        if (m_)
+        {
+            m_->lock();
+        }
+    }
+
+    ~SelectLock()
+    {
+        if (m_)
+        {
+            m_->unlock();
+        }
+    }
+
+private:
+    /// Mutex we are holding, or nullptr.
+    OSMutex *m_;
+};
+#endif
+
 void ExecutorBase::select(Selectable *job)
 {
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    SelectLock l(selectLock_);
+#endif
+#if OPENMRN_HAVE_EPOLL
+    if (epollFd_ >= 0)
+    {
+        epoll_select(job);
+        return;
+    }
+#endif
     fd_set *s = get_select_set(job->type());
     int fd = job->fd_;
     if (FD_ISSET(fd, s))
@@ -337,6 +394,7 @@ void ExecutorBase::select(Selectable *job)
             "Multiple Selectables are waiting for the same fd %d type %u", fd,
             job->selectType_);
     }
+    HASSERT(fd < FD_SETSIZE);
     FD_SET(fd, s);
     if (fd >= selectNFds_)
     {
@@ -345,10 +403,28 @@ void ExecutorBase::select(Selectable *job)
     HASSERT(!job->next);
     // Inserts the job into the select queue.
     selectables_.push_front(job);
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    if (selectLock_)
+    {
+        // We might have been called from a worker thread while the select
+        // thread is asleep with the old fd sets.
+        selectHelper_.wakeup();
+    }
+#endif
 }
 
 bool ExecutorBase::is_selected(Selectable *job)
 {
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    SelectLock l(selectLock_);
+#endif
+#if OPENMRN_HAVE_EPOLL
+    if (epollFd_ >= 0)
+    {
+        return job->fd_ < epollFds_.size() &&
+            epollFds_[job->fd_].jobs[job->selectType_ - 1] != nullptr;
+    }
+#endif
     fd_set *s = get_select_set(job->type());
     int fd = job->fd_;
     return FD_ISSET(fd, s);
@@ -356,6 +432,16 @@ bool ExecutorBase::is_selected(Selectable *job)
 
 void ExecutorBase::unselect(Selectable *job)
 {
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    SelectLock l(selectLock_);
+#endif
+#if OPENMRN_HAVE_EPOLL
+    if (epollFd_ >= 0)
+    {
+        epoll_unselect(job);
+        return;
+    }
+#endif
     fd_set *s = get_select_set(job->type());
     int fd = job->fd_;
     if (!FD_ISSET(fd, s))
@@ -381,21 +467,38 @@ void ExecutorBase::unselect(Selectable *job)
 
 void ExecutorBase::wait_with_select(long long wait_length)
 {
-    fd_set fd_r(selectRead_);
-    fd_set fd_w(selectWrite_);
-    fd_set fd_x(selectExcept_);
-    if (!empty()) {
-        wait_length = 0;
-    }
     long long max_sleep = MSEC_TO_NSEC(config_executor_max_sleep_msec());
     if (wait_length > max_sleep)
     {
         wait_length = max_sleep;
     }
-    int ret = selectHelper_.select(selectNFds_, &fd_r, &fd_w, &fd_x, wait_length);
+#if OPENMRN_HAVE_EPOLL
+    if (epollFd_ >= 0)
+    {
+        wait_with_epoll(wait_length);
+        return;
+    }
+#endif
+    fd_set fd_r;
+    fd_set fd_w;
+    fd_set fd_x;
+    int nfds;
+    {
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+        SelectLock l(selectLock_);
+#endif
+        fd_r = selectRead_;
+        fd_w = selectWrite_;
+        fd_x = selectExcept_;
+        nfds = selectNFds_;
+    }
+    int ret = selectHelper_.select(nfds, &fd_r, &fd_w, &fd_x, wait_length);
     if (ret <= 0) {
         return; // nothing to do
     }
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    SelectLock l(selectLock_);
+#endif
     unsigned max_fd = 0;
     for (auto it = selectables_.begin(); it != selectables_.end();) {
         fd_set* s = nullptr;
@@ -406,9 +509,14 @@ void ExecutorBase::wait_with_select(long long wait_length)
         case Selectable::EXCEPT: s = &fd_x; break;
         }
         if (FD_ISSET(it->fd_, s)) {
-            add(it->wakeup_, it->priority_);
+            // The job has to be detached before the wakeup is scheduled,
+            // because a worker of a multi-threaded executor may reuse it
+            // right away.
+            Executable *wakeup = it->wakeup_;
+            unsigned priority = it->priority_;
             FD_CLR(it->fd_, os);
             selectables_.erase(it);
+            add(wakeup, priority);
             continue;
         }
         max_fd = std::max(max_fd, it->fd_ + 1U);
@@ -417,6 +525,174 @@ void ExecutorBase::wait_with_select(long long wait_length)
     selectNFds_ = max_fd;
 }
 
+#if OPENMRN_HAVE_EPOLL
+
+/// How many ready file descriptors we process in one epoll_wait call. If more
+/// are ready, the rest will be returned by the next call (we use level
+/// triggering).
+static constexpr unsigned EPOLL_MAX_EVENTS = 64;
+
+/// Event masks to register in the kernel, indexed by SelectType - 1.
+static const uint32_t EPOLL_EVENT_FOR_TYPE[3] = {EPOLLIN, EPOLLOUT, EPOLLPRI};
+
+/// Event masks that trigger a job, indexed by SelectType - 1. Errors and
+/// hangups wake up every kind of waiter, like select() does, otherwise a
+/// level-triggered hangup would keep waking us up forever.
+static const uint32_t EPOLL_TRIGGER_FOR_TYPE[3] = {
+    EPOLLIN | EPOLLHUP | EPOLLERR, EPOLLOUT | EPOLLHUP | EPOLLERR,
+    EPOLLPRI | EPOLLHUP | EPOLLERR};
+
+bool ExecutorBase::enable_epoll()
+{
+    if (epollFd_ >= 0)
+    {
+        return true;
+    }
+    HASSERT(selectables_.empty());
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    HASSERT(!selectLock_ || !started_);
+#endif
+    epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0)
+    {
+        LOG_ERROR("Executor: epoll_create1 failed (%s), falling back to "
+                  "select.", strerror(errno));
+        return false;
+    }
+    epollEvents_.resize(EPOLL_MAX_EVENTS);
+    return true;
+}
+
+void ExecutorBase::epoll_select(Selectable *job)
+{
+    unsigned fd = job->fd_;
+    if (fd >= epollFds_.size())
+    {
+        epollFds_.resize(fd + 1);
+    }
+    Selectable **slot = &epollFds_[fd].jobs[job->selectType_ - 1];
+    if (*slot)
+    {
+        LOG(FATAL,
+            "Multiple Selectables are waiting for the same fd %d type %u", fd,
+            job->selectType_);
+    }
+    HASSERT(!job->next);
+    *slot = job;
+    epoll_update(fd);
+}
+
+void ExecutorBase::epoll_unselect(Selectable *job)
+{
+    unsigned fd = job->fd_;
+    Selectable **slot = fd < epollFds_.size()
+        ? &epollFds_[fd].jobs[job->selectType_ - 1]
+        : nullptr;
+    if (!slot || *slot != job)
+    {
+        LOG(FATAL, "Tried to remove a non-active selectable: fd %d type %u", fd,
+            job->selectType_);
+    }
+    *slot = nullptr;
+    epoll_update(fd);
+}
+
+void ExecutorBase::epoll_update(int fd)
+{
+    EpollFdState *st = &epollFds_[fd];
+    uint32_t events = 0;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        if (st->jobs[i])
+        {
+            events |= EPOLL_EVENT_FOR_TYPE[i];
+        }
+    }
+    if (events == st->events)
+    {
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    int ret;
+    if (!events)
+    {
+        // Might fail with EBADF if the fd was already closed, which removes
+        // it from the epoll set anyway.
+        ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
+        st->events = 0;
+        return;
+    }
+    else if (!st->events)
+    {
+        ret = ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+        if (ret < 0 && errno == EEXIST)
+        {
+            ret = ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+    else
+    {
+        ret = ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        if (ret < 0 && errno == ENOENT)
+        {
+            // The fd was closed and reopened under us.
+            ret = ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+    if (ret < 0 && errno == EPERM)
+    {
+        // Regular files and the like cannot be polled, and select() would
+        // always report them as ready. We wake up everyone right away.
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            if (st->jobs[i])
+            {
+                Selectable *job = st->jobs[i];
+                st->jobs[i] = nullptr;
+                add(job->wakeup_, job->priority_);
+            }
+        }
+        st->events = 0;
+        return;
+    }
+    if (ret < 0)
+    {
+        LOG(FATAL, "Executor: epoll_ctl failed for fd %d: %s", fd,
+            strerror(errno));
+    }
+    st->events = events;
+}
+
+void ExecutorBase::wait_with_epoll(long long wait_length)
+{
+    int ret = selectHelper_.epoll_wait(
+        epollFd_, epollEvents_.data(), epollEvents_.size(), wait_length);
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    SelectLock l(selectLock_);
+#endif
+    for (int i = 0; i < ret; ++i)
+    {
+        int fd = epollEvents_[i].data.fd;
+        uint32_t events = epollEvents_[i].events;
+        EpollFdState *st = &epollFds_[fd];
+        for (unsigned t = 0; t < 3; ++t)
+        {
+            Selectable *job = st->jobs[t];
+            if (job && (events & EPOLL_TRIGGER_FOR_TYPE[t]))
+            {
+                st->jobs[t] = nullptr;
+                add(job->wakeup_, job->priority_);
+            }
+        }
+        epoll_update(fd);
+    }
+}
+
+#endif // OPENMRN_HAVE_EPOLL
+
 #endif
 
 #if defined(ARDUINO)
@@ -446,4 +722,10 @@ ExecutorBase::~ExecutorBase()
     {
         shutdown();
     }
+#if OPENMRN_HAVE_EPOLL
+    if (epollFd_ >= 0)
+    {
+        ::close(epollFd_);
+    }
+#endif
 }
@@ -36,7 +36,12 @@
 #ifndef _EXECUTOR_EXECUTOR_HXX_
 #define _EXECUTOR_EXECUTOR_HXX_
 
+#include "openmrn_features.h"
+
 #include <functional>
+#if OPENMRN_HAVE_EPOLL
+#include <vector>
+#endif
 
 #include "executor/Executable.hxx"
 #include "executor/Notifiable.hxx"
@@ -101,7 +106,8 @@ public:
      * @param job Selectable structure that describes the descriptor to watch.
      * The pointer must stay alive until it is activated, or is unselected.
      *
-     * Must be called on the executor thread.
+     * Must be called on the executor thread (for a MultiThreadExecutor, on
+     * any of its worker threads).
      *
      * @param job is a Selectable pointer that is not currently watched.
      */
@@ -120,12 +126,32 @@ public:
      * This stops watching the given file descriptor. The job must have been
      * previously inserted into the Executor and must be not yet activated.
      *
-     * Must be called on the executor thread.
+     * Must be called on the executor thread (for a MultiThreadExecutor, on
+     * any of its worker threads).
      *
      * @param job is a Selectable pointer that was previously inserted.
      */
     void unselect(Selectable* job);
 
+#if OPENMRN_HAVE_EPOLL
+    /** Switches this executor to wait for file descriptors using epoll
+     * instead of select. This makes the cost of a wakeup proportional to the
+     * number of ready file descriptors, and removes the FD_SETSIZE limit.
+     *
+     * Called automatically from the constructor if the executor_use_epoll
+     * constant is set. Must be called before any Selectable is registered,
+     * i.e. before the executor thread is started or on the executor thread.
+     *
+     * @return true if epoll mode is active. */
+    bool enable_epoll();
+
+    /// @return true if this executor uses epoll to wait for file descriptors.
+    bool is_epoll()
+    {
+        return epollFd_ >= 0;
+    }
+#endif
+
     /** Performs one loop of the execution on the calling thread. @return true
      * if there is more scheduled work to do. Returns false if the executor
      * loop would block right now. */
@@ -174,9 +200,22 @@ protected:
 
     void run() override {}
 
+    /** Executes a select call, and schedules any necessary executables based
+     * on the return. Sleeps at most next_timer_nsec nanoseconds (from now).
+     *
+     * @param next_timer_nsec is the maximum time to sleep in nanoseconds. */
+    void wait_with_select(long long next_timer_nsec);
+
     /** Helper object for interruptible select calls. */
     OSSelectWakeup selectHelper_;
 
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+    /** If not null, protects the select structures (fd sets, selectables and
+     * epoll state). Set by executors that call select() and unselect() from
+     * more than one thread. */
+    OSMutex *selectLock_;
+#endif
+
 private:
     /** Retrieve an item from the front of the queue.
      * @param priority pass back the priority of the queue pulled from
@@ -184,12 +223,28 @@ private:
      */
     virtual Executable *next(unsigned *priority) = 0;
 
-    /** Executes a select call, and schedules any necessary executables based
-     * on the return. Will not sleep at all if not empty, otherwise sleeps at
-     * most next_timer_nsec nanoseconds (from now).
-     *
-     * @param next_timer_nsec is the maximum time to sleep in nanoseconds. */
-    void wait_with_select(long long next_timer_nsec);
+#if OPENMRN_HAVE_EPOLL
+    /// Implementation of select() in epoll mode. @param job see select().
+    void epoll_select(Selectable *job);
+    /// Implementation of unselect() in epoll mode. @param job see unselect().
+    void epoll_unselect(Selectable *job);
+    /// Implementation of wait_with_select() in epoll mode. @param wait_length
+    /// is the maximum time to sleep in nanoseconds.
+    void wait_with_epoll(long long wait_length);
+    /// Updates the kernel's registration for a given fd to match the jobs
+    /// waiting for it. @param fd the file descriptor to update.
+    void epoll_update(int fd);
+
+    /// What we know about a file descriptor in epoll mode.
+    struct EpollFdState
+    {
+        /// Selectables waiting on this FD, indexed by SelectType - 1.
+        Selectable *jobs[3] {nullptr, nullptr, nullptr};
+        /// Event mask currently registered in the kernel. 0 if the fd is not
+        /// registered.
+        uint32_t events {0};
+    };
+#endif
 
     /// Helper function.
     ///
@@ -228,12 +283,23 @@ private:
     int selectNFds_;
     /** Head of the linked list for the select calls. */
     TypedQueue<Selectable> selectables_;
+#if OPENMRN_HAVE_EPOLL
+    /// epoll file descriptor, or -1 if we are using select.
+    int epollFd_;
+    /// Per-FD state in epoll mode, indexed by the FD number.
+    std::vector<EpollFdState> epollFds_;
+    /// Output buffer for epoll_wait.
+    std::vector<struct epoll_event> epollEvents_;
+#endif
 
+protected:
     /** Set to 1 when the executor thread has exited and it is safe to delete
      * *this. */
     unsigned done_ : 1;
     /// 1 if the executor is already running
     unsigned started_ : 1;
+
+private:
     /// How many executables we schedule blindly before calling a select() in
     /// order to find more data to read/write in the FDs being waited upon.
     unsigned selectPrescaler_ : 5;
@@ -362,8 +428,14 @@ private:
 
     DISALLOW_COPY_AND_ASSIGN(Executor);
 
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+    /// Internal queue of executables waiting to be scheduled. Other threads
+    /// add to it without taking a lock.
+    QListMpsc<NUM_PRIO> queue_;
+#else
     /// Internal queue of executables waiting to be scheduled.
     QListProtected<NUM_PRIO> queue_;
+#endif
 };
 
 /** This class can be given an executor, and will notify itself when that
@@ -0,0 +1,421 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MultiThreadExecutor.hxx
+ *
+ * An executor that runs its executables on a pool of worker threads.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _EXECUTOR_MULTITHREADEXECUTOR_HXX_
+#define _EXECUTOR_MULTITHREADEXECUTOR_HXX_
+
+#include "openmrn_features.h"
+
+#if OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "executor/Executor.hxx"
+#include "os/OS.hxx"
+
+/// Drop-in replacement for Executor<NUM_PRIO> that runs the executables on
+/// several worker threads.
+///
+/// The executor's own thread (created by start_thread() or donated by
+/// thread_body()) only runs the timers and the select loop. Each worker
+/// thread has its own run queue with its own lock. Every executable has a
+/// home worker, picked by hashing its address, and is always added to that
+/// worker's queue. A worker that runs out of work steals from the queues of
+/// the other workers, so priorities are honored only within one queue.
+///
+/// A given Executable (and thus any StateFlowBase) is never run on two
+/// workers at the same time: if a worker picks up an executable that is
+/// currently being run by a different worker, it hands it over to that
+/// worker, which will run it again right after the current run returns. This
+/// makes every state flow behave as it would on a single-threaded executor.
+///
+/// Flows that share state with other flows without locking must not be put
+/// on a MultiThreadExecutor. Notably the alias caches of IfCan are only
+/// protected by being accessed from a single executor thread
+/// (IfCan::local_aliases() asserts this), so an IfCan needs to stay on a
+/// regular Executor.
+template <unsigned NUM_PRIO> class MultiThreadExecutor : public ExecutorBase
+{
+public:
+    /// Constructor.
+    /// @param name name of executor (used for all threads)
+    /// @param num_workers how many worker threads to run executables on
+    /// @param priority thread priority of the select and worker threads
+    /// @param stack_size thread stack size
+    MultiThreadExecutor(const char *name, unsigned num_workers, int priority,
+        size_t stack_size)
+        : MultiThreadExecutor(num_workers, NO_THREAD())
+    {
+        start_thread(name, priority, stack_size);
+    }
+
+    /// Constructor that does not create a thread for running the executor.
+    /// The owner should later call start_thread() or thread_body(). The
+    /// worker threads are created when the executor thread starts.
+    /// @param num_workers how many worker threads to run executables on
+    /// @param unused unused -- just here for polymorphic disambiguation.
+    MultiThreadExecutor(unsigned num_workers, const NO_THREAD &unused)
+    {
+        HASSERT(num_workers > 0);
+        selectLock_ = &selectMutex_;
+        for (unsigned i = 0; i < num_workers; ++i)
+        {
+            workers_.emplace_back(new Worker(this, i));
+        }
+    }
+
+    /// Destructor. Waits for the executor and the workers to stop.
+    ~MultiThreadExecutor()
+    {
+        shutdown();
+    }
+
+    /// Creates a new thread for running this executor's select loop, which
+    /// then starts the worker threads.
+    ///
+    /// @param name thread name (passed to OS)
+    /// @param priority thread priority (0 == default prio)
+    /// @param stack_size number of bytes to allocate for the thread stack
+    void start_thread(const char *name, int priority, size_t stack_size)
+    {
+        threadName_ = name;
+        threadPriority_ = priority;
+        threadStackSize_ = stack_size;
+        OSThread::start(name, priority, stack_size);
+    }
+
+    /** If the executor was created with NO_THREAD, then this function needs to
+     * be called to run the executor's select loop. It will exit when the
+     * executor gets shut down. */
+    void thread_body()
+    {
+        inherit();
+    }
+
+    /// @return how many worker threads this executor has.
+    unsigned num_workers()
+    {
+        return workers_.size();
+    }
+
+    /** Send a message to this Executor's queue.
+     * @param msg Executable instance to insert into the input queue
+     * @param priority priority of message
+     */
+    void add(Executable *msg, unsigned priority = UINT_MAX) OVERRIDE
+    {
+        if (msg == active_timers())
+        {
+            // The timer list has a new head. Only the select thread evaluates
+            // timers, so there is nothing for the workers to do. Clears the
+            // pending bit of the timers.
+            msg->run();
+            selectHelper_.wakeup();
+            return;
+        }
+        if (priority >= NUM_PRIO)
+        {
+            priority = NUM_PRIO - 1;
+        }
+        Worker *home = home_worker(msg);
+        // Counted before the executable becomes visible, so that a worker
+        // that is about to sleep does not miss it.
+        ++pending_;
+        {
+            OSMutexLock l(&home->lock_);
+            home->queue_.insert_locked(msg, priority);
+            ++home->queued_;
+        }
+        if (!wake(home))
+        {
+            // The home worker is busy; somebody else may steal this.
+            for (auto &w : workers_)
+            {
+                if (wake(w.get()))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    /// @return true if there are no executables waiting on this executor.
+    /// There could still be executables running.
+    bool empty() OVERRIDE
+    {
+        return pending_ == 0;
+    }
+
+    uint32_t sequence() OVERRIDE
+    {
+        return runCount_;
+    }
+
+protected:
+    /// Thread entry point for the select thread.
+    void *entry() override
+    {
+        started_ = 1;
+        selectHelper_.lock_to_thread();
+        for (auto &w : workers_)
+        {
+            w->start(threadName_, threadPriority_, threadStackSize_);
+        }
+        while (!stopping_)
+        {
+            long long wait_length = active_timers()->get_next_timeout();
+            wait_with_select(wait_length);
+        }
+        for (unsigned i = 0; i < workers_.size(); ++i)
+        {
+            exitSem_.wait();
+        }
+        done_ = 1;
+        return nullptr;
+    }
+
+private:
+    /// One worker thread with its run queue.
+    class Worker : public OSThread
+    {
+    public:
+        /// @param parent the executor that owns this worker.
+        /// @param index position of this worker in parent->workers_.
+        Worker(MultiThreadExecutor *parent, unsigned index)
+            : parent_(parent)
+            , index_(index)
+        {
+        }
+
+        /// Thread entry point.
+        void *entry() override
+        {
+            parent_->worker_loop(this);
+            return nullptr;
+        }
+
+        /// Executor owning this worker.
+        MultiThreadExecutor *parent_;
+        /// Position of this worker in the parent's workers_.
+        unsigned index_;
+        /// Protects queue_, and the current_ / deferred_ fields of any worker
+        /// while they refer to an executable whose home is this worker.
+        OSMutex lock_;
+        /// Executables whose home is this worker, waiting to be run.
+        QList<NUM_PRIO> queue_;
+        /// Number of entries in queue_; allows skipping empty queues without
+        /// taking their lock.
+        std::atomic<unsigned> queued_ {0};
+        /// Posted when the worker is sleeping and got new work.
+        OSSem sem_;
+        /// Executable this worker is running right now.
+        std::atomic<Executable *> current_ {nullptr};
+        /// Executable that was picked up by a different worker while we were
+        /// running it. We will run it again when current_ returns.
+        Executable *deferred_ {nullptr};
+        /// True when the worker is waiting on sem_.
+        std::atomic<bool> sleeping_ {false};
+    };
+
+    /// Wakes up a worker if it is sleeping. @param w the worker. @return true
+    /// if the worker was sleeping.
+    bool wake(Worker *w)
+    {
+        if (w->sleeping_.load() && w->sleeping_.exchange(false))
+        {
+            w->sem_.post();
+            return true;
+        }
+        return false;
+    }
+
+    /// Main loop of the worker threads. @param w is the calling worker.
+    void worker_loop(Worker *w)
+    {
+        while (!stopping_)
+        {
+            Worker *home;
+            unsigned priority;
+            Executable *msg = take(w, &home, &priority);
+            if (!msg)
+            {
+                w->sleeping_ = true;
+                if (pending_ || stopping_)
+                {
+                    // Work arrived after we looked (or we are exiting).
+                    w->sleeping_ = false;
+                    continue;
+                }
+                w->sem_.wait();
+                continue;
+            }
+            if (msg == this)
+            {
+                // exit closure
+                stopping_ = true;
+                for (auto &o : workers_)
+                {
+                    o->sem_.post();
+                }
+                selectHelper_.wakeup();
+                break;
+            }
+            while (msg)
+            {
+                ++runCount_;
+                msg->run();
+                OSMutexLock l(&home->lock_);
+                msg = w->deferred_;
+                w->deferred_ = nullptr;
+                if (!msg)
+                {
+                    w->current_ = nullptr;
+                }
+            }
+        }
+        exitSem_.post();
+    }
+
+    /// Takes the next executable to run for a given worker, looking first at
+    /// the worker's own queue, then stealing from the others. Executables
+    /// that are running on some other worker are handed over to that worker.
+    /// @param w the worker that will run the executable, or nullptr if the
+    /// caller is not a worker.
+    /// @param home will be set to the home worker of the result.
+    /// @param priority will be set to the priority band of the result.
+    /// @return the executable to run or nullptr if there is no work.
+    Executable *take(Worker *w, Worker **home, unsigned *priority)
+    {
+        unsigned start = w ? w->index_ : 0;
+        for (unsigned i = 0; i < workers_.size(); ++i)
+        {
+            Worker *v = workers_[(start + i) % workers_.size()].get();
+            if (!v->queued_)
+            {
+                continue;
+            }
+            OSMutexLock l(&v->lock_);
+            while (true)
+            {
+                auto result = v->queue_.next_locked();
+                if (!result.item)
+                {
+                    break;
+                }
+                --v->queued_;
+                --pending_;
+                Executable *msg = static_cast<Executable *>(result.item);
+                // Every instance of msg goes through v's queue, and the
+                // workers set current_ to msg only under v's lock, so this
+                // check is stable while we hold the lock.
+                Worker *owner = running_worker(msg);
+                if (!owner)
+                {
+                    if (w)
+                    {
+                        w->current_ = msg;
+                    }
+                    *home = v;
+                    *priority = result.index;
+                    return msg;
+                }
+                // Two adds of the same executable while it is running would
+                // be a double insertion on a single-threaded executor as
+                // well.
+                HASSERT(!owner->deferred_);
+                owner->deferred_ = msg;
+            }
+        }
+        return nullptr;
+    }
+
+    /// @param msg an executable
+    /// @return the worker that is currently running msg, or nullptr. Must be
+    /// called with the lock of msg's home worker held.
+    Worker *running_worker(Executable *msg)
+    {
+        for (auto &w : workers_)
+        {
+            if (w->current_.load() == msg)
+            {
+                return w.get();
+            }
+        }
+        return nullptr;
+    }
+
+    /// @param msg an executable
+    /// @return the worker whose queue msg is always added to.
+    Worker *home_worker(Executable *msg)
+    {
+        uint32_t h = reinterpret_cast<uintptr_t>(msg) >> 3;
+        h *= 2654435761u;
+        return workers_[(h >> 16) % workers_.size()].get();
+    }
+
+    /// Used by loop_once() and loop_some(); takes an executable from any of
+    /// the queues.
+    Executable *next(unsigned *priority) OVERRIDE
+    {
+        Worker *home;
+        return take(nullptr, &home, priority);
+    }
+
+    /// Protects the select structures in ExecutorBase.
+    OSMutex selectMutex_;
+    /// Posted by each worker thread when it exits.
+    OSSem exitSem_;
+    /// Worker threads.
+    std::vector<std::unique_ptr<Worker>> workers_;
+    /// Total number of executables in all worker queues.
+    std::atomic<size_t> pending_ {0};
+    /// Number of executables run, returned as sequence().
+    std::atomic<uint32_t> runCount_ {0};
+    /// Set to true when the exit closure was run.
+    std::atomic<bool> stopping_ {false};
+    /// Name of the threads.
+    const char *threadName_ {"executor"};
+    /// Priority of the threads.
+    int threadPriority_ {0};
+    /// Stack size of the threads.
+    size_t threadStackSize_ {2048};
+
+    DISALLOW_COPY_AND_ASSIGN(MultiThreadExecutor);
+};
+
+#endif // OPENMRN_FEATURE_MULTI_THREAD_EXECUTOR
+
+#endif // _EXECUTOR_MULTITHREADEXECUTOR_HXX_
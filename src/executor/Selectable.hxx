@@ -35,6 +35,8 @@
 #ifndef _EXECUTOR_SELECTABLE_HXX_
 #define _EXECUTOR_SELECTABLE_HXX_
 
+#include "openmrn_features.h"
+
 /// Handler structure that ExecutorBase knows about each entry to the select
 /// call. See @ref ExecutorBase::select().
 class Selectable : public QMember
@@ -52,8 +54,14 @@ public:
     /// Helper declarations for the certain fields' maximums.
     enum Limits
     {
+#if OPENMRN_HAVE_EPOLL
+        /// Largest FD we accept (otherwise crash with error). With epoll there
+        /// is no practical limit.
+        MAX_FD = (1 << 30) - 1,
+#else
         /// Largest FD we accept (otherwise crash with error).
         MAX_FD = (1 << 14) - 1,
+#endif
         /// Largest priority we accept (otherwise we clip).
         MAX_PRIO = (1 << 16) - 1,
     };
@@ -120,8 +128,13 @@ private:
 
     /// What to watch the file for. See @ref SelectType
     unsigned selectType_ : 2;
+#if OPENMRN_HAVE_EPOLL
+    /// File descriptor to watch.
+    unsigned fd_ : 30;
+#else
     /// File descriptor to watch.
     unsigned fd_ : 14;
+#endif
     /// When the select condition is met, the Executable will be scheduled at
     /// this priority.
     unsigned priority_ : 16;
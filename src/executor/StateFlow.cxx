@@ -94,6 +94,22 @@ StateFlowBase::Action StateFlowWithQueue::wait_for_message()
     }
 }
 
+bool StateFlowWithQueue::take_next_message()
+{
+    HASSERT(!currentMessage_);
+    AtomicHolder h(this);
+    unsigned priority;
+    BufferBase *m = static_cast<BufferBase *>(queue_next(&priority));
+    if (!m)
+    {
+        return false;
+    }
+    currentMessage_ = m;
+    currentPriority_ = priority;
+    queueSize_--;
+    return true;
+}
+
 void StateFlowBase::notify()
 {
     service()->executor()->add(this);
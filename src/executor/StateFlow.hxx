@@ -1019,6 +1019,14 @@ protected:
         return exit();
     }
 
+    /** Takes the next message from the queue right away, without going
+     * through the executor. For flows that want to process several queued
+     * messages in one go. The current message must have been released or
+     * transferred already.
+     * @return true if a message was taken; it is the current message now and
+     * the flow should continue at entry(). False if the queue was empty. */
+    bool take_next_message();
+
     /// @returns the current message we are processing.
     BufferBase *message()
     {
@@ -33,6 +33,9 @@
  */
 
 #include "executor/Timer.hxx"
+
+#include <string.h>
+
 #include "executor/Executor.hxx"
 #include "os/os.h"
 
@@ -62,6 +65,25 @@ void Timer::run()
     }
 }
 
+#if OPENMRN_FEATURE_TIMER_WHEEL
+ActiveTimers::ActiveTimers(ExecutorBase *executor)
+    : tick_(OSTime::get_monotonic() >> TICK_SHIFT)
+    , nextExpiry_(INT64_MAX)
+    , count_(0)
+    , executor_(executor)
+    , isPending_(0)
+{
+    memset(slots_, 0, sizeof(slots_));
+    memset(occupied_, 0, sizeof(occupied_));
+}
+#else
+ActiveTimers::ActiveTimers(ExecutorBase *executor)
+    : executor_(executor)
+    , isPending_(0)
+{
+}
+#endif
+
 ActiveTimers::~ActiveTimers()
 {
 }
@@ -83,12 +105,287 @@ void ActiveTimers::run()
 }
 
 long long ActiveTimers::get_next_timeout()
+{
+    return get_next_timeout(OSTime::get_monotonic());
+}
+
+void ActiveTimers::schedule_timer(Timer *timer)
+{
+    OSMutexLock l(&lock_);
+    insert_locked(timer);
+}
+
+void ActiveTimers::update_timer(Timer *timer)
+{
+    HASSERT(timer);
+    OSMutexLock l(&lock_);
+    remove_locked(timer);
+    insert_locked(timer);
+}
+
+void ActiveTimers::remove_timer(Timer *timer)
+{
+    HASSERT(timer);
+    OSMutexLock l(&lock_);
+    remove_locked(timer);
+    timer->isActive_ = 0;
+}
+
+#if OPENMRN_FEATURE_TIMER_WHEEL
+
+long long ActiveTimers::get_next_timeout(long long now)
+{
+    OSMutexLock l(&lock_);
+    if (advance_locked(now))
+    {
+        return 0;
+    }
+    if (!count_)
+    {
+        nextExpiry_ = INT64_MAX;
+        // Wakes up the timer service every now and then. It won't make any
+        // difference.
+        return SEC_TO_NSEC(3600);
+    }
+    if (nextExpiry_ <= now)
+    {
+        // Some timers were removed, so the cached value is stale.
+        nextExpiry_ = find_next_expiry_locked();
+    }
+    return nextExpiry_ - now;
+}
+
+bool ActiveTimers::empty()
+{
+    OSMutexLock l(&lock_);
+    return count_ == 0;
+}
+
+void ActiveTimers::insert_locked(Timer *timer)
+{
+    HASSERT(timer);
+    HASSERT(timer->next == nullptr);
+    link_locked(timer);
+    ++count_;
+    if (timer->when_ < nextExpiry_)
+    {
+        nextExpiry_ = timer->when_;
+    }
+    // This will wake up the executor, which will schedule all expired timers
+    // and recompute sleep length.
+    notify();
+}
+
+void ActiveTimers::remove_locked(Timer *timer)
+{
+    HASSERT(timer);
+    HASSERT(timer->wheelPrev_);
+    unlink_locked(timer);
+    --count_;
+}
+
+void ActiveTimers::link_locked(Timer *timer)
+{
+    long long tick = timer->when_ >> TICK_SHIFT;
+    if (tick < tick_)
+    {
+        tick = tick_;
+    }
+    long long delta = tick - tick_;
+    unsigned level = 0;
+    while (level < NUM_LEVELS - 1 &&
+        (delta >> (LEVEL_BITS * (level + 1))) != 0)
+    {
+        ++level;
+    }
+    if ((delta >> (LEVEL_BITS * NUM_LEVELS)) != 0)
+    {
+        // Beyond the range of the wheel. Parks the timer in the last bucket;
+        // it will be re-linked when that bucket gets cascaded.
+        tick = tick_ + (1LL << (LEVEL_BITS * NUM_LEVELS)) - 1;
+    }
+    unsigned slot = (tick >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1);
+    // Buckets are unsorted; expire_slot_locked orders the expired timers.
+    QMember **head = &slots_[level][slot];
+    timer->next = *head;
+    if (*head)
+    {
+        static_cast<Timer *>(*head)->wheelPrev_ = &timer->next;
+    }
+    *head = timer;
+    timer->wheelPrev_ = head;
+    timer->wheelSlot_ = level * NUM_SLOTS + slot;
+    occupied_[level] |= 1ULL << slot;
+}
+
+void ActiveTimers::unlink_locked(Timer *timer)
+{
+    *timer->wheelPrev_ = timer->next;
+    if (timer->next)
+    {
+        static_cast<Timer *>(timer->next)->wheelPrev_ = timer->wheelPrev_;
+    }
+    unsigned level = timer->wheelSlot_ / NUM_SLOTS;
+    unsigned slot = timer->wheelSlot_ % NUM_SLOTS;
+    if (!slots_[level][slot])
+    {
+        occupied_[level] &= ~(1ULL << slot);
+    }
+    timer->next = nullptr;
+    timer->wheelPrev_ = nullptr;
+}
+
+bool ActiveTimers::advance_locked(long long now)
+{
+    long long now_tick = now >> TICK_SHIFT;
+    if (!count_)
+    {
+        if (now_tick > tick_)
+        {
+            tick_ = now_tick;
+        }
+        return false;
+    }
+    bool found_timer = false;
+    while (tick_ < now_tick)
+    {
+        unsigned idx = tick_ & (NUM_SLOTS - 1);
+        if (occupied_[0] & (1ULL << idx))
+        {
+            // Every timer in this bucket is in the past.
+            found_timer |= expire_slot_locked(idx, now);
+        }
+        // Skips empty buckets up to the end of the level 0 round.
+        long long next = tick_ - idx + NUM_SLOTS;
+        uint64_t later = idx + 1 < NUM_SLOTS ? occupied_[0] >> (idx + 1) : 0;
+        if (later)
+        {
+            next = tick_ + 1 + __builtin_ctzll(later);
+        }
+        if (next > now_tick)
+        {
+            next = now_tick;
+        }
+        tick_ = next;
+        if ((tick_ & (NUM_SLOTS - 1)) == 0)
+        {
+            cascade_locked();
+        }
+    }
+    unsigned idx = tick_ & (NUM_SLOTS - 1);
+    if (occupied_[0] & (1ULL << idx))
+    {
+        found_timer |= expire_slot_locked(idx, now);
+    }
+    return found_timer;
+}
+
+bool ActiveTimers::expire_slot_locked(unsigned slot, long long now)
+{
+    // Collects the expired timers sorted by deadline, so that they run in
+    // the same order as they would with the sorted list. The bucket has the
+    // newest timer first, so for timers scheduled in deadline order each
+    // insertion stops at the head of the expired list.
+    QMember *expired = nullptr;
+    QMember *current = slots_[0][slot];
+    while (current)
+    {
+        Timer *timer = static_cast<Timer *>(current);
+        current = current->next;
+        if (timer->when_ > now)
+        {
+            continue;
+        }
+        unlink_locked(timer);
+        --count_;
+        QMember **pos = &expired;
+        while (*pos && static_cast<Timer *>(*pos)->when_ < timer->when_)
+        {
+            pos = &(*pos)->next;
+        }
+        timer->next = *pos;
+        *pos = timer;
+    }
+    bool found_timer = expired != nullptr;
+    while (expired)
+    {
+        Timer *timer = static_cast<Timer *>(expired);
+        expired = expired->next;
+        timer->next = nullptr;
+        timer->isActive_ = 0;
+        timer->isExpired_ = 1;
+        // Puts it on the executor.
+        executor_->add(timer, timer->priority_);
+    }
+    return found_timer;
+}
+
+void ActiveTimers::cascade_locked()
+{
+    for (unsigned level = 1; level < NUM_LEVELS; ++level)
+    {
+        unsigned idx = (tick_ >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1);
+        QMember *current = slots_[level][idx];
+        slots_[level][idx] = nullptr;
+        occupied_[level] &= ~(1ULL << idx);
+        while (current)
+        {
+            Timer *timer = static_cast<Timer *>(current);
+            current = current->next;
+            timer->next = nullptr;
+            link_locked(timer);
+        }
+        if (idx != 0)
+        {
+            break;
+        }
+    }
+}
+
+long long ActiveTimers::find_next_expiry_locked()
+{
+    long long ret = INT64_MAX;
+    for (unsigned level = 0; level < NUM_LEVELS; ++level)
+    {
+        uint64_t bits = occupied_[level];
+        if (!bits)
+        {
+            continue;
+        }
+        // Buckets are in time order starting from the current one. On the
+        // higher levels the current bucket has already been cascaded, so
+        // anything there is one full round later.
+        unsigned start = (tick_ >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1);
+        if (level)
+        {
+            start = (start + 1) & (NUM_SLOTS - 1);
+        }
+        if (start)
+        {
+            bits = (bits >> start) | (bits << (NUM_SLOTS - start));
+        }
+        unsigned slot = (start + __builtin_ctzll(bits)) & (NUM_SLOTS - 1);
+        for (QMember *current = slots_[level][slot]; current;
+             current = current->next)
+        {
+            long long when = static_cast<Timer *>(current)->when_;
+            if (when < ret)
+            {
+                ret = when;
+            }
+        }
+    }
+    return ret;
+}
+
+#else // not timer wheel
+
+long long ActiveTimers::get_next_timeout(long long now)
 {
     OSMutexLock l(&lock_);
 
     QMember **last = &activeTimers_.next;
     Timer *current_timer = static_cast<Timer *>(*last);
-    long long now = OSTime::get_monotonic();
     bool found_timer = false;
     while (current_timer && current_timer->when_ <= now)
     {
@@ -130,12 +427,6 @@ bool ActiveTimers::empty() {
     return (current_timer == nullptr);
 }
 
-void ActiveTimers::schedule_timer(Timer *timer)
-{
-    OSMutexLock l(&lock_);
-    insert_locked(timer);
-}
-
 void ActiveTimers::insert_locked(Timer *timer)
 {
     HASSERT(timer);
@@ -171,18 +462,6 @@ void ActiveTimers::remove_locked(Timer *timer)
     timer->next = nullptr;
 }
 
-void ActiveTimers::update_timer(Timer *timer)
-{
-    HASSERT(timer);
-    OSMutexLock l(&lock_);
-    remove_locked(timer);
-    insert_locked(timer);
-}
+#endif // OPENMRN_FEATURE_TIMER_WHEEL
+
 
-void ActiveTimers::remove_timer(Timer *timer)
-{
-    HASSERT(timer);
-    OSMutexLock l(&lock_);
-    remove_locked(timer);
-    timer->isActive_ = 0;
-}
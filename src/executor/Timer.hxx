@@ -39,23 +39,27 @@
 #include "utils/Buffer.hxx"
 #include "utils/QMember.hxx"
 #include "os/OS.hxx"
+#include "openmrn_features.h"
 
 class Timer;
 class ExecutorBase;
 
 /** Class that manages the list of active timers. The Executor uses this class
- * tightly in its sleep-execute loop. */
+ * tightly in its sleep-execute loop.
+ *
+ * With OPENMRN_FEATURE_TIMER_WHEEL the timers are kept in a hierarchical
+ * timing wheel: NUM_LEVELS levels of NUM_SLOTS buckets each, where a bucket
+ * on level L covers NUM_SLOTS^L ticks of about a millisecond. Scheduling and
+ * cancelling a timer is O(1); timers are moved to lower levels as their
+ * deadline gets closer. Otherwise the timers are in a sorted linked list,
+ * which uses less memory but costs O(n) per insertion. */
 class ActiveTimers : public Executable
 {
 public:
     /// Constructor.
     ///
     /// @param executor parent that will use this instance.
-    ActiveTimers(ExecutorBase *executor)
-        : executor_(executor)
-        , isPending_(0)
-    {
-    }
+    ActiveTimers(ExecutorBase *executor);
 
     ~ActiveTimers();
 
@@ -104,6 +108,12 @@ public:
     void run() override;
 
 private:
+    /** Implementation of get_next_timeout().
+     * @param now is the current time (from OSTime::get_monotonic()).
+     * @returns the timer in nanoseconds to sleep until the next timer to wake
+     * up. */
+    long long get_next_timeout(long long now);
+
     /** Removes a timer from the active list. Assert fails if it is not
      * there. Caller must hold the lock. 
      * @param timer what to remove from the active list. */
@@ -113,12 +123,70 @@ private:
      * @param timer what to insert into the active list. */
     void insert_locked(::Timer *timer);
 
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /// log2 of the length of a wheel tick in nanoseconds (~1 msec).
+    static constexpr unsigned TICK_SHIFT = 20;
+    /// log2 of the number of buckets per level.
+    static constexpr unsigned LEVEL_BITS = 6;
+    /// Number of buckets per level.
+    static constexpr unsigned NUM_SLOTS = 1 << LEVEL_BITS;
+    /// Number of levels. Timers further out than NUM_SLOTS ^ NUM_LEVELS ticks
+    /// (about 13 days) are parked in the last bucket of the top level.
+    static constexpr unsigned NUM_LEVELS = 5;
+
+    /** Links a timer into the bucket matching its deadline. Does not touch
+     * the counters.
+     * @param timer what to link. */
+    void link_locked(::Timer *timer);
+
+    /** Unlinks a timer from its bucket. Does not touch the counters.
+     * @param timer what to unlink. */
+    void unlink_locked(::Timer *timer);
+
+    /** Moves the wheel forward to the given time, putting all expired timers
+     * onto the executor.
+     * @param now current time in nanoseconds.
+     * @return true if any timer expired. */
+    bool advance_locked(long long now);
+
+    /** Expires the timers of a level 0 bucket.
+     * @param slot which bucket of level 0.
+     * @param now current time; timers later than this stay in the bucket.
+     * @return true if any timer expired. */
+    bool expire_slot_locked(unsigned slot, long long now);
+
+    /** Moves the timers of the higher level buckets that correspond to the
+     * current tick to the lower levels. Called whenever the current tick
+     * crosses a bucket boundary of level 1. */
+    void cascade_locked();
+
+    /// @return the deadline of the earliest scheduled timer, INT64_MAX if
+    /// there are no timers.
+    long long find_next_expiry_locked();
+
+    /// Bucket lists. Each timer's wheelPrev_ points to the pointer that
+    /// points to it.
+    QMember *slots_[NUM_LEVELS][NUM_SLOTS];
+    /// Bit N in occupied_[L] is set if slots_[L][N] is not empty.
+    uint64_t occupied_[NUM_LEVELS];
+    /// Next tick of the wheel to process. Every timer with a deadline before
+    /// this tick has been expired.
+    long long tick_;
+    /// No timer expires before this time. Might be earlier than the actual
+    /// first deadline when timers were removed.
+    long long nextExpiry_;
+    /// Number of timers in the wheel.
+    unsigned count_;
+#endif
+
     /// Parent.
     ExecutorBase *executor_;
     /// Protects the timer list.
     OSMutex lock_;
+#if !OPENMRN_FEATURE_TIMER_WHEEL
     /// List of timers that are scheduled.
     QMember activeTimers_;
+#endif
     /// 1 if we in the executor's queue.
     unsigned isPending_ : 1;
 
@@ -138,6 +206,10 @@ public:
      */
     Timer(ActiveTimers *timers)
         : activeTimers_(timers)
+#if OPENMRN_FEATURE_TIMER_WHEEL
+        , wheelPrev_(nullptr)
+        , wheelSlot_(0)
+#endif
         , priority_(UINT_MAX)
         , when_(0)
         , period_(0)
@@ -280,6 +352,13 @@ private:
 
     /** Points to the executor's timer structure. Not owned. */
     ActiveTimers *activeTimers_;
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /** Points to the pointer that points to this timer in the wheel, or
+     * nullptr if the timer is not in the wheel. */
+    QMember **wheelPrev_;
+    /** Level * NUM_SLOTS + bucket index in the wheel. */
+    uint16_t wheelSlot_;
+#endif
     /** what priority to schedule this timer at */
     unsigned priority_;
     /** when in nanoseconds timer should expire */
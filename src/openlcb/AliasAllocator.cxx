@@ -34,6 +34,7 @@
 
 #include "openlcb/AliasAllocator.hxx"
 #include "openlcb/CanDefs.hxx"
+#include "nmranet_config.h"
 
 namespace openlcb
 {
@@ -45,9 +46,13 @@ AliasAllocator::AliasAllocator(NodeID if_id, IfCan *if_can)
     , conflictHandler_(this)
     , timer_(this)
     , if_id_(if_id)
+    , maxBatch_(config_alias_allocator_batch_size())
+    , lowWater_(config_reserved_alias_low_water())
+    , fillPending_(0)
+    , batchIndex_(0)
     , cid_frame_sequence_(0)
-    , conflict_detected_(0)
 {
+    HASSERT(maxBatch_ > 0);
     reinit_seed();
     // Moves all the allocated alias buffers over to the input queue for
     // allocation.
@@ -100,28 +105,109 @@ void AliasAllocator::return_alias(NodeID id, NodeAlias alias)
     }
 }
 
+void AliasAllocator::reserve_aliases(unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        auto *b = alloc();
+        b->data()->reset();
+        {
+            AtomicHolder h(this);
+            ++fillPending_;
+        }
+        send(b);
+    }
+}
+
 AliasAllocator::~AliasAllocator()
 {
+    for (auto *b : heldBack_)
+    {
+        b->unref();
+    }
 }
 
 StateFlowBase::Action AliasAllocator::entry()
 {
+    HASSERT(message()->data()->state == AliasInfo::STATE_EMPTY);
+    {
+        AtomicHolder h(this);
+        if (fillPending_)
+        {
+            --fillPending_;
+        }
+        else if (lowWater_ && reserved_alias_pool_.pending() >= lowWater_)
+        {
+            // Enough aliases in the pool, this one can wait.
+            heldBack_.push_back(transfer_message());
+            return exit();
+        }
+    }
+    HASSERT(batch_.empty());
+    batch_.push_back(transfer_message());
+    while (batch_.size() < maxBatch_ && !heldBack_.empty())
+    {
+        batch_.push_back(heldBack_.back());
+        heldBack_.pop_back();
+    }
+    while (batch_.size() < maxBatch_ && take_next_message())
+    {
+        batch_.push_back(transfer_message());
+        AtomicHolder h(this);
+        if (fillPending_)
+        {
+            --fillPending_;
+        }
+    }
+    for (auto *b : batch_)
+    {
+        HASSERT(b->data()->state == AliasInfo::STATE_EMPTY);
+        start_alias(b->data());
+    }
+    batchIndex_ = 0;
     cid_frame_sequence_ = 7;
-    conflict_detected_ = 0;
-    HASSERT(pending_alias()->state == AliasInfo::STATE_EMPTY);
-    while (!pending_alias()->alias)
+    // Grabs an outgoing frame buffer.
+    return call_immediately(STATE(handle_allocate_for_cid_frame));
+}
+
+void AliasAllocator::start_alias(AliasInfo *a)
+{
+    if (a->alias)
+    {
+        stop_alias(a);
+        // Burns up the alias.
+        a->alias = 0;
+    }
+    while (!a->alias)
     {
-        pending_alias()->alias = seed_;
+        a->alias = seed_;
         next_seed();
         // TODO(balazs.racz): check if the alias is already known about.
     }
+    a->state = AliasInfo::STATE_CHECKING;
     // Registers ourselves as a handler for incoming CAN frames to detect
     // conflicts.
     if_can()->frame_dispatcher()->register_handler(
-        &conflictHandler_, pending_alias()->alias, ~0x1FFFF000U);
+        &conflictHandler_, a->alias, ~0x1FFFF000U);
+}
 
-    // Grabs an outgoing frame buffer.
-    return call_immediately(STATE(handle_allocate_for_cid_frame));
+void AliasAllocator::stop_alias(AliasInfo *a)
+{
+    // Marks that we are no longer interested in frames from this alias.
+    if_can()->frame_dispatcher()->unregister_handler(
+        &conflictHandler_, a->alias, ~0x1FFFF000U);
+}
+
+bool AliasAllocator::all_conflicted()
+{
+    for (auto *b : batch_)
+    {
+        if (b->data()->state != AliasInfo::STATE_CONFLICT)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 void AliasAllocator::next_seed()
@@ -144,7 +230,7 @@ void AliasAllocator::next_seed()
 
 StateFlowBase::Action AliasAllocator::handle_allocate_for_cid_frame()
 {
-    if (cid_frame_sequence_ >= 4)
+    if (batchIndex_ < batch_.size())
     {
         return allocate_and_call(if_can()->frame_write_flow(),
                                  STATE(send_cid_frame));
@@ -158,42 +244,48 @@ StateFlowBase::Action AliasAllocator::handle_allocate_for_cid_frame()
 
 StateFlowBase::Action AliasAllocator::send_cid_frame()
 {
-    LOG(VERBOSE, "Sending CID frame %d for alias %03x", cid_frame_sequence_,
-        pending_alias()->alias);
+    AliasInfo *a = batch_[batchIndex_]->data();
     auto *b = get_allocation_result(if_can()->frame_write_flow());
-    struct can_frame *f = b->data()->mutable_frame();
-    if (conflict_detected_)
+    if (a->state == AliasInfo::STATE_CONFLICT)
     {
+        // Starts over with this entry.
         b->unref();
-        return call_immediately(STATE(handle_alias_conflict));
+        start_alias(a);
+        cid_frame_sequence_ = 7;
+        return call_immediately(STATE(handle_allocate_for_cid_frame));
     }
-    CanDefs::control_init(*f, pending_alias()->alias,
+    LOG(VERBOSE, "Sending CID frame %d for alias %03x", cid_frame_sequence_,
+        a->alias);
+    struct can_frame *f = b->data()->mutable_frame();
+    CanDefs::control_init(*f, a->alias,
                         (if_id_ >> (12 * (cid_frame_sequence_ - 4))) & 0xfff,
                         cid_frame_sequence_);
     b->set_done(n_.reset(this));
     if_can()->frame_write_flow()->send(b);
-    --cid_frame_sequence_;
+    if (--cid_frame_sequence_ < 4)
+    {
+        ++batchIndex_;
+        cid_frame_sequence_ = 7;
+    }
     return wait_and_call(STATE(handle_allocate_for_cid_frame));
 }
 
-StateFlowBase::Action AliasAllocator::handle_alias_conflict()
+StateFlowBase::Action AliasAllocator::wait_done()
 {
-    // Marks that we are no longer interested in frames from this alias.
-    if_can()->frame_dispatcher()->unregister_handler(
-        &conflictHandler_, pending_alias()->alias, ~0x1FFFF000U);
-
-    // Burns up the alias.
-    pending_alias()->alias = 0;
-    pending_alias()->state = AliasInfo::STATE_EMPTY;
-    // Restarts the lookup.
-    return call_immediately(STATE(entry));
+    batchIndex_ = 0;
+    return call_immediately(STATE(next_rid_frame));
 }
 
-StateFlowBase::Action AliasAllocator::wait_done()
+StateFlowBase::Action AliasAllocator::next_rid_frame()
 {
-    if (conflict_detected_)
+    while (batchIndex_ < batch_.size() &&
+        batch_[batchIndex_]->data()->state == AliasInfo::STATE_CONFLICT)
     {
-        return call_immediately(STATE(handle_alias_conflict));
+        ++batchIndex_;
+    }
+    if (batchIndex_ >= batch_.size())
+    {
+        return call_immediately(STATE(round_done));
     }
     // grab a frame buffer for the RID frame.
     return allocate_and_call(if_can()->frame_write_flow(),
@@ -202,43 +294,75 @@ StateFlowBase::Action AliasAllocator::wait_done()
 
 StateFlowBase::Action AliasAllocator::send_rid_frame()
 {
-    LOG(VERBOSE, "Sending RID frame for alias %03x", pending_alias()->alias);
     auto *b = get_allocation_result(if_can()->frame_write_flow());
-    struct can_frame *f = b->data()->mutable_frame();
-    CanDefs::control_init(*f, pending_alias()->alias, CanDefs::RID_FRAME, 0);
-    if (conflict_detected_)
+    Buffer<AliasInfo> *entry = batch_[batchIndex_];
+    AliasInfo *a = entry->data();
+    if (a->state == AliasInfo::STATE_CONFLICT)
     {
         b->unref();
-        return call_immediately(STATE(handle_alias_conflict));
+        return call_immediately(STATE(next_rid_frame));
     }
+    LOG(VERBOSE, "Sending RID frame for alias %03x", a->alias);
+    struct can_frame *f = b->data()->mutable_frame();
+    CanDefs::control_init(*f, a->alias, CanDefs::RID_FRAME, 0);
     if_can()->frame_write_flow()->send(b);
     // The alias is reserved, put it into the freelist.
-    pending_alias()->state = AliasInfo::STATE_RESERVED;
-    if_can()->frame_dispatcher()->unregister_handler(
-        &conflictHandler_, pending_alias()->alias, ~0x1FFFF000U);
+    a->state = AliasInfo::STATE_RESERVED;
+    stop_alias(a);
     if_can()->local_aliases()->add(AliasCache::RESERVED_ALIAS_NODE_ID,
-                                   pending_alias()->alias);
-    reserved_alias_pool_.insert(transfer_message());
-    return release_and_exit();
+                                   a->alias);
+    batch_.erase(batch_.begin() + batchIndex_);
+    reserved_alias_pool_.insert(entry);
+    return call_immediately(STATE(next_rid_frame));
+}
+
+StateFlowBase::Action AliasAllocator::round_done()
+{
+    if (batch_.empty())
+    {
+        return exit();
+    }
+    // Whatever is left has seen a conflict. These get new aliases and go
+    // through the CID sequence again.
+    for (auto *b : batch_)
+    {
+        start_alias(b->data());
+    }
+    batchIndex_ = 0;
+    cid_frame_sequence_ = 7;
+    return call_immediately(STATE(handle_allocate_for_cid_frame));
 }
 
 void AliasAllocator::ConflictHandler::send(Buffer<CanMessageData> *message,
                                                 unsigned priority)
 {
-    if (parent_->conflict_detected_) {
-        message->unref();
+    NodeAlias alias = CanDefs::get_src(message->data()->id());
+    message->unref();
+    AliasInfo *a = nullptr;
+    for (auto *b : parent_->batch_)
+    {
+        if (b->data()->alias == alias)
+        {
+            a = b->data();
+            break;
+        }
+    }
+    if (!a || a->state == AliasInfo::STATE_CONFLICT)
+    {
         return;
     }
-    parent_->conflict_detected_ = 1;
+    a->state = AliasInfo::STATE_CONFLICT;
     g_alias_test_conflicts++;
-    if (parent_->is_state(static_cast<StateFlowBase::Callback>(&AliasAllocator::wait_done))) {
+    if (parent_->is_state(static_cast<StateFlowBase::Callback>(
+            &AliasAllocator::wait_done)) &&
+        parent_->all_conflicted())
+    {
         /* Wakes up the actual flow to not have to wait all the 200 ms of
          * sleep. This will request the timer callback to be issued
          * immediately, which avoids race condition between the trigger and the
          * regular timeout call. */
         parent_->timer_.trigger();
     }
-    message->unref();
 }
 
 void AliasAllocator::TEST_finish_pending_allocation() {
@@ -35,9 +35,12 @@
 #ifndef _OPENLCB_ALIASALLOCATOR_HXX_
 #define _OPENLCB_ALIASALLOCATOR_HXX_
 
+#include <vector>
+
 #include "openlcb/IfCan.hxx"
 #include "openlcb/Defs.hxx"
 #include "executor/StateFlow.hxx"
+#include "utils/LatencyHistogram.hxx"
 
 namespace openlcb
 {
@@ -89,6 +92,16 @@ struct AliasInfo
  * standard-compliant flow of reserving an alias, and then push the alias into
  * the queue of reserved aliases.
  *
+ * Buffers that are queued up at the time a reservation starts are processed
+ * together, up to the batch size: the CID frames of all of them are sent
+ * back-to-back, they share a single 200 msec wait, then the RID frames are
+ * sent. An alias that sees a conflict gets a fresh alias and goes into the
+ * next round, the others are reserved.
+ *
+ * With a non-zero low-water mark, buffers sent back for reallocation are held
+ * while at least that many reserved aliases are available, then they are
+ * reserved together once the pool drops below the mark.
+ *
  * Users who need an allocated alias should get it from the queue in
  * reserved_aliases().
  */
@@ -126,6 +139,50 @@ public:
      * the reserved aliases queue. */
     void return_alias(NodeID id, NodeAlias alias);
 
+    /** Starts reserving more aliases. They will show up in
+     * reserved_aliases() after at least 200 msec.
+     * @param count how many aliases to reserve. */
+    void reserve_aliases(unsigned count);
+
+    /** Sets how many aliases are checked at the same time.
+     * @param size max number of CID sequences sharing one 200 msec wait; at
+     * least 1. The default is config_alias_allocator_batch_size(). */
+    void set_batch_size(unsigned size)
+    {
+        HASSERT(size > 0);
+        maxBatch_ = size;
+    }
+
+    /** Sets the low-water mark of the reserved alias pool.
+     * @param count reallocations are held back while at least this many
+     * aliases are reserved. 0 disables holding back. The default is
+     * config_reserved_alias_low_water(). */
+    void set_low_water(unsigned count)
+    {
+        lowWater_ = count;
+    }
+
+    /** Records how long a user waited for a reserved alias.
+     * @param nsec time between asking for and getting the alias. */
+    void record_alias_wait(long long nsec)
+    {
+        waitHistogram_.add(nsec);
+    }
+
+    /** @return the distribution of times users waited for a reserved
+     * alias. */
+    const LatencyHistogram &alias_wait_histogram()
+    {
+        return waitHistogram_;
+    }
+
+    /** @return the number of reallocation buffers that are held back
+     * because the reserved alias pool is above the low-water mark. */
+    size_t num_held_back()
+    {
+        return heldBack_.size();
+    }
+
     /** If there is a pending alias allocation waiting for the timer to expire,
      * finishes it immediately. Needed in test destructors. */
     void TEST_finish_pending_allocation();
@@ -151,18 +208,27 @@ private:
 
     friend class ConflictHandler;
 
-    AliasInfo *pending_alias()
-    {
-        return message()->data();
-    }
+    /// Buffers of aliases in the current reservation round.
+    typedef std::vector<Buffer<AliasInfo> *> Batch;
 
     Action entry() override;
     Action handle_allocate_for_cid_frame();
     Action send_cid_frame();
     Action wait_done();
+    Action next_rid_frame();
     Action send_rid_frame();
+    Action round_done();
+
+    /** Picks a new alias for an entry of the batch and starts listening for
+     * conflicts on it. @param a the entry; its alias will be regenerated if
+     * it was already set. */
+    void start_alias(AliasInfo *a);
+
+    /** Stops listening for conflicts on an alias. @param a batch entry. */
+    void stop_alias(AliasInfo *a);
 
-    Action handle_alias_conflict();
+    /// @return true if all aliases of the current batch have seen a conflict.
+    bool all_conflicted();
 
     /// Generates the next alias to check in the seed_ variable.
     void next_seed();
@@ -180,6 +246,28 @@ private:
     /// 48-bit nodeID that we will use for alias reservations.
     NodeID if_id_;
 
+    /// Aliases being checked in the current round.
+    Batch batch_;
+
+    /// Reallocation buffers waiting for the pool to get below lowWater_.
+    Batch heldBack_;
+
+    /// Distribution of how long users waited for an alias.
+    LatencyHistogram waitHistogram_;
+
+    /// Max number of entries in batch_.
+    unsigned maxBatch_;
+
+    /// Low-water mark of the reserved alias pool; 0 if disabled.
+    unsigned lowWater_;
+
+    /// How many buffers sent by reserve_aliases() have not been picked up
+    /// yet. These are never held back.
+    unsigned fillPending_;
+
+    /// Which entry of batch_ we are sending CID or RID frames for.
+    unsigned batchIndex_;
+
     /** Physical interface for sending packets and assigning handlers to
      * received packets. */
     IfCan *if_can()
@@ -189,8 +277,6 @@ private:
 
     /// Which CID frame are we trying to send out. Valid values: 7..4
     unsigned cid_frame_sequence_ : 3;
-    /// Set to 1 if an incoming frame signals an alias conflict.
-    unsigned conflict_detected_ : 1;
 
     /// Seed for generating random-looking alias numbers.
     unsigned seed_ : 12;
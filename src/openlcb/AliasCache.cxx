@@ -33,6 +33,8 @@
 
 #include "openlcb/AliasCache.hxx"
 
+#include <string.h>
+
 #include "os/OS.hxx"
 
 namespace openlcb
@@ -299,4 +301,331 @@ void AliasCache::touch(Metadata* metadata)
     }
 }
 
+HashAliasCache::HashAliasCache(NodeID seed, size_t entries,
+    void (*remove_callback)(NodeID id, NodeAlias alias, void *), void *context)
+    : seed_(seed)
+    , entries_(entries)
+    , removeCallback_(remove_callback)
+    , context_(context)
+{
+    HASSERT(entries > 0 && entries < 0x8000);
+    // Keeps the index tables at most half full.
+    unsigned bits = 2;
+    while ((1u << bits) < 2 * entries)
+    {
+        ++bits;
+    }
+    indexMask_ = (1u << bits) - 1;
+    indexShift_ = 32 - bits;
+    pool_ = new Entry[entries];
+    aliasIndex_ = new uint16_t[indexMask_ + 1];
+    idIndex_ = new uint16_t[indexMask_ + 1];
+    clear();
+}
+
+HashAliasCache::~HashAliasCache()
+{
+    delete[] idIndex_;
+    delete[] aliasIndex_;
+    delete[] pool_;
+}
+
+void HashAliasCache::clear()
+{
+    memset(aliasIndex_, 0xFF, (indexMask_ + 1) * sizeof(uint16_t));
+    memset(idIndex_, 0xFF, (indexMask_ + 1) * sizeof(uint16_t));
+    oldest_ = NONE;
+    newest_ = NONE;
+    freeList_ = NONE;
+    used_ = 0;
+    for (size_t i = entries_; i-- > 0;)
+    {
+        pool_[i].id = 0;
+        pool_[i].alias = 0;
+        pool_[i].newer = NONE;
+        pool_[i].older = freeList_;
+        freeList_ = i;
+    }
+}
+
+unsigned HashAliasCache::find_alias(NodeAlias alias)
+{
+    unsigned pos = alias_home(alias);
+    while (aliasIndex_[pos] != NONE && pool_[aliasIndex_[pos]].alias != alias)
+    {
+        pos = (pos + 1) & indexMask_;
+    }
+    return pos;
+}
+
+unsigned HashAliasCache::find_id(NodeID id)
+{
+    unsigned pos = id_home(id);
+    while (idIndex_[pos] != NONE && pool_[idIndex_[pos]].id != id)
+    {
+        pos = (pos + 1) & indexMask_;
+    }
+    return pos;
+}
+
+void HashAliasCache::erase_index(uint16_t *index, unsigned pos)
+{
+    unsigned hole = pos;
+    unsigned next = pos;
+    while (true)
+    {
+        index[hole] = NONE;
+        while (true)
+        {
+            next = (next + 1) & indexMask_;
+            uint16_t e = index[next];
+            if (e == NONE)
+            {
+                return;
+            }
+            unsigned home = index == aliasIndex_ ? alias_home(pool_[e].alias)
+                                                 : id_home(pool_[e].id);
+            // The entry at next may stay if its home is cyclically in
+            // (hole, next]; otherwise it moves into the hole.
+            bool stays = hole <= next ? (hole < home && home <= next)
+                                      : (hole < home || home <= next);
+            if (!stays)
+            {
+                index[hole] = e;
+                hole = next;
+                break;
+            }
+        }
+    }
+}
+
+void HashAliasCache::unlink(uint16_t e)
+{
+    Entry *m = pool_ + e;
+    if (m->newer != NONE)
+    {
+        pool_[m->newer].older = m->older;
+    }
+    else
+    {
+        newest_ = m->older;
+    }
+    if (m->older != NONE)
+    {
+        pool_[m->older].newer = m->newer;
+    }
+    else
+    {
+        oldest_ = m->newer;
+    }
+}
+
+void HashAliasCache::link_newest(uint16_t e)
+{
+    Entry *m = pool_ + e;
+    m->newer = NONE;
+    m->older = newest_;
+    if (newest_ != NONE)
+    {
+        pool_[newest_].newer = e;
+    }
+    else
+    {
+        oldest_ = e;
+    }
+    newest_ = e;
+}
+
+void HashAliasCache::free_entry(uint16_t e)
+{
+    Entry *m = pool_ + e;
+    erase_index(aliasIndex_, find_alias(m->alias));
+    erase_index(idIndex_, find_id(m->id));
+    unlink(e);
+    m->id = 0;
+    m->alias = 0;
+    m->newer = NONE;
+    m->older = freeList_;
+    freeList_ = e;
+    --used_;
+}
+
+void HashAliasCache::add(NodeID id, NodeAlias alias)
+{
+    HASSERT(id != 0);
+    HASSERT(alias != 0);
+
+    unsigned apos = find_alias(alias);
+    uint16_t e = aliasIndex_[apos];
+    if (e != NONE)
+    {
+        /* we already have a mapping for this alias, so lets remove it */
+        NodeID old_id = pool_[e].id;
+        free_entry(e);
+        if (removeCallback_)
+        {
+            (*removeCallback_)(old_id, alias, context_);
+        }
+    }
+    unsigned ipos = find_id(id);
+    e = idIndex_[ipos];
+    if (e != NONE)
+    {
+        /* this node had a different alias; that mapping is stale now */
+        NodeAlias old_alias = pool_[e].alias;
+        free_entry(e);
+        if (removeCallback_)
+        {
+            (*removeCallback_)(id, old_alias, context_);
+        }
+    }
+
+    if (freeList_ == NONE)
+    {
+        /* kick out the oldest mapping */
+        HASSERT(oldest_ != NONE);
+        e = oldest_;
+        NodeID old_id = pool_[e].id;
+        NodeAlias old_alias = pool_[e].alias;
+        free_entry(e);
+        if (removeCallback_)
+        {
+            (*removeCallback_)(old_id, old_alias, context_);
+        }
+    }
+
+    e = freeList_;
+    freeList_ = pool_[e].older;
+    ++used_;
+    pool_[e].id = id;
+    pool_[e].alias = alias;
+    link_newest(e);
+
+    // Any of the removals above may have moved slots around.
+    aliasIndex_[find_alias(alias)] = e;
+    idIndex_[find_id(id)] = e;
+}
+
+void HashAliasCache::remove(NodeAlias alias)
+{
+    uint16_t e = aliasIndex_[find_alias(alias)];
+    if (e != NONE)
+    {
+        free_entry(e);
+    }
+}
+
+bool HashAliasCache::retrieve(unsigned entry, NodeID *node, NodeAlias *alias)
+{
+    HASSERT(entry < size());
+    Entry *m = pool_ + entry;
+    if (!m->alias)
+        return false;
+    if (node)
+        *node = m->id;
+    if (alias)
+        *alias = m->alias;
+    return true;
+}
+
+NodeAlias HashAliasCache::lookup(NodeID id)
+{
+    HASSERT(id != 0);
+    uint16_t e = idIndex_[find_id(id)];
+    if (e == NONE)
+    {
+        return 0;
+    }
+    touch(e);
+    return pool_[e].alias;
+}
+
+NodeID HashAliasCache::lookup(NodeAlias alias)
+{
+    HASSERT(alias != 0);
+    uint16_t e = aliasIndex_[find_alias(alias)];
+    if (e == NONE)
+    {
+        return 0;
+    }
+    touch(e);
+    return pool_[e].id;
+}
+
+void HashAliasCache::for_each(
+    void (*callback)(void *, NodeID, NodeAlias), void *context)
+{
+    HASSERT(callback != NULL);
+    for (uint16_t e = newest_; e != NONE; e = pool_[e].older)
+    {
+        (*callback)(context, pool_[e].id, pool_[e].alias);
+    }
 }
+
+NodeAlias HashAliasCache::generate()
+{
+    NodeAlias alias;
+
+    do
+    {
+        /* calculate the alias given the current seed */
+        alias = (seed_ ^ (seed_ >> 12) ^ (seed_ >> 24) ^ (seed_ >> 36)) & 0xfff;
+
+        /* calculate the next seed */
+        seed_ = ((((1 << 9) + 1) * (seed_) + CONSTANT)) & 0xffffffffffff;
+    } while (alias == 0 || lookup(alias) != 0);
+
+    /* new random alias */
+    return alias;
+}
+
+int HashAliasCache::check_consistency()
+{
+    unsigned in_alias = 0;
+    unsigned in_id = 0;
+    for (unsigned i = 0; i <= indexMask_; ++i)
+    {
+        uint16_t e = aliasIndex_[i];
+        if (e != NONE)
+        {
+            if (e >= entries_ || pool_[e].alias == 0)
+                return 1;
+            if (find_alias(pool_[e].alias) != i)
+                return 2; // unreachable from its home slot
+            ++in_alias;
+        }
+        e = idIndex_[i];
+        if (e != NONE)
+        {
+            if (e >= entries_ || pool_[e].id == 0)
+                return 3;
+            if (find_id(pool_[e].id) != i)
+                return 4;
+            ++in_id;
+        }
+    }
+    if (in_alias != used_ || in_id != used_)
+        return 5;
+    unsigned free_count = 0;
+    for (uint16_t e = freeList_; e != NONE; e = pool_[e].older)
+    {
+        if (pool_[e].alias != 0 || ++free_count > entries_)
+            return 6;
+    }
+    if (free_count + used_ != entries_)
+        return 7;
+    unsigned lru_count = 0;
+    uint16_t prev = NONE;
+    for (uint16_t e = oldest_; e != NONE; e = pool_[e].newer)
+    {
+        if (pool_[e].older != prev || pool_[e].alias == 0 ||
+            ++lru_count > entries_)
+            return 8;
+        prev = e;
+    }
+    if (prev != newest_ || lru_count != used_)
+        return 9;
+    return 0;
+}
+
+} // namespace openlcb
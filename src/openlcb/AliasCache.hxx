@@ -214,6 +214,190 @@ private:
     DISALLOW_COPY_AND_ASSIGN(AliasCache);
 };
 
+/** Cache of alias to node id mappings with the same interface and eviction
+ * behavior as AliasCache, stored in flat arrays instead of tree nodes.
+ *
+ * Each mapping lives in one entry of a fixed array. Two open-addressed
+ * (linear probing) index tables, one keyed by alias and one by Node ID, store
+ * the entry number; the least recently used list is kept as entry numbers in
+ * the entries themselves. There is no per-entry heap allocation, and a lookup
+ * touches one or two cache lines in the index table plus the entry.
+ *
+ * Unlike AliasCache no time stamps are kept, because nothing reads them.
+ * Adding a Node ID that is already in the cache under a different alias
+ * replaces the old mapping (calling the remove callback for it).
+ *
+ * There is no mutual exclusion locking mechanism built into this class.
+ */
+class HashAliasCache
+{
+public:
+    /** Constructor.
+     * @param seed starting seed for generation of aliases
+     * @param entries maximum number of entries in this cache, at most 32767
+     * @param remove_callback callback to call when we remove a mapping from
+     *        the cache however it will not be called in the remove() method
+     * @param context context pointer to pass to remove_callback
+     */
+    HashAliasCache(NodeID seed, size_t entries,
+        void (*remove_callback)(NodeID id, NodeAlias alias, void *) = NULL,
+        void *context = NULL);
+
+    ~HashAliasCache();
+
+    /** Reinitializes the entire map. */
+    void clear();
+
+    /** Add an alias to an alias cache.
+     * @param id 48-bit NMRAnet Node ID to associate alias with
+     * @param alias 12-bit alias associated with Node ID
+     */
+    void add(NodeID id, NodeAlias alias);
+
+    /** Remove an alias from an alias cache.  This method does not call the
+     * remove_callback method passed in at construction since it is a
+     * deliberate call not requiring notification.
+     * @param alias 12-bit alias associated with Node ID
+     */
+    void remove(NodeAlias alias);
+
+    /** Lookup a node's alias based on its Node ID.
+     * @param id Node ID to look for
+     * @return alias that matches the Node ID, else 0 if not found
+     */
+    NodeAlias lookup(NodeID id);
+
+    /** Lookup a node's ID based on its alias.
+     * @param alias alias to look for
+     * @return Node ID that matches the alias, else 0 if not found
+     */
+    NodeID lookup(NodeAlias alias);
+
+    /** Call the given callback function once for each alias tracked.  The order
+     * will be in last "touched" order.
+     * @param callback method to call
+     * @param context context pointer to pass to callback
+     */
+    void for_each(void (*callback)(void*, NodeID, NodeAlias), void *context);
+
+    /** Returns the total number of aliases that can be cached. */
+    size_t size()
+    {
+        return entries_;
+    }
+
+    /** Retrieves an entry by index. Allows stable iteration in the face of
+     * changes.
+     * @param entry is between 0 and size() - 1.
+     * @param node will be filled with the node ID. May be null.
+     * @param alias will be filled with the alias. May be null.
+     * @return true if the entry is valid, and node and alias were filled,
+     * otherwise false if the entry is not allocated.
+     */
+    bool retrieve(unsigned entry, NodeID* node, NodeAlias* alias);
+
+    /** Generate a 12-bit pseudo-random alias for a givin alias cache.
+     * @return pseudo-random 12-bit alias, an alias of zero is invalid
+     */
+    NodeAlias generate();
+
+    /** Visible for testing. Check internal consistency.
+     * @return 0 if everything is fine, otherwise a number identifying the
+     * failed check. */
+    int check_consistency();
+
+private:
+    /** Entry number used as a null pointer, and empty index table slot. */
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    /** One alias to Node ID mapping. */
+    struct Entry
+    {
+        NodeID id; /**< 48-bit NMRAnet Node ID, 0 if unused */
+        NodeAlias alias; /**< NMRAnet alias, 0 if unused */
+        uint16_t newer; /**< next newest entry, or NONE */
+        uint16_t older; /**< next oldest entry or next free entry, or NONE */
+    };
+
+    /** @return home slot of an alias in aliasIndex_. */
+    unsigned alias_home(NodeAlias alias)
+    {
+        return ((uint32_t)alias * 0x9E3779B1u) >> indexShift_;
+    }
+
+    /** @return home slot of a Node ID in idIndex_. */
+    unsigned id_home(NodeID id)
+    {
+        return (uint32_t)((id * 0x9E3779B97F4A7C15ull) >> 32) >> indexShift_;
+    }
+
+    /** @return the index table slot holding alias, or the empty slot where
+     * it would be inserted. */
+    unsigned find_alias(NodeAlias alias);
+
+    /** @return the index table slot holding id, or the empty slot where it
+     * would be inserted. */
+    unsigned find_id(NodeID id);
+
+    /** Removes a slot from one of the index tables, shifting back the
+     * following entries of its probe sequence.
+     * @param index is aliasIndex_ or idIndex_.
+     * @param pos slot to empty
+     */
+    void erase_index(uint16_t *index, unsigned pos);
+
+    /** Removes an entry from both index tables and the LRU list, and puts it
+     * onto the free list.
+     * @param e entry number to free
+     */
+    void free_entry(uint16_t e);
+
+    /** Unlinks an entry from the LRU list. */
+    void unlink(uint16_t e);
+
+    /** Links an unlinked entry to the newest end of the LRU list. */
+    void link_newest(uint16_t e);
+
+    /** Update the LRU position for a given entry. */
+    void touch(uint16_t e)
+    {
+        if (e != newest_)
+        {
+            unlink(e);
+            link_newest(e);
+        }
+    }
+
+    /** All mappings. */
+    Entry *pool_;
+    /** Open addressed table of alias to entry number. */
+    uint16_t *aliasIndex_;
+    /** Open addressed table of Node ID to entry number. */
+    uint16_t *idIndex_;
+    /** Number of slots in each index table minus one. */
+    unsigned indexMask_;
+    /** Right shift that turns a 32-bit hash into an index slot. */
+    unsigned indexShift_;
+    /** Head of the unused entries list (linked by older). */
+    uint16_t freeList_;
+    /** Oldest untouched entry. */
+    uint16_t oldest_;
+    /** Newest, most recently touched entry. */
+    uint16_t newest_;
+    /** How many entries are in use. */
+    uint16_t used_;
+    /** Seed for the generation of the next alias */
+    NodeID seed_;
+    /** How many entries we have allocated. */
+    size_t entries_;
+    /** callback function to be used when we remove an entry from the cache */
+    void (*removeCallback_)(NodeID id, NodeAlias alias, void *);
+    /** context pointer to pass in with remove_callback */
+    void *context_;
+
+    DISALLOW_COPY_AND_ASSIGN(HashAliasCache);
+};
+
 } /* namepace NMRAnet */
 
 #endif /* _NMRAnetAliasCache_hxx */
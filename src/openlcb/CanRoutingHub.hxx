@@ -36,10 +36,15 @@
 #ifndef _OPENLCB_CANROUTNGHUB_HXX_
 #define _OPENLCB_CANROUTNGHUB_HXX_
 
+#include <deque>
+#include <vector>
+
+#include "nmranet_config.h"
 #include "openlcb/RoutingLogic.hxx"
 #include "openlcb/CanDefs.hxx"
 #include "openlcb/Defs.hxx"
 #include "openlcb/If.hxx"
+#include "openlcb/TractionDefs.hxx"
 #include "utils/Hub.hxx"
 #include "utils/GcStreamParser.hxx"
 #include "utils/gc_format.h"
@@ -52,7 +57,29 @@ namespace openlcb
    GridConnect protocol, performs routing decisions on the frames and sends out
    to the appropriate ports.
 
-   TODO: need to process consumer and producer identified messages.
+   Event reports are only forwarded to ports that have a consumer (or
+   producer) for the event. The hub learns this from the Identified messages
+   coming from the ports. A port is flooded with all event reports until
+   it has finished identifying its consumers: the filter is only used once
+   no Identified message or Initialization Complete has arrived from the
+   port for routing_hub_event_settle_msec.
+
+   Frames are delivered in priority order (see reprioritize_frame()). Each
+   port has its own priority queue, so a port that cannot keep up (for
+   example a slow link during a memory config download) only delays its own
+   traffic, and high priority frames overtake the queued bulk data. Stream
+   and datagram control messages share the band of their data, so they stay
+   in order with it.
+
+   When a port's queue holds routing_hub_port_queue_depth frames, new
+   messages of PRIO_NORMAL and lower are dropped for that port; control and
+   high priority frames are dropped at twice that depth. Messages are always
+   dropped whole (see frame_position()): the remaining frames of a message
+   whose first frame was queued are queued as well, and those of a message
+   whose first frame was dropped are dropped too. Stream data and stream
+   replies are never dropped; the stream's window bounds how many of them
+   can be queued.
+
    TODO: need to exclude CHECK ID frames from the source address learning.
  */
 class GcCanRoutingHub : public HubPortInterface
@@ -62,9 +89,196 @@ public:
     typedef Buffer<value_type> buffer_type;
     typedef FlowInterface<buffer_type> port_type;
 
+    /// Priority bands of the frames going through the hub. Lower value is
+    /// higher priority.
+    enum Priority
+    {
+        /// CAN control frames (alias allocation) and emergency stops.
+        PRIO_CONTROL = 0,
+        /// OpenLCB messages with MTI priority 0.
+        PRIO_HIGH,
+        /// Other OpenLCB messages and non-OpenLCB frames.
+        PRIO_NORMAL,
+        /// Datagrams and OpenLCB messages with MTI priority 3.
+        PRIO_DATAGRAM,
+        /// Stream data.
+        PRIO_STREAM,
+        /// Number of priority bands.
+        NUM_PRIO
+    };
+
+    /// Where a frame is within its OpenLCB message. Used to drop whole
+    /// messages when a port's queue is full.
+    enum FramePosition
+    {
+        /// The message consists of this frame only.
+        FRAME_ONLY,
+        /// First frame of a multi-frame message.
+        FRAME_FIRST,
+        /// Middle frame of a multi-frame message.
+        FRAME_MIDDLE,
+        /// Last frame of a multi-frame message.
+        FRAME_LAST,
+        /// Part of a stream that is already set up (stream data, stream
+        /// replies); never dropped.
+        FRAME_STREAM
+    };
+
     GcCanRoutingHub(Service *s)
         : deliveryFlow_(s, this)
+        , canEntry_(&deliveryFlow_)
+        , routingTable_(MSEC_TO_NSEC(config_routing_hub_event_settle_msec()))
+    {
+    }
+
+    ~GcCanRoutingHub()
+    {
+        for (auto &it : ports_)
+        {
+            it.second.egress_->shutdown();
+        }
+    }
+
+    /**
+       Computes the desired priority of a CAN frame from its header.
+
+       @param frame is the CAN frame (at the input side).
+       @return the desired priority of the frame, one of the Priority values.
+     */
+    static unsigned reprioritize_frame(const struct can_frame &frame)
+    {
+        if (!IS_CAN_FRAME_EFF(frame))
+        {
+            return PRIO_NORMAL;
+        }
+        uint32_t can_id = GET_CAN_FRAME_ID_EFF(frame);
+        if (CanDefs::get_frame_type(can_id) == CanDefs::CONTROL_MSG)
+        {
+            return PRIO_CONTROL;
+        }
+        switch (CanDefs::get_can_frame_type(can_id))
+        {
+            case CanDefs::GLOBAL_ADDRESSED:
+                break;
+            case CanDefs::STREAM_DATA:
+                return PRIO_STREAM;
+            case CanDefs::DATAGRAM_ONE_FRAME:
+            case CanDefs::DATAGRAM_FIRST_FRAME:
+            case CanDefs::DATAGRAM_MIDDLE_FRAME:
+            case CanDefs::DATAGRAM_FINAL_FRAME:
+                return PRIO_DATAGRAM;
+            default:
+                return PRIO_NORMAL;
+        }
+        Defs::MTI mti = static_cast<Defs::MTI>(CanDefs::get_mti(can_id));
+        if (mti == Defs::MTI_TRACTION_CONTROL_COMMAND && frame.can_dlc >= 3 &&
+            frame.data[2] == TractionDefs::REQ_EMERGENCY_STOP)
+        {
+            return PRIO_CONTROL;
+        }
+        if (mti == Defs::MTI_EVENT_REPORT && frame.can_dlc == 8)
+        {
+            EventId event = data_to_eventid(frame.data);
+            if (event == Defs::EMERGENCY_OFF_EVENT ||
+                event == Defs::EMERGENCY_STOP_EVENT)
+            {
+                return PRIO_CONTROL;
+            }
+        }
+        switch (mti)
+        {
+            case Defs::MTI_STREAM_INITIATE_REQUEST:
+            case Defs::MTI_STREAM_INITIATE_REPLY:
+            case Defs::MTI_STREAM_PROCEED:
+            case Defs::MTI_STREAM_COMPLETE:
+                return PRIO_STREAM;
+            case Defs::MTI_DATAGRAM_OK:
+            case Defs::MTI_DATAGRAM_REJECTED:
+                return PRIO_DATAGRAM;
+            default:
+                break;
+        }
+        switch (Defs::mti_priority(mti))
+        {
+            case 0:
+                return PRIO_HIGH;
+            case 3:
+                return PRIO_DATAGRAM;
+            default:
+                return PRIO_NORMAL;
+        }
+    }
+
+    /**
+       Finds where a CAN frame is within its OpenLCB message.
+
+       @param frame is the CAN frame.
+       @param key will be set to a value identifying the message among the
+       ones in progress (for FRAME_FIRST, FRAME_MIDDLE and FRAME_LAST).
+       @return a FramePosition value.
+     */
+    static unsigned frame_position(const struct can_frame &frame, uint64_t *key)
     {
+        *key = 0;
+        if (!IS_CAN_FRAME_EFF(frame))
+        {
+            return FRAME_ONLY;
+        }
+        uint32_t can_id = GET_CAN_FRAME_ID_EFF(frame);
+        if (CanDefs::get_frame_type(can_id) == CanDefs::CONTROL_MSG)
+        {
+            return FRAME_ONLY;
+        }
+        // Datagram frames only differ in the frame type.
+        uint32_t datagram_key = can_id & ~CanDefs::CAN_FRAME_TYPE_MASK;
+        switch (CanDefs::get_can_frame_type(can_id))
+        {
+            case CanDefs::GLOBAL_ADDRESSED:
+                break;
+            case CanDefs::STREAM_DATA:
+                return FRAME_STREAM;
+            case CanDefs::DATAGRAM_FIRST_FRAME:
+                *key = datagram_key;
+                return FRAME_FIRST;
+            case CanDefs::DATAGRAM_MIDDLE_FRAME:
+                *key = datagram_key;
+                return FRAME_MIDDLE;
+            case CanDefs::DATAGRAM_FINAL_FRAME:
+                *key = datagram_key;
+                return FRAME_LAST;
+            default:
+                return FRAME_ONLY;
+        }
+        Defs::MTI mti = static_cast<Defs::MTI>(CanDefs::get_mti(can_id));
+        switch (mti)
+        {
+            case Defs::MTI_STREAM_INITIATE_REPLY:
+            case Defs::MTI_STREAM_PROCEED:
+            case Defs::MTI_STREAM_COMPLETE:
+                return FRAME_STREAM;
+            default:
+                break;
+        }
+        if (!Defs::get_mti_address(mti) || frame.can_dlc < 2)
+        {
+            return FRAME_ONLY;
+        }
+        // The key of addressed messages is the MTI, source and destination.
+        *key = (uint64_t(frame.data[0] & 0xf) << 40) |
+            (uint64_t(frame.data[1]) << 32) | can_id;
+        switch (frame.data[0] &
+            (CanDefs::NOT_FIRST_FRAME | CanDefs::NOT_LAST_FRAME))
+        {
+            case CanDefs::NOT_LAST_FRAME:
+                return FRAME_FIRST;
+            case CanDefs::NOT_FIRST_FRAME | CanDefs::NOT_LAST_FRAME:
+                return FRAME_MIDDLE;
+            case CanDefs::NOT_FIRST_FRAME:
+                return FRAME_LAST;
+            default:
+                *key = 0;
+                return FRAME_ONLY;
+        }
     }
 
     void send(Buffer<HubData> *b, unsigned priority = UINT_MAX) override
@@ -96,24 +310,57 @@ public:
                     FlowInterface<Buffer<HubContainer<CanFrameContainer>>> *>(
                     b->data()->skipMember_);
                 deliveryFlow_.send(
-                    cb, reprioritize_frame(cb->data()->frame(), priority));
+                    cb, reprioritize_frame(cb->data()->frame()));
             }
         }
     }
 
+    /// @return an interface to send binary CAN frames into the hub. The
+    /// frames are queued with the same priority as those arriving from the
+    /// gridconnect ports.
     CanHubPortInterface *can_hub()
     {
-        /// @TODO: need a priority wrapper:
-        // deliveryFlow_.send(b, reprioritize_frame(b->data()->frame(),
-        // priority));
-        return &deliveryFlow_;
+        return &canEntry_;
     }
 
     void register_port(HubPortInterface *port)
     {
         OSMutexLock l(&lock_);
         HASSERT(port);
-        ports_[port].hubPort_ = port;
+        PortParser *pp = &ports_[port];
+        pp->hubPort_ = port;
+        if (!pp->egress_)
+        {
+            pp->egress_ = new PortEgress(deliveryFlow_.service(), port);
+        }
+    }
+
+    /// @return the number of event report frames that were not sent to a
+    /// port, because it has no consumer for the event. @param port is a
+    /// registered port.
+    unsigned suppressed_frames(HubPortInterface *port)
+    {
+        OSMutexLock l(&lock_);
+        auto it = ports_.find(port);
+        if (it == ports_.end())
+        {
+            return 0;
+        }
+        return it->second.suppressedFrames_;
+    }
+
+    /// @return the number of frames that were not sent to a port, because
+    /// its queue was full (counting all frames of the dropped messages).
+    /// @param port is a registered port.
+    unsigned dropped_frames(HubPortInterface *port)
+    {
+        OSMutexLock l(&lock_);
+        auto it = ports_.find(port);
+        if (it == ports_.end())
+        {
+            return 0;
+        }
+        return it->second.droppedFrames_;
     }
 
     void unregister_port(HubPortInterface *port)
@@ -132,20 +379,193 @@ public:
 private:
     class PortParser;
     typedef std::map<void *, PortParser> PortsMap;
-    /**
-       Computes the desired priority of a CAN frame.
 
-       @param frame is the CAN frame (at the input side).
-       @param old_priority is the incoming priority of the frame, as it arrived
-       from the previous flow.
-       @return the desired priority of the frame, in the range of 0..4.
-     */
-    unsigned reprioritize_frame(
-        const struct can_frame &frame, unsigned old_priority)
+    /// Priority queue of the outgoing gridconnect frames of one port. Sends
+    /// the frames to the port in priority order, several frames
+    /// concatenated into one buffer, and waits for the port to release each
+    /// buffer before sending the next. Runs on the hub's executor.
+    class PortEgress : public StateFlowBase
     {
-        // @TODO(balazs.racz): check actual priority.
-        return old_priority;
-    }
+    public:
+        /// Constructor. @param s the hub's service. @param port where to send
+        /// the frames.
+        PortEgress(Service *s, HubPortInterface *port)
+            : StateFlowBase(s)
+            , port_(port)
+        {
+        }
+
+        /// Queues a frame for sending.
+        ///
+        /// @param b the rendered frame. Takes ownership of one reference.
+        /// @param prio priority band of the frame.
+        /// @param position where the frame is in its message (FramePosition).
+        /// @param key identifies the message of the frame (see
+        /// frame_position()).
+        /// @return false if the frame was dropped because the queue is full.
+        bool add(
+            Buffer<HubData> *b, unsigned prio, unsigned position, uint64_t key)
+        {
+            if (prio >= NUM_PRIO)
+            {
+                prio = NUM_PRIO - 1;
+            }
+            bool drop = false;
+            switch (position)
+            {
+                case FRAME_MIDDLE:
+                case FRAME_LAST:
+                    drop = forget_dropped(key, position == FRAME_LAST);
+                    break;
+                case FRAME_STREAM:
+                    break;
+                default:
+                {
+                    if (position == FRAME_FIRST)
+                    {
+                        // In case the last frame of an earlier message got
+                        // lost.
+                        forget_dropped(key, true);
+                    }
+                    unsigned depth = config_routing_hub_port_queue_depth();
+                    if (prio < PRIO_NORMAL)
+                    {
+                        depth *= 2;
+                    }
+                    drop = size_ >= depth;
+                    if (drop && position == FRAME_FIRST)
+                    {
+                        droppedMessages_.push_back(key);
+                    }
+                    break;
+                }
+            }
+            if (drop)
+            {
+                b->unref();
+                return false;
+            }
+            queues_[prio].push_back(b);
+            ++size_;
+            if (!running_)
+            {
+                running_ = true;
+                start_flow(STATE(send_batch));
+            }
+            return true;
+        }
+
+        /// Drops all queued frames and deletes *this as soon as the port
+        /// released the buffer in flight.
+        void shutdown()
+        {
+            shutdown_ = true;
+            clear();
+            if (!running_)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        /// Largest number of bytes to send to the port in one buffer.
+        static constexpr unsigned MAX_BATCH_BYTES = 256;
+
+        /// Looks up a message whose first frame was dropped.
+        ///
+        /// @param key identifies the message.
+        /// @param erase if true, the message is removed from the list.
+        /// @return true if the message's first frame was dropped.
+        bool forget_dropped(uint64_t key, bool erase)
+        {
+            for (auto it = droppedMessages_.begin();
+                 it != droppedMessages_.end(); ++it)
+            {
+                if (*it == key)
+                {
+                    if (erase)
+                    {
+                        droppedMessages_.erase(it);
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Sends the next batch of frames to the port.
+        Action send_batch()
+        {
+            if (shutdown_)
+            {
+                return delete_this();
+            }
+            if (!size_)
+            {
+                running_ = false;
+                return exit();
+            }
+            Buffer<HubData> *out;
+            mainBufferPool->alloc(&out);
+            string *s = out->data();
+            unsigned prio = NUM_PRIO;
+            for (unsigned p = 0; p < NUM_PRIO; ++p)
+            {
+                std::deque<Buffer<HubData> *> &q = queues_[p];
+                while (!q.empty() &&
+                    (s->empty() ||
+                        s->size() + q.front()->data()->size() <=
+                            MAX_BATCH_BYTES))
+                {
+                    if (prio == NUM_PRIO)
+                    {
+                        prio = p;
+                    }
+                    s->append(*q.front()->data());
+                    q.front()->unref();
+                    q.pop_front();
+                    --size_;
+                }
+                if (!q.empty())
+                {
+                    break;
+                }
+            }
+            out->set_done(bn_.reset(this));
+            port_->send(out, prio);
+            return wait_and_call(STATE(send_batch));
+        }
+
+        /// Releases all queued frames.
+        void clear()
+        {
+            for (auto &q : queues_)
+            {
+                for (auto *b : q)
+                {
+                    b->unref();
+                }
+                q.clear();
+            }
+            size_ = 0;
+        }
+
+        /// Queued frames, one queue per priority band.
+        std::deque<Buffer<HubData> *> queues_[NUM_PRIO];
+        /// Total number of queued frames.
+        unsigned size_{0};
+        /// Keys of the multi-frame messages whose first frame was dropped;
+        /// their remaining frames are dropped too.
+        std::vector<uint64_t> droppedMessages_;
+        /// True while the flow is sending or waiting for the port.
+        bool running_{false};
+        /// True if the port has been removed.
+        bool shutdown_{false};
+        /// Where to send the frames.
+        HubPortInterface *port_;
+        /// Notified when the port released the buffer in flight.
+        BarrierNotifiable bn_;
+    };
 
     /// Flow responsible for queuing outgoing CAN frames as well as sending out
     /// the actual frames to the recipients.
@@ -161,15 +581,26 @@ private:
     private:
         Action entry() override
         {
-            OSMutexLock l(&parent_->lock_);
-            // First we apply any pending removes.
-            for (void *p : parent_->pendingRemove_)
             {
-                parent_->ports_.erase(p);
+                OSMutexLock l(&parent_->lock_);
+                // First we apply any pending removes.
+                for (void *p : parent_->pendingRemove_)
+                {
+                    auto it = parent_->ports_.find(p);
+                    if (it != parent_->ports_.end())
+                    {
+                        if (it->second.egress_)
+                        {
+                            it->second.egress_->shutdown();
+                        }
+                        parent_->ports_.erase(it);
+                    }
+                }
+                parent_->pendingRemove_.clear();
             }
-            parent_->pendingRemove_.clear();
 
-            // Classifies the packet.
+            // Classifies the packet. The routing table has its own locking,
+            // so this does not need the hub's lock.
             srcAddress_ = 0;
             dstAddress_ = 0;
             const struct can_frame &frame = message()->data()->frame();
@@ -178,6 +609,7 @@ private:
                 return release_and_exit();
             }
             classify_frame(frame);
+            framePosition_ = frame_position(frame, &messageKey_);
 
             if (srcAddress_ != 0)
             {
@@ -191,6 +623,7 @@ private:
             {
                 void *port =
                     parent_->routingTable_.lookup_port_for_address(dstAddress_);
+                OSMutexLock l(&parent_->lock_);
                 nextIt_ = parent_->ports_.find(port);
                 if (nextIt_ != parent_->ports_.end())
                 {
@@ -203,6 +636,7 @@ private:
                 }
             }
 
+            OSMutexLock l(&parent_->lock_);
             nextIt_ = parent_->ports_.begin();
 
             return call_immediately(STATE(try_next_entry));
@@ -256,6 +690,13 @@ private:
             }
             // At this point: global or addressed message
             Defs::MTI mti = static_cast<Defs::MTI>(CanDefs::get_mti(can_id));
+            if (mti == Defs::MTI_INITIALIZATION_COMPLETE)
+            {
+                // A new node has appeared on this port, and we do not know
+                // its consumers yet.
+                parent_->routingTable_.set_port_unknown(
+                    message()->data()->skipMember_);
+            }
             if (Defs::get_mti_address(mti) && frame.can_dlc >= 2)
             {
                 // address present (really).
@@ -328,6 +769,10 @@ private:
                 {
                     forward_to_port();
                 }
+                else if (nextIt_->first != message()->data()->skipMember_)
+                {
+                    ++nextIt_->second.suppressedFrames_;
+                }
             }
             else
             {
@@ -375,7 +820,11 @@ private:
                 if (hpi == message()->data()->skipMember_)
                     return;
                 ensure_gc_buf_available();
-                nextIt_->second.hubPort_->send(gcBuf_->ref());
+                if (!nextIt_->second.egress_->add(gcBuf_->ref(), priority(),
+                        framePosition_, messageKey_))
+                {
+                    ++nextIt_->second.droppedFrames_;
+                }
             }
         }
 
@@ -406,13 +855,38 @@ private:
         NodeAlias srcAddress_;      //< for all OpenLCB frames
         NodeAlias dstAddress_;      //< for addressed frames
         EventId event_;             //< for PCER messages
+        unsigned framePosition_;    //< where the frame is in its message
+        uint64_t messageKey_;       //< which message the frame belongs to
         PortsMap::iterator nextIt_; //< which port to consider next
         GcCanRoutingHub *parent_;
         /// Gridconnect-rendered frame.
         Buffer<HubData> *gcBuf_;
     };
 
+    /// Entry point for binary CAN frames. Assigns each frame its priority
+    /// band before handing it to the delivery flow.
+    class CanEntry : public CanHubPortInterface
+    {
+    public:
+        /// Constructor. @param delivery where to send the frames.
+        CanEntry(DeliveryFlow *delivery)
+            : delivery_(delivery)
+        {
+        }
+
+        void send(Buffer<CanHubData> *b, unsigned priority) override
+        {
+            delivery_->send(b, reprioritize_frame(b->data()->frame()));
+        }
+
+    private:
+        /// The hub's delivery flow.
+        DeliveryFlow *delivery_;
+    };
+
     DeliveryFlow deliveryFlow_;
+    /// Implementation of can_hub().
+    CanEntry canEntry_;
 
     friend class DeliveryFlow;
 
@@ -422,6 +896,12 @@ private:
         /// If true, we must not send any data to this target, because it has
         /// been unregistered.
         bool inactive_{false};
+        /// Number of event reports not sent to this port due to filtering.
+        unsigned suppressedFrames_{0};
+        /// Number of frames dropped because the egress queue was full.
+        unsigned droppedFrames_{0};
+        /// Outgoing queue of the port. Deletes itself upon shutdown.
+        PortEgress *egress_{nullptr};
         GcStreamParser segmenter_;
         CanHubPortInterface *canPort_{nullptr};
         HubPortInterface *hubPort_{nullptr};
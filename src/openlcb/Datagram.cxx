@@ -74,7 +74,6 @@ DatagramService::DatagramDispatcher::incoming_datagram_allocated()
     d->dst = nmsg()->dstNode;
 
     // Takes over ownership of payload.
-    /// @TODO(balazs.racz) Implement buffer refcounting.
     d->payload.swap(nmsg()->payload);
 
     release();
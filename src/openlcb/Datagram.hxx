@@ -48,7 +48,7 @@ struct IncomingDatagram;
 extern long long DATAGRAM_RESPONSE_TIMEOUT_NSEC;
 
 /// Contents of a Datagram message.
-typedef Payload DatagramPayload;
+typedef MessagePayload DatagramPayload;
 
 /// Message structure for incoming datagram handlers.
 struct IncomingDatagram
@@ -90,9 +90,6 @@ public:
      * Callers should set the done closure of the Buffer.  After that closure
      * is notified, the caller must ensure that the datagram client is released
      * back to the freelist.
-     *
-     * @TODO(balazs.racz): revisit the type of DatagramPayload and ensure that
-     * there will be no extra copy of the data happening.
      */
     virtual void write_datagram(Buffer<GenMessage> *b,
                                 unsigned priority = UINT_MAX) = 0;
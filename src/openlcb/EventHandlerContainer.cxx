@@ -158,4 +158,215 @@ TreeEventHandlers::TreeEventHandlers()
 {
 }
 
+RadixEventHandlers::RadixEventHandlers()
+    : indexEpoch_(get_epoch() - 1)
+{
+}
+
+void RadixEventHandlers::register_handler(const EventRegistryEntry &entry,
+                                          unsigned mask)
+{
+    AtomicHolder h(this);
+    LOG(VERBOSE, "%p: register %p", this, entry.handler);
+    set_dirty();
+    registrations_.emplace_back(entry, mask);
+}
+
+void RadixEventHandlers::unregister_handler(EventHandler *handler)
+{
+    AtomicHolder h(this);
+    set_dirty();
+    LOG(VERBOSE, "%p: unregister %p", this, handler);
+    auto erase_it = std::remove_if(registrations_.begin(),
+        registrations_.end(), [handler](const Registration &reg) {
+            return reg.entry.handler == handler;
+        });
+    if (erase_it != registrations_.end())
+    {
+        registrations_.erase(erase_it, registrations_.end());
+        return;
+    }
+    DIE("tried to unregister a handler that was not registered");
+}
+
+void RadixEventHandlers::update_index()
+{
+    if (indexEpoch_ == get_epoch())
+    {
+        return;
+    }
+    indexEpoch_ = get_epoch();
+    // Ranges that contain each other come outer first. The stable sort keeps
+    // the handlers of one range in registration order.
+    std::stable_sort(registrations_.begin(), registrations_.end(),
+        [](const Registration &a, const Registration &b) {
+            EventId ab = a.begin();
+            EventId bb = b.begin();
+            if (ab != bb)
+            {
+                return ab < bb;
+            }
+            return a.mask > b.mask;
+        });
+    nodes_.clear();
+    // Chain of nodes containing the current range, innermost last.
+    std::vector<unsigned> open;
+    for (unsigned i = 0; i < registrations_.size(); ++i)
+    {
+        EventId begin = registrations_[i].begin();
+        EventId last = registrations_[i].last();
+        if (!nodes_.empty() && nodes_.back().begin == begin &&
+            nodes_.back().last == last)
+        {
+            continue;
+        }
+        while (!open.empty() && nodes_[open.back()].last < begin)
+        {
+            open.pop_back();
+        }
+        Node n;
+        n.begin = begin;
+        n.last = last;
+        n.parent = open.empty() ? NO_NODE : open.back();
+        n.first = i;
+        open.push_back(nodes_.size());
+        nodes_.push_back(n);
+    }
+    if (nodes_.capacity() > nodes_.size() * 2)
+    {
+        nodes_.shrink_to_fit();
+    }
+}
+
+unsigned RadixEventHandlers::find_last_node(EventId event)
+{
+    auto it = std::upper_bound(nodes_.begin(), nodes_.end(), event,
+        [](EventId e, const Node &n) { return e < n.begin; });
+    if (it == nodes_.begin())
+    {
+        return NO_NODE;
+    }
+    return (it - nodes_.begin()) - 1;
+}
+
+/// Class representing the iteration state on the range-indexed event handler
+/// registry. First produces the handlers of every range that contains the
+/// beginning of the incoming event range, walking outwards from the
+/// innermost one, then the handlers of the ranges that begin inside the
+/// incoming range, which are consecutive in the index.
+class RadixEventHandlers::Iterator : public EventIterator
+{
+public:
+    Iterator(RadixEventHandlers *parent)
+        : parent_(parent)
+    {
+        clear_iteration();
+    }
+
+    EventRegistryEntry *next_entry() OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        if (epoch_ != parent_->get_epoch())
+        {
+            if (!currentReport_)
+            {
+                return nullptr;
+            }
+            // The registrations moved around. Starts over, same as the
+            // caller would do when it notices the epoch change.
+            setup_iteration();
+        }
+        while (true)
+        {
+            if (it_ < end_)
+            {
+                return &parent_->registrations_[it_++].entry;
+            }
+            if (node_ != NO_NODE)
+            {
+                it_ = parent_->first_registration(node_);
+                end_ = parent_->first_registration(node_ + 1);
+                node_ = parent_->nodes_[node_].parent;
+                continue;
+            }
+            if (rangeBegin_ < rangeEnd_)
+            {
+                it_ = rangeBegin_;
+                end_ = rangeEnd_;
+                rangeBegin_ = rangeEnd_;
+                continue;
+            }
+            currentReport_ = nullptr;
+            return nullptr;
+        }
+    }
+
+    void clear_iteration() OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        currentReport_ = nullptr;
+        epoch_ = parent_->get_epoch();
+        node_ = NO_NODE;
+        it_ = end_ = rangeBegin_ = rangeEnd_ = 0;
+    }
+
+    void init_iteration(EventReport *r) OVERRIDE
+    {
+        AtomicHolder h(parent_);
+        currentReport_ = r;
+        setup_iteration();
+    }
+
+private:
+    /// Computes the iteration bounds for currentReport_. Must be called with
+    /// the lock held.
+    void setup_iteration()
+    {
+        parent_->update_index();
+        epoch_ = parent_->get_epoch();
+        it_ = end_ = 0;
+        EventId event = currentReport_->event;
+        EventId range_last = event + currentReport_->mask;
+        if (range_last < event)
+        {
+            range_last = UINT64_MAX;
+        }
+        unsigned first = parent_->find_last_node(event);
+        // Nodes between the innermost node containing the event and first are
+        // all nested in that node, so it is found among the parents of first.
+        unsigned n = first;
+        while (n != NO_NODE && parent_->nodes_[n].last < event)
+        {
+            n = parent_->nodes_[n].parent;
+        }
+        node_ = n;
+        unsigned last = parent_->find_last_node(range_last);
+        rangeBegin_ =
+            parent_->first_registration(first == NO_NODE ? 0 : first + 1);
+        rangeEnd_ =
+            parent_->first_registration(last == NO_NODE ? 0 : last + 1);
+    }
+
+    RadixEventHandlers *parent_;
+    EventReport *currentReport_;
+    /// Registry epoch the iteration bounds were computed for.
+    unsigned epoch_;
+    /// Next node in the chain of ranges containing the event.
+    unsigned node_;
+    /// Next registration to return.
+    unsigned it_;
+    /// End of the registrations of the current node.
+    unsigned end_;
+    /// First registration of the ranges that begin inside the event range.
+    unsigned rangeBegin_;
+    /// End of the registrations of the ranges that begin inside the event
+    /// range.
+    unsigned rangeEnd_;
+};
+
+EventIterator *RadixEventHandlers::create_iterator()
+{
+    return new Iterator(this);
+}
+
 } // namespace openlcb
@@ -41,6 +41,7 @@
 #include <vector>
 #include <forward_list>
 #include <endian.h>
+#include <limits.h>
 
 #ifndef LOGLEVEL
 //#define LOGLEVEL VERBOSE
@@ -189,6 +190,98 @@ private:
     MaskLookupMap handlers_;
 };
 
+/// EventRegistry implementation that indexes the registrations by the event
+/// range they cover. Every registration (event, mask) covers an aligned block
+/// of 2^mask event IDs; any two such blocks are either disjoint or nested, so
+/// the distinct ranges form a tree (essentially a flattened binary radix
+/// tree). The index is rebuilt lazily on the first lookup after the set of
+/// handlers changed. A lookup costs a binary search plus a walk over the
+/// nesting chain, which is at most 65 deep, plus one step per match,
+/// independent of how many different masks are registered.
+class RadixEventHandlers : public EventRegistry, private Atomic
+{
+public:
+    RadixEventHandlers();
+
+    EventIterator *create_iterator() OVERRIDE;
+    void register_handler(const EventRegistryEntry &entry,
+                          unsigned mask) OVERRIDE;
+    void unregister_handler(EventHandler *handler) OVERRIDE;
+
+private:
+    class Iterator;
+    friend class Iterator;
+
+    /// One call to register_handler.
+    struct Registration
+    {
+        Registration(const EventRegistryEntry &e, unsigned m)
+            : entry(e)
+            , mask(m)
+        {
+        }
+
+        /// First event ID covered by this registration.
+        EventId begin() const
+        {
+            return mask >= 64 ? 0 : entry.event & ~((1ULL << mask) - 1);
+        }
+
+        /// Last event ID covered by this registration.
+        EventId last() const
+        {
+            return mask >= 64 ? UINT64_MAX
+                              : entry.event | ((1ULL << mask) - 1);
+        }
+
+        EventRegistryEntry entry;
+        /// log2 of the number of events covered.
+        uint8_t mask;
+    };
+
+    /// A distinct event range in the index.
+    struct Node
+    {
+        /// First event ID of the range.
+        EventId begin;
+        /// Last event ID of the range.
+        EventId last;
+        /// Index of the smallest node strictly containing this one, or
+        /// NO_NODE.
+        unsigned parent;
+        /// Index of the first registration with this range in
+        /// registrations_. The registrations of a node end where the next
+        /// node's begin.
+        unsigned first;
+    };
+
+    /// Parent value of the top level nodes.
+    static constexpr unsigned NO_NODE = UINT_MAX;
+
+    /// Recomputes the index if the set of registrations changed since the
+    /// last call. Must be called with the lock held.
+    void update_index();
+
+    /// @return the index of the last node with begin <= event, or NO_NODE if
+    /// there is no such node.
+    unsigned find_last_node(EventId event);
+
+    /// @return the index of the first registration of node n. n may be equal
+    /// to the number of nodes.
+    unsigned first_registration(unsigned n)
+    {
+        return n < nodes_.size() ? nodes_[n].first : registrations_.size();
+    }
+
+    /// All registrations. While the index is up to date, these are sorted by
+    /// range begin, and within that, larger ranges first.
+    std::vector<Registration> registrations_;
+    /// Distinct ranges, in the same order as registrations_.
+    std::vector<Node> nodes_;
+    /// Value of get_epoch() when the index was last built.
+    unsigned indexEpoch_;
+};
+
 }; /* namespace openlcb */
 
 #endif  // _OPENLCB_EVENTHANDLERCONTAINER_HXX_
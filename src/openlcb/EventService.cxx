@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <vector>
 #include <endian.h>
+#include <string.h>
 
 #include "openlcb/EventService.hxx"
 
@@ -59,7 +60,7 @@ EventService::Impl::Impl(EventService *service) : callerFlow_(service)
 #ifdef TARGET_LPC11Cxx
     registry.reset(new VectorEventHandlers());
 #else
-    registry.reset(new TreeEventHandlers());
+    registry.reset(new RadixEventHandlers());
 #endif
 }
 
@@ -90,10 +91,12 @@ EventIteratorFlow::EventIteratorFlow(If *async_if, EventService *event_service,
     : IncomingMessageStateFlow(async_if)
     , eventService_(event_service)
     , iterator_(event_service->impl()->registry->create_iterator())
+    , maxBatchSize_(config_event_service_batch_size())
 #ifdef DEBUG_EVENT_PERFORMANCE
     , mtiValue_(mti_value)
 #endif
 {
+    lookup_.reserve(MAX_CACHED_LOOKUP + 1);
     iface()->dispatcher()->register_handler(this, mti_value, mti_mask);
 }
 
@@ -103,6 +106,15 @@ EventIteratorFlow::~EventIteratorFlow()
     delete iterator_;
 }
 
+void EventService::get_batch_stats(BatchStats *stats, bool reset)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (auto &f : impl()->ownedFlows_)
+    {
+        f->add_batch_stats(stats, reset);
+    }
+}
+
 /// Returns true if there are outstanding events that are not yet handled.
 bool EventService::event_processing_pending()
 {
@@ -132,6 +144,10 @@ StateFlowBase::Action EventIteratorFlow::entry()
 {
     // at this point: we have the mutex.
     LOG(VERBOSE, "GlobalFlow::HandleEvent");
+    if (!batchSize_)
+    {
+        batchStart_ = os_get_time_monotonic();
+    }
 #ifdef DEBUG_EVENT_PERFORMANCE
     currentProcessStart_ = os_get_time_monotonic();
 #endif
@@ -144,7 +160,8 @@ StateFlowBase::Action EventIteratorFlow::entry()
         {
             LOG(INFO, "Invalid input event message, payload length %d",
                 (unsigned)nmsg()->payload.size());
-            return release_and_exit();
+            release();
+            return next_message();
         }
         rep->event = NetworkToEventID(nmsg()->payload.data());
         rep->mask = 0;
@@ -213,7 +230,8 @@ StateFlowBase::Action EventIteratorFlow::entry()
             {
                 LOG(INFO, "Invalid addressed identify all message, destination "
                           "node not found");
-                return release_and_exit();
+                release();
+                return next_message();
             }
         // fall through
         case Defs::MTI_EVENTS_IDENTIFY_GLOBAL:
@@ -231,10 +249,87 @@ StateFlowBase::Action EventIteratorFlow::entry()
     release();
 
     eventRegistryEpoch_ = eventService_->impl()->registry->get_epoch();
-    iterator_->init_iteration(rep);
+    useLookup_ = lookupValid_ && lookupEpoch_ == eventRegistryEpoch_ &&
+        lookupEvent_ == rep->event && lookupMask_ == rep->mask;
+    if (useLookup_)
+    {
+        // Same handlers as for the previous message.
+        lookupPos_ = 0;
+        ++stats_.numLookupsReused;
+    }
+    else
+    {
+        lookupValid_ = false;
+        lookup_.clear();
+        lookupEvent_ = rep->event;
+        lookupMask_ = rep->mask;
+        lookupEpoch_ = eventRegistryEpoch_;
+        iterator_->init_iteration(rep);
+    }
+    if (batchSize_)
+    {
+        // We are in the middle of a batch, the executor already gave us our
+        // turn.
+        return call_immediately(STATE(iterate_next));
+    }
     return yield_and_call(STATE(iterate_next));
 }
 
+EventRegistryEntry *EventIteratorFlow::next_lookup_entry()
+{
+    if (useLookup_)
+    {
+        if (lookupPos_ < lookup_.size())
+        {
+            return lookup_[lookupPos_++];
+        }
+        return nullptr;
+    }
+    EventRegistryEntry *entry = iterator_->next_entry();
+    if (!entry)
+    {
+        // One extra entry marks that the lookup did not fit.
+        lookupValid_ = lookup_.size() <= MAX_CACHED_LOOKUP;
+    }
+    else if (lookup_.size() <= MAX_CACHED_LOOKUP)
+    {
+        lookup_.push_back(entry);
+    }
+    return entry;
+}
+
+StateFlowBase::Action EventIteratorFlow::next_message()
+{
+    ++batchSize_;
+    if (batchSize_ < maxBatchSize_ && take_next_message())
+    {
+        return call_immediately(STATE(entry));
+    }
+    long long len = os_get_time_monotonic() - batchStart_;
+    ++stats_.numBatches;
+    stats_.numMessages += batchSize_;
+    stats_.maxBatchSize = std::max(stats_.maxBatchSize, batchSize_);
+    stats_.totalNsec += len;
+    stats_.maxNsec = std::max(stats_.maxNsec, len);
+    batchSize_ = 0;
+    return exit();
+}
+
+void EventIteratorFlow::add_batch_stats(
+    EventService::BatchStats *stats, bool reset)
+{
+    stats->numBatches += stats_.numBatches;
+    stats->numMessages += stats_.numMessages;
+    stats->maxBatchSize = std::max(stats->maxBatchSize, stats_.maxBatchSize);
+    stats->numLookupsReused += stats_.numLookupsReused;
+    stats->totalNsec += stats_.totalNsec;
+    stats->maxNsec = std::max(stats->maxNsec, stats_.maxNsec);
+    if (reset)
+    {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+}
+
 StateFlowBase::Action EventIteratorFlow::iterate_next()
 {
     if (eventRegistryEpoch_ != eventService_->impl()->registry->get_epoch())
@@ -244,9 +339,13 @@ StateFlowBase::Action EventIteratorFlow::iterate_next()
         iterator_->clear_iteration();
         eventRegistryEpoch_ = eventService_->impl()->registry->get_epoch();
         iterator_->init_iteration(&eventReport_);
+        useLookup_ = false;
+        lookupValid_ = false;
+        lookup_.clear();
+        lookupEpoch_ = eventRegistryEpoch_;
     }
 
-    EventRegistryEntry *entry = iterator_->next_entry();
+    EventRegistryEntry *entry = next_lookup_entry();
     if (!entry)
     {
         if (incomingDone_)
@@ -270,7 +369,7 @@ StateFlowBase::Action EventIteratorFlow::iterate_next()
 
 #endif
 
-        return exit();
+        return next_message();
     }
     return dispatch_event(entry);
 }
@@ -88,6 +88,33 @@ public:
      * handled. */
     bool event_processing_pending();
 
+    /// Counters about processing incoming event messages in batches. A batch
+    /// is the set of messages processed back-to-back without yielding to the
+    /// executor.
+    struct BatchStats
+    {
+        /// Number of batches processed.
+        unsigned numBatches;
+        /// Number of messages processed in these batches.
+        unsigned numMessages;
+        /// Number of messages in the largest batch.
+        unsigned maxBatchSize;
+        /// Number of messages that reused the handler lookup of the previous
+        /// message in the batch, because it was for the same event.
+        unsigned numLookupsReused;
+        /// Time spent processing the batches, in nsec.
+        long long totalNsec;
+        /// Processing time of the longest batch, in nsec.
+        long long maxNsec;
+    };
+
+    /** Fills in the batch processing counters, summed over all registered
+     * interfaces. Should be called on the executor of the interfaces for
+     * consistent values.
+     * @param stats will be filled in.
+     * @param reset if true, the counters are cleared. */
+    void get_batch_stats(BatchStats *stats, bool reset = false);
+
     static EventService *instance;
 
 private:
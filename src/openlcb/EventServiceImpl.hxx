@@ -40,6 +40,7 @@
 #include <memory>
 #include <vector>
 
+#include "nmranet_config.h"
 #include "openlcb/EventService.hxx"
 #include "openlcb/EventHandler.hxx"
 
@@ -101,7 +102,7 @@ public:
 
     /// Flows that we own. There will be a few entries for each interface
     /// registered.
-    std::vector<std::unique_ptr<StateFlowWithQueue>> ownedFlows_;
+    std::vector<std::unique_ptr<EventIteratorFlow>> ownedFlows_;
 
     /// This flow will serialize calls to NMRAnetEventHandler objects. All such
     /// calls need to be sent to this flow.
@@ -131,6 +132,10 @@ public:
                       unsigned mti_value, unsigned mti_mask);
     ~EventIteratorFlow();
 
+    /// Adds this flow's batch counters to @param stats. @param reset if true,
+    /// clears the counters of this flow.
+    void add_batch_stats(EventService::BatchStats *stats, bool reset);
+
 protected:
     Action entry() OVERRIDE;
     Action iterate_next();
@@ -138,6 +143,19 @@ protected:
 private:
     virtual Action dispatch_event(const EventRegistryEntry *entry);
 
+    /// Called when the current message is done and released. Continues with
+    /// the next queued message if the batch is not full yet, otherwise
+    /// exits.
+    Action next_message();
+
+    /// @return the next registry entry to call for the current message, or
+    /// nullptr when there are no more. Reuses the lookup of the previous
+    /// message if it was for the same event.
+    EventRegistryEntry *next_lookup_entry();
+
+    /// Maximum number of handlers to remember from a lookup for reusing it.
+    static constexpr unsigned MAX_CACHED_LOOKUP = 16;
+
 protected:
     EventService *eventService_;
 
@@ -158,6 +176,31 @@ protected:
     BarrierNotifiable n_;
     EventHandlerFunction fn_;
 
+    /// Matching entries of the most recent completed lookup.
+    std::vector<EventRegistryEntry *> lookup_;
+    /// Event ID of the lookup_ entries.
+    EventId lookupEvent_;
+    /// Event mask of the lookup_ entries.
+    EventId lookupMask_;
+    /// Registry epoch of the lookup_ entries.
+    unsigned lookupEpoch_;
+    /// True if lookup_ is complete and can be reused.
+    bool lookupValid_{false};
+    /// True if the current message is iterating lookup_ instead of the
+    /// registry.
+    bool useLookup_{false};
+    /// Index of the next entry in lookup_ when useLookup_ is set.
+    unsigned lookupPos_;
+
+    /// How many queued messages may be processed without yielding.
+    unsigned maxBatchSize_;
+    /// Number of messages processed in the current batch.
+    unsigned batchSize_{0};
+    /// When the current batch started.
+    long long batchStart_;
+    /// Counters of this flow.
+    EventService::BatchStats stats_{0, 0, 0, 0, 0, 0};
+
 #ifdef DEBUG_EVENT_PERFORMANCE
     static const int REPORT_COUNT = 100;
     /// How many events' cost are accumulated so far.
@@ -34,9 +34,21 @@
 
 #include "openlcb/If.hxx"
 
+#include "openmrn_features.h"
+
+#if OPENMRN_FEATURE_POOLED_PAYLOAD
+/// Ensures that the largest bucket in the main buffer pool fits a GenMessage
+/// and the buffer of a (datagram-sized) message payload.
+const unsigned LARGEST_BUFFERPOOL_BUCKET =
+    sizeof(Buffer<openlcb::GenMessage>) >
+        sizeof(RawBuffer) + openlcb::MessagePayload::SLAB_SIZE
+    ? sizeof(Buffer<openlcb::GenMessage>)
+    : sizeof(RawBuffer) + openlcb::MessagePayload::SLAB_SIZE;
+#else
 /// Ensures that the largest bucket in the main buffer pool is exactly the size
 /// of a GenMessage.
 const unsigned LARGEST_BUFFERPOOL_BUCKET = sizeof(Buffer<openlcb::GenMessage>);
+#endif
 
 namespace openlcb
 {
@@ -108,7 +120,7 @@ void append_error_to_buffer(uint16_t error_code, Payload* p) {
 }
 
 
-void buffer_to_error(const Payload &payload, uint16_t *error_code,
+void buffer_to_error(const MessagePayload &payload, uint16_t *error_code,
     uint16_t *mti, string *error_message)
 {
     if (mti)
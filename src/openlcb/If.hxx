@@ -40,6 +40,7 @@
 
 #include "openlcb/Node.hxx"
 #include "openlcb/Defs.hxx"
+#include "openlcb/Payload.hxx"
 #include "executor/Dispatcher.hxx"
 #include "executor/Service.hxx"
 #include "executor/Executor.hxx"
@@ -52,9 +53,6 @@ namespace openlcb
 
 class Node;
 
-/// Container that carries the data bytes in an NMRAnet message.
-typedef string Payload;
-
 /** Convenience function to render a 48-bit NMRAnet node ID into a new buffer.
  *
  * @param id is the 48-bit ID to render.
@@ -122,7 +120,7 @@ extern void append_error_to_buffer(uint16_t error_code, Payload* p);
  * @param error_message will hold all remaining bytes that came with the error
  * message.
  */
-extern void buffer_to_error(const Payload& payload, uint16_t* error_code, uint16_t* mti, string* error_message);
+extern void buffer_to_error(const MessagePayload& payload, uint16_t* error_code, uint16_t* mti, string* error_message);
 
 /** A global class / variable for empty or not-yet-initialized payloads. */
 extern string EMPTY_PAYLOAD;
@@ -160,7 +158,8 @@ struct GenMessage
         reset((Defs::MTI)0, 0, EMPTY_PAYLOAD);
     }
 
-    void reset(Defs::MTI mti, NodeID src, NodeHandle dst, string payload)
+    void reset(
+        Defs::MTI mti, NodeID src, NodeHandle dst, MessagePayload payload)
     {
         this->mti = mti;
         this->src = {src, 0};
@@ -171,7 +170,7 @@ struct GenMessage
         this->flagsDst = 0;
     }
 
-    void reset(Defs::MTI mti, NodeID src, string payload)
+    void reset(Defs::MTI mti, NodeID src, MessagePayload payload)
     {
         this->mti = mti;
         this->src = {src, 0};
@@ -190,9 +189,9 @@ struct GenMessage
     Defs::MTI mti;
     /// If the destination node is local, this value is non-NULL.
     Node *dstNode;
-    /// Data content in the message body. Owned by the dispatcher.
-    /// @todo(balazs.racz) figure out a better container.
-    string payload;
+    /// Data content in the message body. Copying the message shares the
+    /// bytes instead of duplicating them.
+    MessagePayload payload;
 
     unsigned flagsSrc : 4;
     unsigned flagsDst : 4;
@@ -487,7 +487,7 @@ public:
         GenMessage *m = b->data();
         m->mti = static_cast<Defs::MTI>(
             (id_ & CanDefs::MTI_MASK) >> CanDefs::MTI_SHIFT);
-        m->payload = buf_;
+        m->payload.swap(buf_);
         m->dst = {0, 0};
         m->dstNode = nullptr;
         m->src.alias = id_ & CanDefs::SRC_MASK;
@@ -506,7 +506,7 @@ private:
     /// CAN frame ID, saved from the incoming frame.
     uint32_t id_;
     /// Payload for the MTI message.
-    string buf_;
+    MessagePayload buf_;
 };
 
 /** This class listens for incoming CAN frames of regular addressed OpenLCB
@@ -577,7 +577,7 @@ public:
             buffer_key |= CanDefs::get_mti(id_);
             /** @todo (balazs.racz): handle the error cases here, like when we
              * get a middle frame out of the blue etc. */
-            Payload *mapped_buffer = &pendingBuffers_[buffer_key];
+            MessagePayload *mapped_buffer = &pendingBuffers_[buffer_key];
             if ((f->data[0] & CanDefs::NOT_FIRST_FRAME) == 0)
             {
                 // First frame. Make sure the pending buffer is empty.
@@ -649,10 +649,85 @@ public:
 
 private:
     uint32_t id_;
-    string buf_;
+    MessagePayload buf_;
     NodeHandle dstHandle_;
     /// Reassembly buffers for multi-frame messages.
-    StlMap<uint32_t, Payload> pendingBuffers_;
+    StlMap<uint32_t, MessagePayload> pendingBuffers_;
+};
+
+/** This class listens for incoming stream data CAN frames destined for local
+ * nodes, and turns each of them into a stream data message (MTI_STREAM_DATA)
+ * whose payload is the destination stream ID followed by the data bytes. No
+ * reassembly is done; the stream receivers are fine with getting the data in
+ * small pieces. */
+class FrameToStreamDataParser : public CanFrameStateFlow
+{
+public:
+    enum
+    {
+        CAN_FILTER = CanMessageData::CAN_EXT_FRAME_FILTER |
+            (CanDefs::STREAM_DATA << CanDefs::CAN_FRAME_TYPE_SHIFT) |
+            (CanDefs::NMRANET_MSG << CanDefs::FRAME_TYPE_SHIFT),
+        CAN_MASK = CanMessageData::CAN_EXT_FRAME_MASK |
+            CanDefs::CAN_FRAME_TYPE_MASK | CanDefs::FRAME_TYPE_MASK
+    };
+
+    FrameToStreamDataParser(IfCan *service)
+        : CanFrameStateFlow(service)
+    {
+        if_can()->frame_dispatcher()->register_handler(
+            this, CAN_FILTER, CAN_MASK);
+    }
+
+    ~FrameToStreamDataParser()
+    {
+        if_can()->frame_dispatcher()->unregister_handler(
+            this, CAN_FILTER, CAN_MASK);
+    }
+
+    /// Handler entry for incoming messages.
+    Action entry() override
+    {
+        struct can_frame *f = message()->data();
+        id_ = GET_CAN_FRAME_ID_EFF(*f);
+        if (f->can_dlc < 1)
+        {
+            // No destination stream ID.
+            return release_and_exit();
+        }
+        dstHandle_.alias = CanDefs::get_dst(id_);
+        dstHandle_.id = if_can()->local_aliases()->lookup(dstHandle_.alias);
+        if (!dstHandle_.id) // Not destined for us.
+        {
+            return release_and_exit();
+        }
+        buf_.assign((const char *)(f->data), f->can_dlc);
+        release();
+        return allocate_and_call(if_can()->dispatcher(), STATE(send_to_if));
+    }
+
+    Action send_to_if()
+    {
+        auto *b = get_allocation_result(if_can()->dispatcher());
+        GenMessage *m = b->data();
+        m->mti = Defs::MTI_STREAM_DATA;
+        m->payload.swap(buf_);
+        m->dst = dstHandle_;
+        m->dstNode = if_can()->lookup_local_node(dstHandle_.id);
+        m->src.alias = CanDefs::get_src(id_);
+        m->src.id = if_can()->remote_aliases()->lookup(m->src.alias);
+        if (!m->src.id)
+        {
+            m->src.id = if_can()->local_aliases()->lookup(m->src.alias);
+        }
+        if_can()->dispatcher()->send(b, b->data()->priority());
+        return exit();
+    }
+
+private:
+    uint32_t id_;
+    MessagePayload buf_;
+    NodeHandle dstHandle_;
 };
 
 IfCan::IfCan(ExecutorBase *executor, CanHubFlow *device,
@@ -707,6 +782,7 @@ void IfCan::add_addressed_message_support()
     if (addressedWriteFlow_)
         return;
     add_owned_flow(new FrameToAddressedMessageParser(this));
+    add_owned_flow(new FrameToStreamDataParser(this));
     auto *f = new AddressedCanMessageWriteFlow(this);
     addressedWriteFlow_ = f;
     add_owned_flow(f);
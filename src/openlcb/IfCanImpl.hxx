@@ -64,6 +64,8 @@ protected:
     unsigned dstAlias_ : 12;  ///< Destination node alias.
     unsigned dataOffset_ : 8; /**< for continuation frames: which offset in
                                 * the Buffer should we start the payload at. */
+    /// When we started waiting for a reserved alias.
+    long long aliasWaitStart_;
 
     Action send_to_hardware() override
     {
@@ -88,6 +90,7 @@ protected:
         srcAlias_ = if_can()->local_aliases()->lookup(nmsg()->src.id);
         if (!srcAlias_)
         {
+            aliasWaitStart_ = os_get_time_monotonic();
             return call_immediately(STATE(allocate_new_alias));
         }
         return src_alias_lookup_done();
@@ -146,6 +149,8 @@ private:
         }
 
         srcAlias_ = alias;
+        if_can()->alias_allocator()->record_alias_wait(
+            os_get_time_monotonic() - aliasWaitStart_);
         /** @TODO(balazs.racz): We leak aliases here in case of eviction by the
          * AliasCache object. */
         if_can()->local_aliases()->add(nmsg()->src.id, alias);
@@ -185,6 +190,10 @@ private:
         auto *b = get_allocation_result(if_can()->frame_write_flow());
         b->set_done(message()->new_child());
         struct can_frame *f = b->data()->mutable_frame();
+        if (nmsg()->mti == Defs::MTI_STREAM_DATA)
+        {
+            return fill_stream_data_frame(b);
+        }
         if (nmsg()->mti & (Defs::MTI_DATAGRAM_MASK | Defs::MTI_SPECIAL_MASK |
                            Defs::MTI_RESERVED_MASK))
         {
@@ -202,7 +211,7 @@ private:
                           CanDefs::NORMAL_PRIORITY);
         SET_CAN_FRAME_ID_EFF(*f, can_id);
 
-        const string &data = nmsg()->payload;
+        const MessagePayload &data = nmsg()->payload;
         bool need_more_frames = false;
         // Sets the destination bytes if needed. Adds the payload.
         if (Defs::get_mti_address(nmsg()->mti))
@@ -253,6 +262,49 @@ private:
             return call_immediately(STATE(send_finished));
         }
     }
+
+    /** Renders one CAN frame of a stream data message. The first payload byte
+     * is the destination stream ID, which gets repeated in every frame,
+     * followed by up to 7 bytes of stream data. The destination alias goes
+     * into the CAN header like for datagrams. The payload must be at most
+     * 255 bytes, as dataOffset_ only has 8 bits. */
+    Action fill_stream_data_frame(Buffer<CanHubData> *b)
+    {
+        const MessagePayload &data = nmsg()->payload;
+        HASSERT(data.size() <= 255);
+        if (data.empty() || !dstAlias_)
+        {
+            b->unref();
+            return call_immediately(STATE(send_finished));
+        }
+        struct can_frame *f = b->data()->mutable_frame();
+        uint32_t can_id;
+        CanDefs::set_datagram_fields(
+            &can_id, srcAlias_, dstAlias_, CanDefs::STREAM_DATA);
+        SET_CAN_FRAME_ID_EFF(*f, can_id);
+        if (!dataOffset_)
+        {
+            dataOffset_ = 1;
+        }
+        unsigned len = data.size() - dataOffset_;
+        if (len > 7)
+        {
+            len = 7;
+        }
+        f->data[0] = data[0];
+        memcpy(f->data + 1, data.data() + dataOffset_, len);
+        dataOffset_ += len;
+        f->can_dlc = 1 + len;
+        if_can()->frame_write_flow()->send(b);
+        if (dataOffset_ < data.size())
+        {
+            return call_immediately(STATE(get_can_frame_buffer));
+        }
+        else
+        {
+            return call_immediately(STATE(send_finished));
+        }
+    }
 };
 
 /** The addressed write flow is responsible for sending addressed messages to
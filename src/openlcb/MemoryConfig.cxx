@@ -33,6 +33,7 @@
  */
 
 #include "openlcb/MemoryConfig.hxx"
+#include "openlcb/MemoryConfigStream.hxx"
 
 #include <fcntl.h>
 #include <sys/types.h>
@@ -190,4 +191,107 @@ size_t FileMemorySpace::read(address_t destination, uint8_t *dst, size_t len,
     }
 }
 
+MemoryConfigHandler::~MemoryConfigHandler()
+{
+    /// @TODO(balazs.racz): unregister *this!
+    delete streamFlow_;
+}
+
+StateFlowBase::Action MemoryConfigHandler::handle_read_stream()
+{
+    size_t len = message()->data()->payload.size();
+    // The address and space is followed by the source and destination stream
+    // IDs; the read count is optional.
+    unsigned ofs = has_custom_space() ? 7 : 6;
+    if (len < ofs + 2)
+    {
+        return respond_reject(Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+    }
+    MemorySpace *space = get_space();
+    if (!space)
+    {
+        return respond_reject(MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN);
+    }
+    if (!streamFlow_)
+    {
+        streamFlow_ = new MemoryConfigStreamFlow(dg_service()->iface());
+    }
+    if (streamFlow_->is_busy())
+    {
+        return respond_reject(DatagramClient::RESEND_OK);
+    }
+    const uint8_t *bytes = in_bytes();
+    uint8_t dst_stream_id = bytes[ofs + 1];
+    uint32_t count = 0xffffffffu;
+    if (len >= ofs + 6)
+    {
+        count = (bytes[ofs + 2] << 24) | (bytes[ofs + 3] << 16) |
+            (bytes[ofs + 4] << 8) | bytes[ofs + 5];
+        if (!count)
+        {
+            count = 0xffffffffu;
+        }
+    }
+    streamFlow_->prepare_read(message()->data()->dst, message()->data()->src,
+        space, get_address(), count, dst_stream_id);
+    response_.assign(ofs + 2, 0);
+    out_bytes()[0] = DATAGRAM_ID;
+    out_bytes()[1] = MemoryConfigDefs::COMMAND_READ_STREAM_REPLY;
+    set_address_and_space();
+    out_bytes()[ofs] = MemoryConfigStreamFlow::READ_SRC_STREAM_ID;
+    out_bytes()[ofs + 1] = dst_stream_id;
+    return respond_ok(DatagramClient::REPLY_PENDING);
+}
+
+StateFlowBase::Action MemoryConfigHandler::handle_write_stream()
+{
+    size_t len = message()->data()->payload.size();
+    unsigned ofs = has_custom_space() ? 7 : 6;
+    if (len < ofs + 1)
+    {
+        return respond_reject(Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+    }
+    MemorySpace *space = get_space();
+    if (!space)
+    {
+        return respond_reject(MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN);
+    }
+    if (space->read_only())
+    {
+        return respond_reject(MemoryConfigDefs::ERROR_WRITE_TO_RO);
+    }
+    if (!streamFlow_)
+    {
+        streamFlow_ = new MemoryConfigStreamFlow(dg_service()->iface());
+    }
+    if (streamFlow_->is_busy())
+    {
+        return respond_reject(DatagramClient::RESEND_OK);
+    }
+    uint8_t src_stream_id = in_bytes()[ofs];
+    // We start listening before the reply goes out, because the writer may
+    // open the stream as soon as it sees the reply.
+    uint8_t dst_stream_id = streamFlow_->start_write(message()->data()->dst,
+        message()->data()->src, space, get_address());
+    response_.assign(ofs + 2, 0);
+    out_bytes()[0] = DATAGRAM_ID;
+    out_bytes()[1] = MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY;
+    set_address_and_space();
+    out_bytes()[ofs] = src_stream_id;
+    out_bytes()[ofs + 1] = dst_stream_id;
+    return respond_ok(DatagramClient::REPLY_PENDING);
+}
+
+void MemoryConfigHandler::stream_response_sent(bool success)
+{
+    if (success)
+    {
+        streamFlow_->start_prepared();
+    }
+    else
+    {
+        streamFlow_->cancel_prepared();
+    }
+}
+
 } // namespace openlcb
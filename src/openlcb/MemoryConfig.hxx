@@ -35,6 +35,8 @@
 #ifndef _OPENLCB_MEMORYCONFIG_HXX_
 #define _OPENLCB_MEMORYCONFIG_HXX_
 
+#include <vector>
+
 #include "openlcb/DatagramDefs.hxx"
 #include "openlcb/DatagramHandlerDefault.hxx"
 #include "openlcb/MemoryConfig.hxx"
@@ -54,6 +56,8 @@ extern void reboot();
 namespace openlcb
 {
 
+class MemoryConfigStreamFlow;
+
 /// Static constants and helper functions related to the Memory Configuration
 /// Protocol.
 struct MemoryConfigDefs {
@@ -77,11 +81,14 @@ struct MemoryConfigDefs {
         COMMAND_READ_REPLY        = 0x50, /**< reply to read data from address space */
         COMMAND_READ_FAILED       = 0x58, /**< failed to read data from address space */
         COMMAND_READ_STREAM       = 0x60, /**< command to read data using a stream */
+        COMMAND_READ_STREAM_REPLY = 0x70, /**< reply to read data using a stream */
+        COMMAND_READ_STREAM_FAILED= 0x78, /**< failed to read data using a stream */
         COMMAND_MAX_FOR_RW        = 0x80, /**< command <= this value have fixed bit arrangement. */
         COMMAND_OPTIONS           = 0x80,
         COMMAND_OPTIONS_REPLY     = 0x82,
         COMMAND_INFORMATION       = 0x84,
-        COMMAND_INFORMATION_REPLY = 0x86,
+        COMMAND_INFORMATION_REPLY = 0x86, /**< space info reply; space not present */
+        COMMAND_INFORMATION_PRESENT_REPLY = 0x87, /**< space info reply; space present */
         COMMAND_LOCK              = 0x88, /**< lock the configuration space */
         COMMAND_LOCK_REPLY        = 0x8A, /**< unlock the configuration space */
         COMMAND_UNIQUE_ID         = 0x8C, /**< ask for a node unique id */
@@ -173,7 +180,7 @@ struct MemoryConfigDefs {
         p.push_back(0xff & (offset >> 8));
         p.push_back(0xff & (offset));
         if (is_special_space(space)) {
-            p[1] |= space & ~SPACE_SPECIAL;
+            p.mutable_data()[1] |= space & ~SPACE_SPECIAL;
         } else {
             p.push_back(space);
         }
@@ -193,7 +200,7 @@ struct MemoryConfigDefs {
         p.push_back(0xff & (offset >> 8));
         p.push_back(0xff & (offset));
         if (is_special_space(space)) {
-            p[1] |= space & ~SPACE_SPECIAL;
+            p.mutable_data()[1] |= space & ~SPACE_SPECIAL;
         } else {
             p.push_back(space);
         }
@@ -201,6 +208,43 @@ struct MemoryConfigDefs {
         return p;
     }
 
+    /// Creates a Read Stream command datagram.
+    /// @param space memory space to read from.
+    /// @param offset address of the first byte to read.
+    /// @param dst_stream_id stream ID at the reader where the data should
+    /// arrive.
+    /// @param length number of bytes to read; 0xffffffff reads until the end
+    /// of the space.
+    static DatagramPayload read_stream_datagram(uint8_t space, uint32_t offset,
+        uint8_t dst_stream_id, uint32_t length = 0xffffffffu)
+    {
+        DatagramPayload p = read_datagram(space, offset, 0);
+        char *d = p.mutable_data();
+        d[1] = (d[1] & ~COMMAND_MASK) | COMMAND_READ_STREAM;
+        // source stream ID is assigned by the server
+        d[p.size() - 1] = 0xff;
+        p.push_back(dst_stream_id);
+        p.push_back(0xff & (length >> 24));
+        p.push_back(0xff & (length >> 16));
+        p.push_back(0xff & (length >> 8));
+        p.push_back(0xff & (length));
+        return p;
+    }
+
+    /// Creates a Write Stream command datagram.
+    /// @param space memory space to write to.
+    /// @param offset address of the first byte to write.
+    /// @param src_stream_id stream ID at the writer that will send the data.
+    static DatagramPayload write_stream_datagram(
+        uint8_t space, uint32_t offset, uint8_t src_stream_id)
+    {
+        DatagramPayload p = write_datagram(space, offset);
+        char *d = p.mutable_data();
+        d[1] = (d[1] & ~COMMAND_MASK) | COMMAND_WRITE_STREAM;
+        p.push_back(src_stream_id);
+        return p;
+    }
+
     /// @return true if the payload has minimum number of bytes you need in a
     /// read or write datagram message to cover for the necessary fields
     /// (command, offset, space).
@@ -570,10 +614,7 @@ public:
         dg_service()->registry()->insert(node, DATAGRAM_ID, this);
     }
 
-    ~MemoryConfigHandler()
-    {
-        /// @TODO(balazs.racz): unregister *this!
-    }
+    ~MemoryConfigHandler();
 
     typedef TypedNodeHandlerMap<Node, MemorySpace> Registry;
 
@@ -588,7 +629,7 @@ public:
     {
         size_t len = message->data()->payload.size();
         const uint8_t *bytes = (const uint8_t *)message->data()->payload.data();
-        uint8_t cmd = ((len >= 2) && (client_ != nullptr)) ? bytes[1] : 0;
+        uint8_t cmd = ((len >= 2) && !clients_.empty()) ? bytes[1] : 0;
         bool is_client_command = false;
         // To recognize replies for read & write commands, we need to look at a
         // bit.
@@ -602,6 +643,7 @@ public:
         {
             case MemoryConfigDefs::COMMAND_OPTIONS_REPLY:
             case MemoryConfigDefs::COMMAND_INFORMATION_REPLY:
+            case MemoryConfigDefs::COMMAND_INFORMATION_PRESENT_REPLY:
             case MemoryConfigDefs::COMMAND_LOCK_REPLY:
             case MemoryConfigDefs::COMMAND_UNIQUE_ID_REPLY:
             {
@@ -614,23 +656,44 @@ public:
             is_client_command);
         if (is_client_command)
         {
-            client_->send(message, priority);
+            find_client(message->data()->src)->send(message, priority);
             return;
         }
         DatagramHandlerFlow::send(message, priority);
     }
 
     /// Registers a second handler to forward all the client interactions,
-    /// i.e. everythingthat comes back with the RESPONSE bit set.
-    void set_client(DatagramHandlerFlow* client) {
-        HASSERT(client_ == nullptr || client_ == client);
-        client_ = client;
+    /// i.e. everythingthat comes back with the RESPONSE bit set. Several
+    /// clients may be registered at the same time if they talk to different
+    /// remote nodes; the replies are routed by their source node.
+    /// @param client the handler to receive the replies.
+    /// @param remote the node the client is talking to. An empty handle
+    /// receives the replies that no other client claims.
+    void set_client(
+        DatagramHandlerFlow *client, NodeHandle remote = NodeHandle())
+    {
+        for (auto &c : clients_)
+        {
+            if (c.flow == client)
+            {
+                c.remote = remote;
+                return;
+            }
+        }
+        clients_.push_back({client, remote});
     }
 
     /// Unregisters the previously registered second handler.
     void clear_client(DatagramHandlerFlow* client) {
-        HASSERT(client_ == client);
-        client_ = nullptr;
+        for (auto it = clients_.begin(); it != clients_.end(); ++it)
+        {
+            if (it->flow == client)
+            {
+                clients_.erase(it);
+                return;
+            }
+        }
+        DIE("Clearing a memory config client that was not registered.");
     }
     
 private:
@@ -661,6 +724,16 @@ private:
         {
             return call_immediately(STATE(handle_write));
         }
+        else if ((cmd & MemoryConfigDefs::COMMAND_MASK) ==
+            MemoryConfigDefs::COMMAND_READ_STREAM)
+        {
+            return call_immediately(STATE(handle_read_stream));
+        }
+        else if ((cmd & MemoryConfigDefs::COMMAND_MASK) ==
+            MemoryConfigDefs::COMMAND_WRITE_STREAM)
+        {
+            return call_immediately(STATE(handle_write_stream));
+        }
         switch (cmd)
         {
             case MemoryConfigDefs::COMMAND_LOCK:
@@ -717,14 +790,18 @@ private:
             case MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED:
             case MemoryConfigDefs::COMMAND_READ_REPLY:
             case MemoryConfigDefs::COMMAND_READ_FAILED:
+            case MemoryConfigDefs::COMMAND_READ_STREAM_REPLY:
+            case MemoryConfigDefs::COMMAND_READ_STREAM_FAILED:
             case MemoryConfigDefs::COMMAND_OPTIONS_REPLY:
             case MemoryConfigDefs::COMMAND_INFORMATION_REPLY:
+            case MemoryConfigDefs::COMMAND_INFORMATION_PRESENT_REPLY:
             case MemoryConfigDefs::COMMAND_LOCK_REPLY:
             case MemoryConfigDefs::COMMAND_UNIQUE_ID_REPLY:
             {
-                if (client_)
+                if (!clients_.empty())
                 {
-                    client_->send(transfer_message());
+                    find_client(message()->data()->src)
+                        ->send(transfer_message());
                     return exit();
                 }
             } // fall through to unsupported.
@@ -736,10 +813,14 @@ private:
 
     Action ok_response_sent() OVERRIDE
     {
+        if (isReadPending_)
+        {
+            isReadPending_ = false;
+            return call_immediately(STATE(try_read));
+        }
         if (!response_.empty())
         {
-            return allocate_and_call(STATE(client_allocated),
-                                     dg_service()->client_allocator());
+            return call_immediately(STATE(wait_for_previous_response));
         }
         else
         {
@@ -748,6 +829,22 @@ private:
         }
     }
 
+    /// Only one response datagram may be in flight at a time, because the
+    /// datagram client matches the acknowledgement by source and
+    /// destination only. The memory space access of this request was still
+    /// overlapped with waiting for the acknowledgement of the previous
+    /// response.
+    Action wait_for_previous_response()
+    {
+        if (pendingResponse_.client_)
+        {
+            isWaitingForResponse_ = true;
+            return wait();
+        }
+        return allocate_and_call(
+            STATE(client_allocated), dg_service()->client_allocator());
+    }
+
     Action cleanup()
     {
         HASSERT(!message());
@@ -766,25 +863,47 @@ private:
     {
         auto *b =
             get_allocation_result(dg_service()->iface()->dispatcher());
-        b->set_done(b_.reset(this));
+        PendingResponse *r = &pendingResponse_;
+        r->client_ = responseFlow_;
+        responseFlow_ = nullptr;
+        b->set_done(r->bn_.reset(r));
         b->data()->reset(Defs::MTI_DATAGRAM, message()->data()->dst->node_id(),
                          message()->data()->src, EMPTY_PAYLOAD);
         b->data()->payload.swap(response_);
         release(); /// @TODO(balazs.racz) Should this be here or elsewhere?
-        responseFlow_->write_datagram(b);
-        return wait_and_call(STATE(response_flow_complete));
+        r->client_->write_datagram(b);
+        // We do not wait for the response datagram to be acknowledged. This
+        // way the next request (e.g. from a pipelining client) is processed
+        // while the response is in flight. Sending the next response waits
+        // in wait_for_previous_response().
+        return call_immediately(STATE(cleanup));
     }
 
-    Action response_flow_complete()
+    class PendingResponse;
+
+    /// Called when a response datagram was acknowledged or failed.
+    /// @param r is the object tracking the response.
+    void response_datagram_done(PendingResponse *r)
     {
-        if (!(responseFlow_->result() & DatagramClient::OPERATION_SUCCESS))
+        bool success =
+            r->client_->result() & DatagramClient::OPERATION_SUCCESS;
+        if (!success)
         {
             LOG(WARNING,
                 "MemoryConfig: Failed to send response datagram. error code %x",
-                (unsigned)responseFlow_->result());
+                (unsigned)r->client_->result());
+        }
+        if (streamFlow_)
+        {
+            stream_response_sent(success);
+        }
+        dg_service()->client_allocator()->typed_insert(r->client_);
+        r->client_ = nullptr;
+        if (isWaitingForResponse_)
+        {
+            isWaitingForResponse_ = false;
+            notify();
         }
-        dg_service()->client_allocator()->typed_insert(responseFlow_);
-        return call_immediately(STATE(cleanup));
     }
 
     Action handle_options()
@@ -811,7 +930,8 @@ private:
         // Write lengths
         response_.push_back(static_cast<char> (
             MemoryConfigDefs::LENGTH_1 | MemoryConfigDefs::LENGTH_2 |
-            MemoryConfigDefs::LENGTH_4 | MemoryConfigDefs::LENGTH_ARBITRARY));
+            MemoryConfigDefs::LENGTH_4 | MemoryConfigDefs::LENGTH_ARBITRARY |
+            MemoryConfigDefs::LENGTH_STREAM));
 
         uint8_t min_space = 0xFF;
         uint8_t max_space = 0;
@@ -852,7 +972,7 @@ private:
         if (!space) {
             return respond_ok(DatagramDefs::REPLY_PENDING);
         } else {
-            response_[1]++;
+            response_.mutable_data()[1]++;
         }
         MemorySpace::address_t address = space->max_address();
         response_.push_back((address >> 24) & 0xff);
@@ -903,7 +1023,10 @@ private:
         currentOffset_ = 0;
         char c = 0;
         response_.assign(response_len, c);
-        return call_immediately(STATE(try_read));
+        // We acknowledge the request before reading. This way the requester
+        // can send its next request while we wait for the memory space.
+        isReadPending_ = true;
+        return respond_ok(DatagramClient::REPLY_PENDING);
     }
 
     Action try_read() {
@@ -959,7 +1082,7 @@ private:
         {
             response_.resize(response_data_offset + currentOffset_);
         }
-        return respond_ok(DatagramClient::REPLY_PENDING);
+        return ok_response_sent();
     }
 
     Action handle_write()
@@ -1041,6 +1164,19 @@ private:
         return respond_ok(DatagramClient::REPLY_PENDING);
     }
 
+    /// Handles the Read Stream command. The reply datagram is sent first;
+    /// the stream is opened once the reply is acknowledged.
+    Action handle_read_stream();
+
+    /// Handles the Write Stream command. Starts listening for the incoming
+    /// stream and replies with the stream IDs.
+    Action handle_write_stream();
+
+    /// Called when the response datagram was sent, to start or cancel a
+    /// pending stream transfer. @param success is true if the response
+    /// datagram was accepted.
+    void stream_response_sent(bool success);
+
     /// @return true iff we have a custom space
     bool has_custom_space()
     {
@@ -1184,7 +1320,7 @@ private:
     /// @returns the response datagram payload buffer.
     uint8_t *out_bytes()
     {
-        return reinterpret_cast<uint8_t *>(&response_[0]);
+        return reinterpret_cast<uint8_t *>(response_.mutable_data());
     }
 
     /// @returns the request datagram payload buffer.
@@ -1194,21 +1330,81 @@ private:
             message()->data()->payload.data());
     }
 
+    /// A response datagram that was handed to a datagram client and waits
+    /// for the acknowledgement.
+    class PendingResponse : public Notifiable
+    {
+    public:
+        PendingResponse(MemoryConfigHandler *parent)
+            : parent_(parent)
+        {
+        }
+
+        void notify() override
+        {
+            parent_->response_datagram_done(this);
+        }
+
+        MemoryConfigHandler *parent_;
+        /// Datagram client sending the response.
+        DatagramClient *client_{nullptr};
+        /// Notified by the datagram client when the response is done.
+        BarrierNotifiable bn_;
+    };
+
     DatagramPayload response_; //< reply payload to send back.
     DatagramClient *responseFlow_;
-    BarrierNotifiable b_;
+    /// Tracks the response datagram that is in flight.
+    PendingResponse pendingResponse_{this};
 
     ///@todo (balazs.racz) implement lock/unlock.
     //NodeID lockNode_; //< Holds the node ID that locked us.
 
     Registry registry_;         //< holds the known memory spaces
-    /// If there is a memory config client, we will forward response traffic to
-    /// it.
-    DatagramHandlerFlow* client_{nullptr};
+    /// A registered memory config client.
+    struct ClientEntry
+    {
+        /// Handler for the reply datagrams.
+        DatagramHandlerFlow *flow;
+        /// Remote node the client is talking to, or empty.
+        NodeHandle remote;
+    };
+
+    /// @return the registered client that should get a reply coming from
+    /// src. Must have at least one client registered.
+    DatagramHandlerFlow *find_client(NodeHandle src)
+    {
+        DatagramHandlerFlow *fallback = clients_[0].flow;
+        for (auto &c : clients_)
+        {
+            if (!c.remote.id && !c.remote.alias)
+            {
+                fallback = c.flow;
+            }
+            else if (dg_service()->iface()->matching_node(c.remote, src))
+            {
+                return c.flow;
+            }
+        }
+        return fallback;
+    }
+
+    /// If there are memory config clients, we will forward response traffic
+    /// to them.
+    std::vector<ClientEntry> clients_;
+    /// Performs the data transfer of stream reads and writes. Allocated upon
+    /// the first stream command.
+    MemoryConfigStreamFlow *streamFlow_{nullptr};
 
     /** Offset withing the current write/read datagram. This does not include
      * the offset from the incoming datagram. */
     uint8_t currentOffset_;
+    /// True if the read request was acknowledged, but the data is not read
+    /// yet.
+    bool isReadPending_{false};
+    /// True if the flow is waiting for the previous response datagram to be
+    /// acknowledged.
+    bool isWaitingForResponse_{false};
 };
 
 } // namespace openlcb
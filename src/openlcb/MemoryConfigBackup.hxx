@@ -0,0 +1,567 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MemoryConfigBackup.hxx
+ *
+ * Backs up and restores the memory spaces of many nodes in parallel, using
+ * one MemoryConfigClient per concurrent transfer.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _OPENLCB_MEMORYCONFIGBACKUP_HXX_
+#define _OPENLCB_MEMORYCONFIGBACKUP_HXX_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "openlcb/MemoryConfigClient.hxx"
+#include "os/os.h"
+#include "utils/Crc.hxx"
+
+namespace openlcb
+{
+
+/// Binary file format for storing memory space contents of many nodes. All
+/// numbers are big-endian.
+///
+/// The archive starts with an 8-byte header: "OLCBMB", then a zero byte and
+/// the format version. This is followed by one record per memory space:
+///  - 6 bytes node ID,
+///  - 1 byte memory space number,
+///  - 4 bytes address of the first byte,
+///  - 4 bytes data length,
+///  - 2 bytes CRC-16-IBM of the data,
+///  - the data.
+class MemoryConfigArchive
+{
+public:
+    /// Contents of one memory space of one node.
+    struct Record
+    {
+        /// Node the data belongs to.
+        NodeID node;
+        /// Memory space number.
+        uint8_t space;
+        /// Address of the first byte of data.
+        uint32_t address;
+        /// Memory space contents.
+        string data;
+    };
+
+    /// Length of the archive header.
+    static constexpr unsigned HEADER_SIZE = 8;
+    /// Length of the fixed part of each record.
+    static constexpr unsigned RECORD_HEADER_SIZE = 17;
+
+    /// @return the header to start an archive with.
+    static string header()
+    {
+        return string("OLCBMB\0\1", HEADER_SIZE);
+    }
+
+    /// Appends a record to an archive.
+    /// @param archive the archive being built; must already have the header.
+    /// @param r record to add.
+    static void append(string *archive, const Record &r)
+    {
+        uint8_t h[RECORD_HEADER_SIZE];
+        put_be(h, r.node, 6);
+        h[6] = r.space;
+        put_be(h + 7, r.address, 4);
+        put_be(h + 11, r.data.size(), 4);
+        put_be(h + 15, crc_16_ibm(r.data.data(), r.data.size()), 2);
+        archive->append((const char *)h, RECORD_HEADER_SIZE);
+        archive->append(r.data);
+    }
+
+    /// Decodes an archive.
+    /// @param archive the archive contents.
+    /// @param records the decoded records will be appended here.
+    /// @return false if the archive is malformed or a checksum does not
+    /// match. Records before the error are still appended.
+    static bool parse(const string &archive, std::vector<Record> *records)
+    {
+        if (archive.compare(0, HEADER_SIZE, header()) != 0)
+        {
+            return false;
+        }
+        const uint8_t *p = (const uint8_t *)archive.data();
+        size_t ofs = HEADER_SIZE;
+        while (ofs < archive.size())
+        {
+            if (archive.size() - ofs < RECORD_HEADER_SIZE)
+            {
+                return false;
+            }
+            const uint8_t *h = p + ofs;
+            uint32_t len = get_be(h + 11, 4);
+            ofs += RECORD_HEADER_SIZE;
+            if (archive.size() - ofs < len)
+            {
+                return false;
+            }
+            if (crc_16_ibm(p + ofs, len) != get_be(h + 15, 2))
+            {
+                return false;
+            }
+            records->push_back(
+                {get_be(h, 6), h[6], (uint32_t)get_be(h + 7, 4), string()});
+            records->back().data.assign(archive, ofs, len);
+            ofs += len;
+        }
+        return true;
+    }
+
+private:
+    /// Writes a big-endian number. @param dst where to write; @param value
+    /// what to write; @param len number of bytes.
+    static void put_be(uint8_t *dst, uint64_t value, unsigned len)
+    {
+        while (len--)
+        {
+            dst[len] = value & 0xff;
+            value >>= 8;
+        }
+    }
+
+    /// @return a big-endian number. @param src where to read from; @param len
+    /// number of bytes.
+    static uint64_t get_be(const uint8_t *src, unsigned len)
+    {
+        uint64_t value = 0;
+        for (unsigned i = 0; i < len; ++i)
+        {
+            value <<= 8;
+            value |= src[i];
+        }
+        return value;
+    }
+};
+
+/// Reads or writes memory spaces of a list of nodes, with a bounded number of
+/// nodes being worked on at the same time. Each concurrent transfer has its
+/// own MemoryConfigClient. Transfers to the same node are sequential.
+///
+/// For backups the size of each memory space is queried from the node first,
+/// then the space is read in one request. Spaces that the node does not have
+/// are silently skipped. For restores the records of each node are written
+/// in order, followed by an Update Complete command.
+///
+/// All functions must be called on the executor of the interface (for
+/// example from a NodeBrowser callback).
+class MemoryConfigBackup
+{
+public:
+    typedef MemoryConfigArchive::Record Record;
+
+    /// A memory space that could not be transferred.
+    struct Failure
+    {
+        /// Remote node.
+        NodeID node;
+        /// Memory space number.
+        uint8_t space;
+        /// Error code returned by the MemoryConfigClient.
+        int error;
+    };
+
+    /// Constructor.
+    /// @param node local node to send the requests from.
+    /// @param memcfg memory config handler of the local node. The datagram
+    /// service needs at least parallelism + 1 datagram clients.
+    /// @param parallelism how many nodes to talk to at the same time.
+    MemoryConfigBackup(
+        Node *node, MemoryConfigHandler *memcfg, unsigned parallelism)
+        : node_(node)
+    {
+        HASSERT(parallelism > 0);
+        for (unsigned i = 0; i < parallelism; ++i)
+        {
+            workers_.emplace_back(new Worker(this, node, memcfg));
+        }
+    }
+
+    /// Sets how many request datagrams each transfer may keep outstanding.
+    /// @param count see MemoryConfigClient::set_max_pending().
+    void set_max_pending(unsigned count)
+    {
+        for (auto &w : workers_)
+        {
+            w->client_.set_max_pending(count);
+        }
+    }
+
+    /// @param use_streams if true, backups read the data using stream reads
+    /// (with datagram fallback for nodes that do not support them). Restores
+    /// always use datagram writes: a stream write completes when the stream
+    /// is closed, which may be before the node has written the last window,
+    /// so the update complete command could overtake the data. Datagram
+    /// writes are acknowledged after the data is written.
+    void set_use_streams(bool use_streams)
+    {
+        useStreams_ = use_streams;
+    }
+
+    /// Adds a node to the list of nodes to back up. Duplicates and local
+    /// nodes are ignored. @param id remote node ID.
+    void add_node(NodeID id)
+    {
+        if (node_->iface()->lookup_local_node(id) ||
+            std::find(nodes_.begin(), nodes_.end(), id) != nodes_.end())
+        {
+            return;
+        }
+        nodes_.push_back(id);
+    }
+
+    /// @return the nodes added so far.
+    const std::vector<NodeID> &nodes()
+    {
+        return nodes_;
+    }
+
+    /// Reads the given memory spaces from all nodes added with add_node().
+    /// @param spaces memory space numbers to read from each node.
+    /// @param done will be notified when all nodes are done. The data is then
+    /// in records(), sorted by node and space.
+    void start_backup(std::vector<uint8_t> spaces, Notifiable *done)
+    {
+        spaces_ = std::move(spaces);
+        records_.clear();
+        jobs_.clear();
+        std::sort(nodes_.begin(), nodes_.end());
+        for (NodeID n : nodes_)
+        {
+            jobs_.push_back({n, 0, 0});
+        }
+        isRestore_ = false;
+        start(done);
+    }
+
+    /// Writes records back to their nodes.
+    /// @param records data to write. Records of the same node are written in
+    /// the given order.
+    /// @param done will be notified when all nodes are done.
+    void start_restore(std::vector<Record> records, Notifiable *done)
+    {
+        records_ = std::move(records);
+        std::stable_sort(records_.begin(), records_.end(),
+            [](const Record &a, const Record &b) { return a.node < b.node; });
+        jobs_.clear();
+        for (size_t i = 0; i < records_.size(); ++i)
+        {
+            if (jobs_.empty() || jobs_.back().node != records_[i].node)
+            {
+                jobs_.push_back({records_[i].node, i, 0});
+            }
+            ++jobs_.back().count;
+        }
+        isRestore_ = true;
+        start(done);
+    }
+
+    /// @return the data read by the last backup, or the data given to the
+    /// last restore.
+    std::vector<Record> &records()
+    {
+        return records_;
+    }
+
+    /// @return the memory spaces that failed in the last operation.
+    const std::vector<Failure> &failures()
+    {
+        return failures_;
+    }
+
+    /// @return the number of data bytes transferred by the last operation.
+    uint64_t total_bytes()
+    {
+        return totalBytes_;
+    }
+
+    /// @return how long the last operation took.
+    long long elapsed_nsec()
+    {
+        return endTime_ - startTime_;
+    }
+
+private:
+    /// Work item: one remote node.
+    struct Job
+    {
+        /// Remote node.
+        NodeID node;
+        /// Index of the first record of this node (restore only).
+        size_t first;
+        /// Number of records of this node (restore only).
+        size_t count;
+    };
+
+    /// Transfers the data of one node at a time, taking the next node from
+    /// the parent's job list when done.
+    class Worker : public StateFlowBase
+    {
+    public:
+        /// Constructor. @param parent owner; @param node local node; @param
+        /// memcfg local memory config handler.
+        Worker(MemoryConfigBackup *parent, Node *node,
+            MemoryConfigHandler *memcfg)
+            : StateFlowBase(memcfg->dg_service())
+            , parent_(parent)
+            , client_(node, memcfg)
+        {
+        }
+
+        /// Starts processing jobs.
+        void start()
+        {
+            start_flow(STATE(next_job));
+        }
+
+    private:
+        friend class MemoryConfigBackup;
+
+        Action next_job()
+        {
+            if (parent_->nextJob_ >= parent_->jobs_.size())
+            {
+                parent_->done_.notify();
+                return exit();
+            }
+            job_ = parent_->jobs_[parent_->nextJob_++];
+            idx_ = 0;
+            if (parent_->isRestore_)
+            {
+                return call_immediately(STATE(next_write));
+            }
+            return call_immediately(STATE(next_space));
+        }
+
+        Action next_space()
+        {
+            if (idx_ >= parent_->spaces_.size())
+            {
+                return call_immediately(STATE(next_job));
+            }
+            space_ = parent_->spaces_[idx_];
+            return invoke_subflow_and_wait(&client_, STATE(space_info_done),
+                MemoryConfigClientRequest::SPACE_INFO, NodeHandle(job_.node),
+                space_);
+        }
+
+        Action space_info_done()
+        {
+            auto b = get_buffer_deleter(full_allocation_result(&client_));
+            int error = b->data()->resultCode;
+            ++idx_;
+            if (error == MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN)
+            {
+                return call_immediately(STATE(next_space));
+            }
+            if (error)
+            {
+                // The node is probably gone; we do not try the other spaces.
+                parent_->failures_.push_back({job_.node, space_, error});
+                return call_immediately(STATE(next_job));
+            }
+            address_ = b->data()->address;
+            if (parent_->useStreams_)
+            {
+                return invoke_subflow_and_wait(&client_, STATE(read_done),
+                    MemoryConfigClientRequest::READ_STREAM,
+                    NodeHandle(job_.node), space_, address_, b->data()->size);
+            }
+            return invoke_subflow_and_wait(&client_, STATE(read_done),
+                MemoryConfigClientRequest::READ_PART, NodeHandle(job_.node),
+                space_, address_, b->data()->size);
+        }
+
+        Action read_done()
+        {
+            auto b = get_buffer_deleter(full_allocation_result(&client_));
+            if (b->data()->resultCode)
+            {
+                parent_->failures_.push_back(
+                    {job_.node, space_, b->data()->resultCode});
+            }
+            else
+            {
+                parent_->totalBytes_ += b->data()->payload.size();
+                parent_->records_.push_back({job_.node, space_, address_,
+                    std::move(b->data()->payload)});
+            }
+            return call_immediately(STATE(next_space));
+        }
+
+        Action next_write()
+        {
+            if (idx_ >= job_.count)
+            {
+                return invoke_subflow_and_wait(&client_,
+                    STATE(update_complete_done),
+                    MemoryConfigClientRequest::UPDATE_COMPLETE,
+                    NodeHandle(job_.node));
+            }
+            const Record &r = parent_->records_[job_.first + idx_];
+            space_ = r.space;
+            // Not WRITE_STREAM, see set_use_streams().
+            return invoke_subflow_and_wait(&client_, STATE(write_done),
+                MemoryConfigClientRequest::WRITE, NodeHandle(job_.node),
+                r.space, r.address, r.data);
+        }
+
+        Action write_done()
+        {
+            auto b = get_buffer_deleter(full_allocation_result(&client_));
+            if (b->data()->resultCode)
+            {
+                // We do not send update complete after a partial restore.
+                parent_->failures_.push_back(
+                    {job_.node, space_, b->data()->resultCode});
+                return call_immediately(STATE(next_job));
+            }
+            parent_->totalBytes_ +=
+                parent_->records_[job_.first + idx_].data.size();
+            ++idx_;
+            return call_immediately(STATE(next_write));
+        }
+
+        Action update_complete_done()
+        {
+            auto b = get_buffer_deleter(full_allocation_result(&client_));
+            return call_immediately(STATE(next_job));
+        }
+
+        /// Owner.
+        MemoryConfigBackup *parent_;
+        /// Performs the memory config requests.
+        MemoryConfigClient client_;
+        /// Node being worked on.
+        Job job_;
+        /// Index of the next space (backup) or record (restore) of the node.
+        size_t idx_;
+        /// Address of the memory space being read.
+        uint32_t address_;
+        /// Memory space being transferred.
+        uint8_t space_;
+    };
+
+    /// Called when all workers are done.
+    class Finish : public Notifiable
+    {
+    public:
+        /// Constructor. @param parent owner.
+        Finish(MemoryConfigBackup *parent)
+            : parent_(parent)
+        {
+        }
+
+        void notify() override
+        {
+            parent_->finish();
+        }
+
+    private:
+        /// Owner.
+        MemoryConfigBackup *parent_;
+    };
+
+    /// Resets the statistics and starts the workers. @param done notified
+    /// when all jobs are done.
+    void start(Notifiable *done)
+    {
+        HASSERT(!userDone_);
+        userDone_ = done;
+        nextJob_ = 0;
+        failures_.clear();
+        totalBytes_ = 0;
+        startTime_ = os_get_time_monotonic();
+        done_.reset(&finish_);
+        for (auto &w : workers_)
+        {
+            done_.new_child();
+            w->start();
+        }
+        done_.notify();
+    }
+
+    /// Completes the current operation.
+    void finish()
+    {
+        endTime_ = os_get_time_monotonic();
+        if (!isRestore_)
+        {
+            std::sort(records_.begin(), records_.end(),
+                [](const Record &a, const Record &b) {
+                    return a.node < b.node ||
+                        (a.node == b.node && a.space < b.space);
+                });
+        }
+        Notifiable *d = userDone_;
+        userDone_ = nullptr;
+        d->notify();
+    }
+
+    /// Local node.
+    Node *node_;
+    /// Parallel transfers.
+    std::vector<std::unique_ptr<Worker>> workers_;
+    /// Nodes to back up.
+    std::vector<NodeID> nodes_;
+    /// Memory spaces to back up.
+    std::vector<uint8_t> spaces_;
+    /// Work items of the current operation.
+    std::vector<Job> jobs_;
+    /// Index of the next job in jobs_ to hand out.
+    size_t nextJob_{0};
+    /// Data read or to be written.
+    std::vector<Record> records_;
+    /// Spaces that failed.
+    std::vector<Failure> failures_;
+    /// Counts the running workers.
+    BarrierNotifiable done_;
+    /// Notified by done_.
+    Finish finish_{this};
+    /// Caller's notifiable for the current operation.
+    Notifiable *userDone_{nullptr};
+    /// Number of data bytes transferred.
+    uint64_t totalBytes_{0};
+    /// When the current operation was started.
+    long long startTime_{0};
+    /// When the last operation finished.
+    long long endTime_{0};
+    /// True if the current operation is a restore.
+    bool isRestore_{false};
+    /// True if backups should read the data with streams.
+    bool useStreams_{false};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_MEMORYCONFIGBACKUP_HXX_
@@ -35,9 +35,15 @@
 #ifndef _OPENLCB_MEMORYCONFIGCLIENT_HXX_
 #define _OPENLCB_MEMORYCONFIGCLIENT_HXX_
 
+#include <algorithm>
+#include <deque>
+
 #include "executor/CallableFlow.hxx"
 #include "openlcb/MemoryConfig.hxx"
+#include "openlcb/MemoryConfigStream.hxx"
 #include "openlcb/DatagramHandlerDefault.hxx"
+#include "openlcb/StreamReceiver.hxx"
+#include "openlcb/StreamSender.hxx"
 
 namespace openlcb
 {
@@ -59,6 +65,21 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         WRITE
     };
 
+    enum ReadStreamCmd
+    {
+        READ_STREAM
+    };
+
+    enum WriteStreamCmd
+    {
+        WRITE_STREAM
+    };
+
+    enum SpaceInfoCmd
+    {
+        SPACE_INFO
+    };
+
     enum UpdateCompleteCmd
     {
         UPDATE_COMPLETE
@@ -130,6 +151,70 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         payload = std::move(data);
     }
 
+    /// Sets up a command to read a part of a memory space using the stream
+    /// protocol. Falls back to datagrams if the remote node does not support
+    /// stream reads.
+    /// @param ReadStreamCmd polymorphic matching arg; always set to
+    /// READ_STREAM.
+    /// @param d is the destination node to query
+    /// @param space is the memory space to read out
+    /// @param offset if the address of the first byte to read
+    /// @param size is the number of bytes to read; by default reads until the
+    /// end of the memory space.
+    void reset(ReadStreamCmd, NodeHandle d, uint8_t space, unsigned offset = 0,
+        unsigned size = 0xffffffffu)
+    {
+        reset_base();
+        cmd = CMD_READ_STREAM;
+        memory_space = space;
+        dst = d;
+        this->address = offset;
+        this->size = size;
+        payload.clear();
+    }
+
+    /// Sets up a command to write a memory space using the stream
+    /// protocol. Falls back to datagrams if the remote node does not support
+    /// stream writes.
+    /// @param WriteStreamCmd polymorphic matching arg; always set to
+    /// WRITE_STREAM.
+    /// @param d is the destination node to query
+    /// @param space is the memory space to write to
+    /// @param offset if the address of the first byte to write
+    /// @param data is the data to write
+    void reset(WriteStreamCmd, NodeHandle d, uint8_t space, unsigned offset,
+        string data)
+    {
+        reset_base();
+        cmd = CMD_WRITE_STREAM;
+        memory_space = space;
+        dst = d;
+        this->address = offset;
+        this->size = data.size();
+        payload = std::move(data);
+    }
+
+    /// Sets up a command to query the size and flags of a memory space. Upon
+    /// success address is the lowest valid address, size is the number of
+    /// bytes in the space, and payload holds a single byte with the space
+    /// flags (MemoryConfigDefs::FLAG_RO etc). If the remote node does not have
+    /// the space, the request fails with
+    /// MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN.
+    /// @param SpaceInfoCmd polymorphic matching arg; always set to
+    /// SPACE_INFO.
+    /// @param d is the destination node to query
+    /// @param space is the memory space to query
+    void reset(SpaceInfoCmd, NodeHandle d, uint8_t space)
+    {
+        reset_base();
+        cmd = CMD_SPACE_INFO;
+        memory_space = space;
+        dst = d;
+        address = 0;
+        size = 0;
+        payload.clear();
+    }
+
     /// Sets up a command to send an Update Complete request to a remote node.
     /// @param UpdateCompleteCmd polymorphic matching arg; always set to
     /// UPDATE_COMPLETE.
@@ -199,7 +284,10 @@ struct MemoryConfigClientRequest : public CallableFlowRequestBase
         CMD_READ,
         CMD_READ_PART,
         CMD_WRITE,
-        CMD_META_REQUEST
+        CMD_META_REQUEST,
+        CMD_READ_STREAM,
+        CMD_WRITE_STREAM,
+        CMD_SPACE_INFO
     };
     Command cmd;
     uint8_t memory_space;
@@ -217,6 +305,14 @@ public:
         : CallableFlow<MemoryConfigClientRequest>(memcfg->dg_service())
         , node_(node)
         , memoryConfigHandler_(memcfg)
+        , streamSender_(memcfg->dg_service()->iface())
+        , streamReceiver_(memcfg->dg_service()->iface())
+        , localStreamId_(allocate_stream_id())
+        , isWaitingForTimer_(0)
+        , isPipelined_(0)
+        , isDatagramBusy_(0)
+        , isEndReached_(0)
+        , needBackoff_(0)
     {
     }
 
@@ -237,7 +333,47 @@ public:
         return node_;
     }
 
+    /// Sets how many read or write datagrams may be waiting for their reply
+    /// at the same time. With a count above 1, the next request datagram is
+    /// sent as soon as the previous one is acknowledged, without waiting for
+    /// its reply. If the target rejects a datagram with resend OK (out of
+    /// buffers), that datagram is retried and fewer requests are kept
+    /// outstanding for the rest of the operation. Must not be called while a
+    /// request is being processed.
+    /// @param count maximum number of outstanding requests. 1 (the default)
+    /// turns off pipelining.
+    void set_max_pending(unsigned count)
+    {
+        maxPending_ = count ? count : 1;
+    }
+
 private:
+    /// One datagram sized piece of a pipelined read or write.
+    struct PipelineChunk
+    {
+        /// Address of the first byte in the memory space.
+        uint32_t address;
+        /// Offset of the first byte in the request payload (writes).
+        uint32_t payloadOffset;
+        /// Number of bytes requested.
+        uint16_t size;
+        /// 1 when the request datagram was accepted by the datagram client.
+        uint8_t isSent : 1;
+        /// 1 when the reply arrived.
+        uint8_t isDone : 1;
+        /// 1 if this chunk reached the end of the memory space.
+        uint8_t isLast : 1;
+        /// Data returned by the target (reads).
+        string data;
+
+        PipelineChunk()
+            : isSent(0)
+            , isDone(0)
+            , isLast(0)
+        {
+        }
+    };
+
     Action entry() override
     {
         request()->resultCode = OPERATION_PENDING;
@@ -245,14 +381,33 @@ private:
         {
             case MemoryConfigClientRequest::CMD_READ:
             case MemoryConfigClientRequest::CMD_READ_PART:
+                if (maxPending_ > 1)
+                {
+                    return allocate_and_call(STATE(do_pipelined),
+                        dg_service()->client_allocator());
+                }
                 return allocate_and_call(
                     STATE(do_read), dg_service()->client_allocator());
             case MemoryConfigClientRequest::CMD_WRITE:
+                if (maxPending_ > 1)
+                {
+                    return allocate_and_call(STATE(do_pipelined),
+                        dg_service()->client_allocator());
+                }
                 return allocate_and_call(
                     STATE(do_write), dg_service()->client_allocator());
             case MemoryConfigClientRequest::CMD_META_REQUEST:
                 return allocate_and_call(
                     STATE(do_meta_request), dg_service()->client_allocator());
+            case MemoryConfigClientRequest::CMD_READ_STREAM:
+                return allocate_and_call(
+                    STATE(do_read_stream), dg_service()->client_allocator());
+            case MemoryConfigClientRequest::CMD_WRITE_STREAM:
+                return allocate_and_call(
+                    STATE(do_write_stream), dg_service()->client_allocator());
+            case MemoryConfigClientRequest::CMD_SPACE_INFO:
+                return allocate_and_call(
+                    STATE(do_space_info), dg_service()->client_allocator());
             default:
                 break;
         }
@@ -263,7 +418,7 @@ private:
     {
         dgClient_ = full_allocation_result(dg_service()->client_allocator());
         offset_ = request()->address;
-        memoryConfigHandler_->set_client(&responseFlow_);
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
         return call_immediately(STATE(send_next_read));
     }
 
@@ -389,7 +544,7 @@ private:
         dgClient_ = full_allocation_result(dg_service()->client_allocator());
         offset_ = request()->address;
         payloadOffset_ = 0;
-        memoryConfigHandler_->set_client(&responseFlow_);
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
         return call_immediately(STATE(send_next_write));
     }
 
@@ -515,6 +670,622 @@ private:
         return return_ok();
     }
 
+    /// Starts a pipelined read or write.
+    Action do_pipelined()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
+        chunks_.clear();
+        offset_ = request()->address;
+        payloadOffset_ = 0;
+        pipelineWindow_ = maxPending_;
+        pipelineError_ = 0;
+        resendCount_ = 0;
+        isPipelined_ = 1;
+        isDatagramBusy_ = 0;
+        isEndReached_ = 0;
+        needBackoff_ = 0;
+        isWaitingForTimer_ = 0;
+        return call_immediately(STATE(pipeline_pump));
+    }
+
+    /// @return true if the current pipelined operation is a write.
+    bool is_pipelined_write()
+    {
+        return request()->cmd == MemoryConfigClientRequest::CMD_WRITE;
+    }
+
+    /// @return true if there are bytes that no chunk was created for yet.
+    bool pipeline_has_more()
+    {
+        if (pipelineError_ || isEndReached_)
+        {
+            return false;
+        }
+        if (is_pipelined_write())
+        {
+            return payloadOffset_ < request()->payload.size();
+        }
+        return request()->size > 0;
+    }
+
+    /// @return the number of chunks that were sent and wait for the reply.
+    unsigned pipeline_in_flight()
+    {
+        unsigned count = 0;
+        for (auto &c : chunks_)
+        {
+            if (c.isSent && !c.isDone)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    /// @return the outstanding chunk for a given address, or nullptr.
+    PipelineChunk *find_chunk(uint32_t address)
+    {
+        for (auto &c : chunks_)
+        {
+            if (c.address == address && !c.isDone)
+            {
+                return &c;
+            }
+        }
+        return nullptr;
+    }
+
+    /// Main loop of the pipelined operation. Consumes the replies in address
+    /// order, and sends the next request datagram if the window allows.
+    Action pipeline_pump()
+    {
+        isWaitingForTimer_ = 0;
+        while (!chunks_.empty() && chunks_.front().isDone)
+        {
+            PipelineChunk &c = chunks_.front();
+            if (!isEndReached_)
+            {
+                request()->payload.append(c.data);
+                // Short read or out of bounds: everything after this is past
+                // the end.
+                isEndReached_ = c.isLast;
+            }
+            chunks_.pop_front();
+        }
+        if (isEndReached_)
+        {
+            // We still wait for the replies to the requests that are out, but
+            // will not send more.
+            chunks_.erase(std::remove_if(chunks_.begin(), chunks_.end(),
+                              [](const PipelineChunk &c) { return !c.isSent; }),
+                chunks_.end());
+        }
+        if (isDatagramBusy_)
+        {
+            return call_immediately(STATE(pipeline_wait));
+        }
+        if (pipelineError_)
+        {
+            return finish_pipeline(pipelineError_);
+        }
+        if (chunks_.empty() && !pipeline_has_more())
+        {
+            return finish_pipeline(0);
+        }
+        if (needBackoff_)
+        {
+            needBackoff_ = 0;
+            return sleep_and_call(
+                &timer_, PIPELINE_RESEND_DELAY_NSEC, STATE(pipeline_pump));
+        }
+        bool have_unsent = false;
+        for (auto &c : chunks_)
+        {
+            if (!c.isSent)
+            {
+                have_unsent = true;
+                break;
+            }
+        }
+        if (pipeline_in_flight() >= pipelineWindow_ ||
+            (!have_unsent && !pipeline_has_more()))
+        {
+            return call_immediately(STATE(pipeline_wait));
+        }
+        if (!have_unsent)
+        {
+            chunks_.emplace_back();
+            PipelineChunk &c = chunks_.back();
+            c.address = offset_;
+            c.payloadOffset = payloadOffset_;
+            if (is_pipelined_write())
+            {
+                c.size = std::min(
+                    (size_t)MemoryConfigDefs::MAX_DATAGRAM_RW_BYTES,
+                    request()->payload.size() - payloadOffset_);
+            }
+            else
+            {
+                c.size = std::min(64u, request()->size);
+                if (request()->size < 0xffffffffu)
+                {
+                    request()->size -= c.size;
+                }
+            }
+            offset_ += c.size;
+            payloadOffset_ += c.size;
+        }
+        return allocate_and_call(dg_service()->iface()->dispatcher(),
+            STATE(send_pipelined_datagram));
+    }
+
+    Action send_pipelined_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        PipelineChunk *c = nullptr;
+        for (auto &cc : chunks_)
+        {
+            if (!cc.isSent)
+            {
+                c = &cc;
+                break;
+            }
+        }
+        HASSERT(c);
+        b->set_done(bn_.reset(&pipelineDatagramDone_));
+        if (is_pipelined_write())
+        {
+            b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(),
+                request()->dst,
+                MemoryConfigDefs::write_datagram(request()->memory_space,
+                    c->address,
+                    request()->payload.substr(c->payloadOffset, c->size)));
+        }
+        else
+        {
+            b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(),
+                request()->dst,
+                MemoryConfigDefs::read_datagram(
+                    request()->memory_space, c->address, c->size));
+        }
+        c->isSent = 1;
+        sendingAddress_ = c->address;
+        isDatagramBusy_ = 1;
+        dgClient_->write_datagram(b);
+        return call_immediately(STATE(pipeline_pump));
+    }
+
+    /// Waits for a datagram acknowledgement or a reply to arrive.
+    Action pipeline_wait()
+    {
+        isWaitingForTimer_ = 1;
+        return sleep_and_call(
+            &timer_, SEC_TO_NSEC(3), STATE(pipeline_wakeup));
+    }
+
+    Action pipeline_wakeup()
+    {
+        if (isWaitingForTimer_)
+        {
+            // Timer expired.
+            isWaitingForTimer_ = 0;
+            if (isEndReached_)
+            {
+                // The target did not answer the requests past the end.
+                chunks_.clear();
+            }
+            else if (!isDatagramBusy_ && !pipelineError_)
+            {
+                pipelineError_ = Defs::OPENMRN_TIMEOUT;
+            }
+        }
+        return call_immediately(STATE(pipeline_pump));
+    }
+
+    /// Wakes up the pipeline flow if it is waiting for an event.
+    void pipeline_event()
+    {
+        if (isWaitingForTimer_)
+        {
+            isWaitingForTimer_ = 0;
+            timer_.trigger();
+        }
+    }
+
+    /// Called when the datagram client is done sending a pipelined request.
+    void pipelined_datagram_done()
+    {
+        isDatagramBusy_ = 0;
+        uint32_t result = dgClient_->result();
+        if (result & DatagramClient::OPERATION_SUCCESS)
+        {
+            resendCount_ = 0;
+        }
+        else if ((result & DatagramClient::RESEND_OK) &&
+            ++resendCount_ <= MAX_PIPELINE_RESEND)
+        {
+            PipelineChunk *c = find_chunk(sendingAddress_);
+            if (c)
+            {
+                c->isSent = 0;
+            }
+            // The target ran out of buffers. Let's not have more requests
+            // outstanding than what it could handle.
+            pipelineWindow_ = std::max(1u, pipeline_in_flight());
+            needBackoff_ = 1;
+        }
+        else if (!pipelineError_)
+        {
+            pipelineError_ = result;
+        }
+        pipeline_event();
+    }
+
+    /// Called by the response flow for read and write replies in pipelined
+    /// mode. @param p is the reply datagram payload.
+    void pipelined_reply(const DatagramPayload &p)
+    {
+        if (!MemoryConfigDefs::payload_min_length_check(p, 0))
+        {
+            LOG(INFO, "Memory Config client: response datagram payload not "
+                      "long enough");
+            pipelineError_ = Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT;
+            return pipeline_event();
+        }
+        const uint8_t *bytes = MemoryConfigDefs::payload_bytes(p);
+        unsigned ofs = MemoryConfigDefs::get_payload_offset(p);
+        uint8_t cmd = bytes[1] & MemoryConfigDefs::COMMAND_MASK;
+        PipelineChunk *c = find_chunk(MemoryConfigDefs::get_address(p));
+        if (!c || !c->isSent ||
+            MemoryConfigDefs::get_space(p) != request()->memory_space)
+        {
+            // Stale reply, for example to a request after the end of the
+            // space.
+            return;
+        }
+        if (cmd == MemoryConfigDefs::COMMAND_READ_FAILED ||
+            cmd == MemoryConfigDefs::COMMAND_WRITE_FAILED)
+        {
+            uint16_t error = Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT;
+            if (p.size() >= ofs + 2)
+            {
+                error = (bytes[ofs] << 8) | bytes[ofs + 1];
+            }
+            if (error == MemoryConfigDefs::ERROR_OUT_OF_BOUNDS)
+            {
+                c->isLast = 1;
+            }
+            else if (!pipelineError_)
+            {
+                pipelineError_ = error;
+            }
+        }
+        else if (cmd == MemoryConfigDefs::COMMAND_READ_REPLY)
+        {
+            c->data.assign((const char *)bytes + ofs, p.size() - ofs);
+            if (c->data.size() < c->size)
+            {
+                c->isLast = 1;
+            }
+        }
+        c->isDone = 1;
+        pipeline_event();
+    }
+
+    /// Releases resources of the pipelined operation.
+    /// @param error is the result code to return, 0 for success.
+    Action finish_pipeline(int error)
+    {
+        isPipelined_ = 0;
+        chunks_.clear();
+        cleanup_read();
+        if (error)
+        {
+            return return_with_error(error);
+        }
+        return return_ok();
+    }
+
+    /// @return a stream ID that is different for each client instance.
+    static uint8_t allocate_stream_id()
+    {
+        static uint8_t next_id = 0;
+        uint8_t id = next_id++;
+        if (next_id == StreamDefs::INVALID_STREAM_ID)
+        {
+            next_id = 0;
+        }
+        return id;
+    }
+
+    /// @return true if the error code means that the remote node does not
+    /// know the command (so we should fall back to datagrams).
+    static bool is_unimplemented_error(int error)
+    {
+        return (error & DatagramClient::RESPONSE_CODE_MASK & 0xFFF0) ==
+            Defs::ERROR_UNIMPLEMENTED;
+    }
+
+    Action do_read_stream()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        offset_ = request()->address;
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
+        // The receiver has to be listening before the server sees the
+        // request.
+        streamReceiver_.start_receive(node_, request()->dst, localStreamId_,
+            config_memory_config_stream_window(), &request()->payload,
+            nullptr);
+        return allocate_and_call(dg_service()->iface()->dispatcher(),
+            STATE(send_read_stream_datagram));
+    }
+
+    Action send_read_stream_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(), request()->dst,
+            MemoryConfigDefs::read_stream_datagram(request()->memory_space,
+                offset_, localStreamId_, request()->size));
+        isWaitingForTimer_ = 0;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(read_stream_datagram_sent));
+    }
+
+    Action read_stream_datagram_sent()
+    {
+        if (!(dgClient_->result() & DatagramClient::OPERATION_SUCCESS))
+        {
+            streamReceiver_.cancel(dgClient_->result());
+        }
+        streamReceiver_.notify_when_done(this);
+        return wait_and_call(STATE(read_stream_done));
+    }
+
+    Action read_stream_done()
+    {
+        int error = streamReceiver_.result();
+        cleanup_read();
+        if (is_unimplemented_error(error))
+        {
+            LOG(INFO, "Memory Config client: stream read not supported, "
+                      "falling back to datagrams.");
+            request()->cmd = MemoryConfigClientRequest::CMD_READ_PART;
+            request()->payload.clear();
+            return allocate_and_call(
+                STATE(do_read), dg_service()->client_allocator());
+        }
+        if (error)
+        {
+            return return_with_error(error);
+        }
+        return return_ok();
+    }
+
+    Action do_write_stream()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        offset_ = request()->address;
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
+        return allocate_and_call(dg_service()->iface()->dispatcher(),
+            STATE(send_write_stream_datagram));
+    }
+
+    Action send_write_stream_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(), request()->dst,
+            MemoryConfigDefs::write_stream_datagram(
+                request()->memory_space, offset_, localStreamId_));
+        isWaitingForTimer_ = 0;
+        responseCode_ = DatagramClient::OPERATION_PENDING;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(write_stream_datagram_sent));
+    }
+
+    Action write_stream_datagram_sent()
+    {
+        if (!(dgClient_->result() & DatagramClient::OPERATION_SUCCESS))
+        {
+            return handle_write_stream_error(dgClient_->result());
+        }
+        if (responseCode_ & DatagramClient::OPERATION_PENDING)
+        {
+            isWaitingForTimer_ = 1;
+            return sleep_and_call(
+                &timer_, SEC_TO_NSEC(3), STATE(write_stream_response));
+        }
+        else
+        {
+            return call_immediately(STATE(write_stream_response));
+        }
+    }
+
+    Action write_stream_response()
+    {
+        isWaitingForTimer_ = 0;
+        if (responseCode_ & DatagramClient::OPERATION_PENDING)
+        {
+            return handle_write_stream_error(Defs::OPENMRN_TIMEOUT);
+        }
+        size_t len = responsePayload_.size();
+        const uint8_t *bytes =
+            MemoryConfigDefs::payload_bytes(responsePayload_);
+        if (!MemoryConfigDefs::payload_min_length_check(responsePayload_, 0))
+        {
+            return handle_write_stream_error(
+                Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+        }
+        unsigned ofs = MemoryConfigDefs::get_payload_offset(responsePayload_);
+        uint8_t cmd = bytes[1] & MemoryConfigDefs::COMMAND_MASK;
+        if (cmd == MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED)
+        {
+            if (len < ofs + 2)
+            {
+                return handle_write_stream_error(
+                    Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+            }
+            uint16_t error = bytes[ofs++];
+            error <<= 8;
+            error |= bytes[ofs];
+            return handle_write_stream_error(error);
+        }
+        if (len < ofs + 2)
+        {
+            return handle_write_stream_error(
+                Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+        }
+        uint8_t dst_stream_id = bytes[ofs + 1];
+        streamSender_.start_stream(node_, request()->dst, localStreamId_,
+            dst_stream_id, config_memory_config_stream_window(), this);
+        return wait_and_call(STATE(write_stream_open));
+    }
+
+    Action write_stream_open()
+    {
+        if (streamSender_.result())
+        {
+            return handle_write_stream_error(streamSender_.result());
+        }
+        streamSender_.send_data(
+            request()->payload.data(), request()->payload.size(), this);
+        return wait_and_call(STATE(write_stream_data_sent));
+    }
+
+    Action write_stream_data_sent()
+    {
+        streamError_ = streamSender_.result();
+        streamSender_.close_stream(this);
+        return wait_and_call(STATE(write_stream_closed));
+    }
+
+    Action write_stream_closed()
+    {
+        if (streamError_)
+        {
+            return handle_write_stream_error(streamError_);
+        }
+        cleanup_write();
+        return return_ok();
+    }
+
+    Action handle_write_stream_error(int error)
+    {
+        cleanup_write();
+        if (is_unimplemented_error(error))
+        {
+            LOG(INFO, "Memory Config client: stream write not supported, "
+                      "falling back to datagrams.");
+            request()->cmd = MemoryConfigClientRequest::CMD_WRITE;
+            return allocate_and_call(
+                STATE(do_write), dg_service()->client_allocator());
+        }
+        return return_with_error(error);
+    }
+
+    Action do_space_info()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        memoryConfigHandler_->set_client(&responseFlow_, request()->dst);
+        return allocate_and_call(
+            dg_service()->iface()->dispatcher(), STATE(send_space_info));
+    }
+
+    Action send_space_info()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        DatagramPayload p;
+        p.reserve(3);
+        p.push_back(DatagramDefs::CONFIGURATION);
+        p.push_back(MemoryConfigDefs::COMMAND_INFORMATION);
+        p.push_back(request()->memory_space);
+        b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(), request()->dst,
+            std::move(p));
+        isWaitingForTimer_ = 0;
+        responseCode_ = DatagramClient::OPERATION_PENDING;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(space_info_sent));
+    }
+
+    Action space_info_sent()
+    {
+        if (!(dgClient_->result() & DatagramClient::OPERATION_SUCCESS))
+        {
+            return space_info_error(dgClient_->result());
+        }
+        if (responseCode_ & DatagramClient::OPERATION_PENDING)
+        {
+            isWaitingForTimer_ = 1;
+            return sleep_and_call(
+                &timer_, SEC_TO_NSEC(3), STATE(space_info_response));
+        }
+        return call_immediately(STATE(space_info_response));
+    }
+
+    Action space_info_response()
+    {
+        if (responseCode_ & DatagramClient::OPERATION_PENDING)
+        {
+            return space_info_error(Defs::OPENMRN_TIMEOUT);
+        }
+        size_t len = responsePayload_.size();
+        const uint8_t *bytes =
+            MemoryConfigDefs::payload_bytes(responsePayload_);
+        if (len < 3 || bytes[2] != request()->memory_space)
+        {
+            return space_info_error(Defs::ERROR_OUT_OF_ORDER);
+        }
+        if (bytes[1] != MemoryConfigDefs::COMMAND_INFORMATION_PRESENT_REPLY)
+        {
+            return space_info_error(MemoryConfigDefs::ERROR_SPACE_NOT_KNOWN);
+        }
+        if (len < 8)
+        {
+            return space_info_error(
+                Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+        }
+        uint32_t highest = get_be32(bytes + 3);
+        uint8_t flags = bytes[7];
+        uint32_t lowest = 0;
+        if (flags & MemoryConfigDefs::FLAG_NZLA)
+        {
+            if (len < 12)
+            {
+                return space_info_error(
+                    Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
+            }
+            lowest = get_be32(bytes + 8);
+        }
+        request()->address = lowest;
+        request()->size = highest - lowest + 1;
+        request()->payload.assign(1, flags);
+        return space_info_error(0);
+    }
+
+    /// @return the big-endian 32-bit value at bytes.
+    static uint32_t get_be32(const uint8_t *bytes)
+    {
+        uint32_t a = bytes[0];
+        a <<= 8;
+        a |= bytes[1];
+        a <<= 8;
+        a |= bytes[2];
+        a <<= 8;
+        a |= bytes[3];
+        return a;
+    }
+
+    /// Releases the resources of a space info request and returns it to the
+    /// caller. @param error the result code (0 for success).
+    Action space_info_error(int error)
+    {
+        cleanup_read();
+        return return_with_error(error);
+    }
+
     Action do_meta_request()
     {
         dgClient_ = full_allocation_result(dg_service()->client_allocator());
@@ -588,6 +1359,11 @@ private:
                     {
                         break;
                     }
+                    if (parent_->isPipelined_)
+                    {
+                        parent_->pipelined_reply(message()->data()->payload);
+                        return respond_ok(0);
+                    }
                     parent_->responseCode_ = 0;
                     message()->data()->payload.swap(parent_->responsePayload_);
                     if (parent_->isWaitingForTimer_)
@@ -603,6 +1379,25 @@ private:
                     {
                         break;
                     }
+                    if (parent_->isPipelined_)
+                    {
+                        parent_->pipelined_reply(message()->data()->payload);
+                        return respond_ok(0);
+                    }
+                    parent_->responseCode_ = 0;
+                    message()->data()->payload.swap(parent_->responsePayload_);
+                    if (parent_->isWaitingForTimer_)
+                    {
+                        parent_->timer_.trigger();
+                    }
+                    return respond_ok(0);
+                case MemoryConfigDefs::COMMAND_WRITE_STREAM_REPLY:
+                case MemoryConfigDefs::COMMAND_WRITE_STREAM_FAILED:
+                    if (parent_->request()->cmd !=
+                        MemoryConfigClientRequest::CMD_WRITE_STREAM)
+                    {
+                        break;
+                    }
                     parent_->responseCode_ = 0;
                     message()->data()->payload.swap(parent_->responsePayload_);
                     if (parent_->isWaitingForTimer_)
@@ -610,6 +1405,44 @@ private:
                         parent_->timer_.trigger();
                     }
                     return respond_ok(0);
+                case MemoryConfigDefs::COMMAND_INFORMATION:
+                    // This matches both the present and not present replies
+                    // (0x86 and 0x87).
+                    if (parent_->request()->cmd !=
+                        MemoryConfigClientRequest::CMD_SPACE_INFO)
+                    {
+                        break;
+                    }
+                    parent_->responseCode_ = 0;
+                    message()->data()->payload.swap(parent_->responsePayload_);
+                    if (parent_->isWaitingForTimer_)
+                    {
+                        parent_->timer_.trigger();
+                    }
+                    return respond_ok(0);
+                case MemoryConfigDefs::COMMAND_READ_STREAM_REPLY:
+                case MemoryConfigDefs::COMMAND_READ_STREAM_FAILED:
+                {
+                    if (parent_->request()->cmd !=
+                        MemoryConfigClientRequest::CMD_READ_STREAM)
+                    {
+                        break;
+                    }
+                    // The data arrives on the stream; we only need to look
+                    // at the failure reply.
+                    if (cmd == MemoryConfigDefs::COMMAND_READ_STREAM_FAILED)
+                    {
+                        const auto &p = message()->data()->payload;
+                        unsigned ofs = MemoryConfigDefs::get_payload_offset(p);
+                        int error = Defs::ERROR_PERMANENT;
+                        if (p.size() >= ofs + 2)
+                        {
+                            error = (bytes[ofs] << 8) | bytes[ofs + 1];
+                        }
+                        parent_->streamReceiver_.cancel(error);
+                    }
+                    return respond_ok(0);
+                }
             }
             return respond_reject(Defs::ERROR_UNIMPLEMENTED_SUBCMD);
         }
@@ -622,6 +1455,31 @@ private:
         return static_cast<DatagramService *>(service());
     }
 
+    /// Forwards the datagram client's completion to the pipelined flow.
+    class PipelineDatagramDone : public Notifiable
+    {
+    public:
+        PipelineDatagramDone(MemoryConfigClient *parent)
+            : parent_(parent)
+        {
+        }
+
+        void notify() override
+        {
+            parent_->pipelined_datagram_done();
+        }
+
+    private:
+        MemoryConfigClient *parent_;
+    };
+
+    /// How long to wait before resending a datagram that the target rejected
+    /// with resend OK.
+    static constexpr long long PIPELINE_RESEND_DELAY_NSEC = MSEC_TO_NSEC(20);
+    /// How many times in a row we resend rejected datagrams before giving
+    /// up.
+    static constexpr unsigned MAX_PIPELINE_RESEND = 10;
+
     /// Node from which to send the requests out.
     Node *node_;
     /// Hook into the parent node's memory config handler service.
@@ -631,6 +1489,8 @@ private:
     DatagramClient *dgClient_{nullptr};
     /// Handler for the incoming reply datagrams.
     ResponseFlow responseFlow_{this};
+    /// Completion callback for the pipelined request datagrams.
+    PipelineDatagramDone pipelineDatagramDone_{this};
     /// Notify helper.
     BarrierNotifiable bn_;
     /// Next byte to read from the memory space.
@@ -639,14 +1499,44 @@ private:
     uint32_t payloadOffset_;
     /// How many bytes we wrote in this datagram.
     uint16_t writeLength_;
+    /// Source for stream writes.
+    StreamSender streamSender_;
+    /// Sink for stream reads.
+    StreamReceiver streamReceiver_;
+    /// Our stream ID for stream reads and writes.
+    uint8_t localStreamId_;
+    /// Error from sending the stream data, saved while closing the stream.
+    int streamError_{0};
     /// timing helper
     StateFlowTimer timer_{this};
     /// The data that came back from reading.
     string responsePayload_;
     /// error code that came with the response. 0 for success.
     int responseCode_;
+    /// Maximum number of outstanding requests; see set_max_pending().
+    unsigned maxPending_{1};
+    /// Number of outstanding requests allowed in the current pipelined
+    /// operation. Shrinks when the target rejects a datagram.
+    unsigned pipelineWindow_;
+    /// Sent and unsent requests of the pipelined operation, in address
+    /// order. Finished requests are consumed from the front.
+    std::deque<PipelineChunk> chunks_;
+    /// Error that terminates the pipelined operation, 0 if none.
+    int pipelineError_;
+    /// Address of the chunk that the datagram client is sending.
+    uint32_t sendingAddress_;
+    /// How many consecutive datagrams were rejected with resend OK.
+    unsigned resendCount_;
     /// 1 if we are pending on the timer.
     uint8_t isWaitingForTimer_ : 1;
+    /// 1 while a pipelined read or write is in progress.
+    uint8_t isPipelined_ : 1;
+    /// 1 while the datagram client is sending a pipelined request.
+    uint8_t isDatagramBusy_ : 1;
+    /// 1 if a reply showed that we are at the end of the memory space.
+    uint8_t isEndReached_ : 1;
+    /// 1 if we have to wait before resending a rejected datagram.
+    uint8_t needBackoff_ : 1;
 };
 
 } // namespace openlcb
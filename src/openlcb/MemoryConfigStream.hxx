@@ -0,0 +1,344 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file MemoryConfigStream.hxx
+ *
+ * Server side data transfer for the Read Stream and Write Stream commands of
+ * the Memory Config Protocol.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _OPENLCB_MEMORYCONFIGSTREAM_HXX_
+#define _OPENLCB_MEMORYCONFIGSTREAM_HXX_
+
+#include "nmranet_config.h"
+#include "openlcb/MemoryConfig.hxx"
+#include "openlcb/StreamReceiver.hxx"
+#include "openlcb/StreamSender.hxx"
+
+namespace openlcb
+{
+
+/// Moves data between a memory space and an OpenLCB stream, on behalf of the
+/// MemoryConfigHandler. One transfer is handled at a time.
+///
+/// Reads: the memory space is read one window at a time into a buffer, which
+/// is then handed to a StreamSender. Writes: a StreamReceiver in manual mode
+/// collects one window, which is then written to the memory space before the
+/// next window is granted to the source. If a write to the memory space
+/// fails, the stream is ended early, which tells the writer to stop.
+class MemoryConfigStreamFlow : public StateFlowBase
+{
+public:
+    /// Stream ID we use as the source of read streams.
+    static constexpr uint8_t READ_SRC_STREAM_ID = 0x5A;
+    /// Stream ID we use as the destination of write streams.
+    static constexpr uint8_t WRITE_DST_STREAM_ID = 0x5B;
+
+    /// Constructor. @param iface is the interface to run the streams on.
+    MemoryConfigStreamFlow(If *iface)
+        : StateFlowBase(iface)
+        , sender_(iface)
+        , receiver_(iface)
+    {
+    }
+
+    typedef MemorySpace::address_t address_t;
+    typedef MemorySpace::errorcode_t errorcode_t;
+
+    /// @return true if a transfer is in progress or prepared.
+    bool is_busy()
+    {
+        return !is_terminated() || isPrepared_;
+    }
+
+    /// Records the parameters of a stream read. The stream will be opened
+    /// when start_prepared() is called.
+    /// @param node local node owning the memory space.
+    /// @param dst the node that asked for the data.
+    /// @param space memory space to read.
+    /// @param address first byte to read.
+    /// @param count number of bytes to read; 0xffffffff for until the end.
+    /// @param dst_stream_id stream ID requested by the reader.
+    void prepare_read(Node *node, NodeHandle dst, MemorySpace *space,
+        address_t address, uint32_t count, uint8_t dst_stream_id)
+    {
+        HASSERT(!is_busy());
+        node_ = node;
+        remote_ = dst;
+        space_ = space;
+        address_ = address;
+        remaining_ = count;
+        dstStreamId_ = dst_stream_id;
+        isPrepared_ = true;
+    }
+
+    /// Starts the previously prepared stream read.
+    void start_prepared()
+    {
+        if (!isPrepared_)
+        {
+            return;
+        }
+        isPrepared_ = false;
+        start_flow(STATE(open_read_stream));
+    }
+
+    /// Drops the previously prepared stream read.
+    void cancel_prepared()
+    {
+        isPrepared_ = false;
+    }
+
+    /// Starts listening for an incoming stream whose data will be written to
+    /// a memory space.
+    /// @param node local node owning the memory space.
+    /// @param src the node that will send the data.
+    /// @param space memory space to write.
+    /// @param address where to write the first byte.
+    /// @return the destination stream ID to report to the writer.
+    uint8_t start_write(
+        Node *node, NodeHandle src, MemorySpace *space, address_t address)
+    {
+        HASSERT(!is_busy());
+        node_ = node;
+        remote_ = src;
+        space_ = space;
+        address_ = address;
+        buffer_.clear();
+        bufferOffset_ = 0;
+        windowsPending_ = 0;
+        isWaiting_ = false;
+        error_ = 0;
+        receiver_.set_window_notify(&windowNotify_);
+        receiver_.start_receive(node, src, WRITE_DST_STREAM_ID,
+            config_memory_config_stream_window(), &buffer_, &doneNotify_);
+        start_flow(STATE(write_window));
+        return WRITE_DST_STREAM_ID;
+    }
+
+private:
+    Action open_read_stream()
+    {
+        sender_.start_stream(node_, remote_, READ_SRC_STREAM_ID, dstStreamId_,
+            config_memory_config_stream_window(), this);
+        return wait_and_call(STATE(read_stream_open));
+    }
+
+    Action read_stream_open()
+    {
+        if (sender_.result())
+        {
+            LOG(INFO, "MemoryConfig: could not open read stream: %x",
+                (unsigned)sender_.result());
+            return exit();
+        }
+        buffer_.resize(sender_.window_size());
+        bufferOffset_ = 0;
+        error_ = 0;
+        return call_immediately(STATE(fill_read_buffer));
+    }
+
+    /// Reads the next window worth of data from the memory space.
+    Action fill_read_buffer()
+    {
+        size_t want = buffer_.size();
+        if (remaining_ < want - bufferOffset_)
+        {
+            want = bufferOffset_ + remaining_;
+        }
+        while (!error_ && bufferOffset_ < want)
+        {
+            errorcode_t error = 0;
+            size_t len = space_->read(address_,
+                (uint8_t *)&buffer_[bufferOffset_], want - bufferOffset_,
+                &error, this);
+            address_ += len;
+            bufferOffset_ += len;
+            remaining_ -= len;
+            if (error == MemorySpace::ERROR_AGAIN)
+            {
+                return wait();
+            }
+            if (error || !len)
+            {
+                // End of space or read error; we send what we have.
+                error_ = error ? error : 1;
+            }
+        }
+        if (!bufferOffset_)
+        {
+            return call_immediately(STATE(close_read_stream));
+        }
+        sender_.send_data(&buffer_[0], bufferOffset_, this);
+        return wait_and_call(STATE(read_buffer_sent));
+    }
+
+    Action read_buffer_sent()
+    {
+        if (sender_.result())
+        {
+            LOG(INFO, "MemoryConfig: read stream failed: %x",
+                (unsigned)sender_.result());
+            return call_immediately(STATE(close_read_stream));
+        }
+        bufferOffset_ = 0;
+        if (error_ || !remaining_)
+        {
+            return call_immediately(STATE(close_read_stream));
+        }
+        return call_immediately(STATE(fill_read_buffer));
+    }
+
+    Action close_read_stream()
+    {
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        sender_.close_stream(this);
+        return wait_and_call(STATE(read_stream_closed));
+    }
+
+    Action read_stream_closed()
+    {
+        return exit();
+    }
+
+    /// Called by the receiver when a window was filled (is_done == false) or
+    /// the stream finished (is_done == true).
+    void receiver_event(bool is_done)
+    {
+        if (!is_done)
+        {
+            ++windowsPending_;
+        }
+        if (isWaiting_)
+        {
+            isWaiting_ = false;
+            notify();
+        }
+    }
+
+    /// Writes the collected data to the memory space, then grants the next
+    /// window or finishes.
+    Action write_window()
+    {
+        while (!error_ && bufferOffset_ < buffer_.size())
+        {
+            errorcode_t error = 0;
+            size_t len = space_->write(address_,
+                (const uint8_t *)&buffer_[bufferOffset_],
+                buffer_.size() - bufferOffset_, &error, this);
+            address_ += len;
+            bufferOffset_ += len;
+            if (error == MemorySpace::ERROR_AGAIN)
+            {
+                return wait();
+            }
+            if (error || !len)
+            {
+                error_ = error ? error : MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+                LOG(INFO, "MemoryConfig: write stream failed: %x",
+                    (unsigned)error_);
+                receiver_.terminate(error_);
+            }
+        }
+        buffer_.clear();
+        bufferOffset_ = 0;
+        if (receiver_.is_done())
+        {
+            buffer_.shrink_to_fit();
+            return exit();
+        }
+        if (!error_)
+        {
+            for (; windowsPending_; --windowsPending_)
+            {
+                receiver_.proceed();
+            }
+        }
+        isWaiting_ = true;
+        return wait_and_call(STATE(write_window));
+    }
+
+    /// Forwards the receiver's notifications to receiver_event().
+    class ReceiverEvent : public Notifiable
+    {
+    public:
+        /// Constructor. @param parent owner; @param is_done which event this
+        /// object represents.
+        ReceiverEvent(MemoryConfigStreamFlow *parent, bool is_done)
+            : parent_(parent)
+            , isDone_(is_done)
+        {
+        }
+
+        void notify() override
+        {
+            parent_->receiver_event(isDone_);
+        }
+
+    private:
+        MemoryConfigStreamFlow *parent_;
+        bool isDone_;
+    };
+
+    /// Source of read streams.
+    StreamSender sender_;
+    /// Sink of write streams.
+    StreamReceiver receiver_;
+    ReceiverEvent windowNotify_{this, false};
+    ReceiverEvent doneNotify_{this, true};
+    /// Data being transferred.
+    std::string buffer_;
+    /// Local node.
+    Node *node_{nullptr};
+    /// The other end of the stream.
+    NodeHandle remote_;
+    /// Memory space being read or written.
+    MemorySpace *space_{nullptr};
+    /// Next address to read or write.
+    address_t address_{0};
+    /// Bytes left to read.
+    uint32_t remaining_{0};
+    /// Next byte of buffer_ to process.
+    size_t bufferOffset_{0};
+    /// Number of full windows that arrived but have not been granted again.
+    unsigned windowsPending_{0};
+    /// Memory space error that stopped the transfer, or 0.
+    errorcode_t error_{0};
+    /// Stream ID at the reader.
+    uint8_t dstStreamId_{StreamDefs::INVALID_STREAM_ID};
+    /// True between prepare_read() and start_prepared().
+    bool isPrepared_{false};
+    /// True while the write flow waits for receiver events.
+    bool isWaiting_{false};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_MEMORYCONFIGSTREAM_HXX_
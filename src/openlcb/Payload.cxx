@@ -0,0 +1,89 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file Payload.cxx
+ *
+ * Out-of-line parts of the message payload container.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include "openlcb/Payload.hxx"
+
+namespace openlcb
+{
+
+constexpr unsigned MessagePayload::INLINE_SIZE;
+constexpr unsigned MessagePayload::SLAB_SIZE;
+
+void MessagePayload::init(const char *s, size_t len)
+{
+    slab_ = nullptr;
+    size_ = 0;
+    char *d = prepare(len);
+    if (s)
+    {
+        memcpy(d, s, len);
+    }
+    set_size(d, len);
+}
+
+char *MessagePayload::reallocate(size_t len, RawBuffer **old)
+{
+    size_t alloc_size = len + 1;
+    if (alloc_size < SLAB_SIZE)
+    {
+        alloc_size = SLAB_SIZE;
+    }
+    if (slab_ && !slab_->is_shared())
+    {
+        // Growing an exclusively owned payload: leave some room for further
+        // appends.
+        size_t grown = slab_->capacity() + slab_->capacity() / 2;
+        if (alloc_size < grown)
+        {
+            alloc_size = grown;
+        }
+    }
+    HASSERT(alloc_size <= UINT16_MAX);
+    RawBuffer *slab = RawBuffer::alloc(init_main_buffer_pool(), alloc_size);
+    size_t keep = size_ < len ? size_ : len;
+    memcpy(slab->data(), data(), keep);
+    slab->data()[keep] = 0;
+    if (old)
+    {
+        *old = slab_;
+    }
+    else if (slab_)
+    {
+        slab_->unref();
+    }
+    slab_ = slab;
+    return slab->data();
+}
+
+} // namespace openlcb
@@ -26,8 +26,7 @@
  *
  * \file Payload.hxx
  *
- * Forward declaration of the class storing the payload value in an NMRAnet
- * message object.
+ * Classes storing the payload value in an NMRAnet message object.
  *
  * @author Balazs Racz
  * @date 18 May 2014
@@ -36,12 +35,495 @@
 #ifndef _OPENLCB_PAYLOAD_HXX_
 #define _OPENLCB_PAYLOAD_HXX_
 
+#include <string.h>
 #include <string>
 
+#include "utils/Buffer.hxx"
+#include "utils/macros.h"
+
 namespace openlcb {
 
+/// Container used to assemble the data bytes of an NMRAnet message.
 typedef string Payload;
 
+/// Container for the data bytes of an OpenLCB message as it is passed through
+/// the stack (GenMessage::payload).
+///
+/// Payloads of up to INLINE_SIZE bytes (event IDs, most single-frame
+/// messages) are stored in the object itself. Longer payloads are stored in a
+/// reference counted RawBuffer allocated from the main buffer pool. Copying a
+/// MessagePayload only adds a reference to the buffer; the bytes are copied
+/// when a shared payload is modified. This allows the payload assembled by
+/// the interface to be handed through the dispatcher to every handler without
+/// allocation or copying.
+///
+/// The accessors follow std::string, so that code written against a string
+/// payload keeps working. Reading never copies the bytes; only the mutators
+/// (including mutable_data()) unshare them.
+class MessagePayload
+{
+public:
+    typedef char value_type;
+    typedef size_t size_type;
+    typedef const char *const_iterator;
+
+    /// How many bytes are stored without allocating a buffer.
+    static constexpr unsigned INLINE_SIZE = 8;
+    /// Number of bytes (including the terminating zero) allocated for a
+    /// payload that is not stored inline, unless more is needed. Fits the
+    /// largest datagram. With OPENMRN_FEATURE_POOLED_PAYLOAD this fits in the
+    /// largest bucket of the main buffer pool.
+    static constexpr unsigned SLAB_SIZE = 80;
+
+    /// Creates an empty payload.
+    MessagePayload()
+        : slab_(nullptr)
+        , size_(0)
+    {
+        inline_[0] = 0;
+    }
+
+    /// Creates a payload from a zero-terminated string. @param s bytes.
+    MessagePayload(const char *s)
+    {
+        init(s, strlen(s));
+    }
+
+    /// Creates a payload from a byte array. @param s bytes, @param len how
+    /// many bytes to copy.
+    MessagePayload(const char *s, size_t len)
+    {
+        init(s, len);
+    }
+
+    /// Creates a payload by copying a string. @param s bytes to copy.
+    MessagePayload(const string &s)
+    {
+        init(s.data(), s.size());
+    }
+
+    /// Creates a payload by repeating a character. @param len how many
+    /// bytes; @param c the value of each byte.
+    MessagePayload(size_t len, char c)
+    {
+        init(nullptr, len);
+        memset(slab_ ? slab_->data() : inline_, c, len);
+    }
+
+    /// Copy constructor. Shares the buffer of o. @param o payload to copy.
+    MessagePayload(const MessagePayload &o)
+        : slab_(o.slab_)
+        , size_(o.size_)
+    {
+        if (slab_)
+        {
+            slab_->ref();
+        }
+        else
+        {
+            memcpy(inline_, o.inline_, size_ + 1);
+        }
+    }
+
+    /// Move constructor. @param o payload to take over; will be empty.
+    MessagePayload(MessagePayload &&o)
+        : slab_(o.slab_)
+        , size_(o.size_)
+    {
+        if (!slab_)
+        {
+            memcpy(inline_, o.inline_, size_ + 1);
+        }
+        o.slab_ = nullptr;
+        o.size_ = 0;
+        o.inline_[0] = 0;
+    }
+
+    ~MessagePayload()
+    {
+        if (slab_)
+        {
+            slab_->unref();
+        }
+    }
+
+    /// Copy assignment. @param o payload to share. @return *this.
+    MessagePayload &operator=(const MessagePayload &o)
+    {
+        MessagePayload(o).swap(*this);
+        return *this;
+    }
+
+    /// Move assignment. @param o payload to take over. @return *this.
+    MessagePayload &operator=(MessagePayload &&o)
+    {
+        MessagePayload(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    /// Assigns a copy of a string. @param s bytes to copy. @return *this.
+    MessagePayload &operator=(const string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    /// Assigns a zero-terminated string. @param s bytes. @return *this.
+    MessagePayload &operator=(const char *s)
+    {
+        return assign(s, strlen(s));
+    }
+
+    /// @return the number of bytes in the payload.
+    size_t size() const
+    {
+        return size_;
+    }
+
+    /// @return the number of bytes in the payload.
+    size_t length() const
+    {
+        return size_;
+    }
+
+    /// @return true if the payload has no bytes.
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /// @return how many bytes the payload can hold without reallocating.
+    size_t capacity() const
+    {
+        return slab_ ? slab_->capacity() - 1 : INLINE_SIZE;
+    }
+
+    /// @return true if the bytes are in a buffer shared with another payload.
+    bool is_shared() const
+    {
+        return slab_ && slab_->is_shared();
+    }
+
+    /// @return pointer to the bytes. Valid until the payload is modified.
+    const char *data() const
+    {
+        return slab_ ? slab_->data() : inline_;
+    }
+
+    /// @return pointer to the bytes, followed by a terminating zero.
+    const char *c_str() const
+    {
+        return data();
+    }
+
+    /// @return the byte at a given offset. @param ofs is the offset.
+    const char &operator[](size_t ofs) const
+    {
+        return data()[ofs];
+    }
+
+    /// @return writable pointer to the bytes. Unshares the payload. Valid
+    /// until the payload is modified through another call.
+    char *mutable_data()
+    {
+        return prepare(size_);
+    }
+
+    /// @return iterator to the first byte.
+    const_iterator begin() const
+    {
+        return data();
+    }
+
+    /// @return iterator past the last byte.
+    const_iterator end() const
+    {
+        return data() + size_;
+    }
+
+    /// Removes all bytes and releases the buffer.
+    void clear()
+    {
+        MessagePayload().swap(*this);
+    }
+
+    /// Makes sure the payload can grow to a given size without reallocation.
+    /// @param len the desired capacity.
+    void reserve(size_t len)
+    {
+        if (len > size_)
+        {
+            prepare(len);
+        }
+    }
+
+    /// Changes the number of bytes. @param len new size; @param c value of
+    /// the newly added bytes.
+    void resize(size_t len, char c = 0)
+    {
+        char *d = prepare(len);
+        if (len > size_)
+        {
+            memset(d + size_, c, len - size_);
+        }
+        set_size(d, len);
+    }
+
+    /// Appends a byte. @param c the byte to append.
+    void push_back(char c)
+    {
+        char *d = prepare(size_ + 1);
+        d[size_] = c;
+        set_size(d, size_ + 1);
+    }
+
+    /// Removes the last byte.
+    void pop_back()
+    {
+        HASSERT(size_ > 0);
+        resize(size_ - 1);
+    }
+
+    /// Appends bytes. @param s bytes to append; @param len how many. @return
+    /// *this.
+    MessagePayload &append(const char *s, size_t len)
+    {
+        // s may point into our own bytes (e.g. p.append(p)), so the old
+        // buffer is released only after the copy.
+        RawBuffer *old = nullptr;
+        char *d = prepare(size_ + len, &old);
+        memmove(d + size_, s, len);
+        set_size(d, size_ + len);
+        if (old)
+        {
+            old->unref();
+        }
+        return *this;
+    }
+
+    /// Appends repeated bytes. @param len how many; @param c value. @return
+    /// *this.
+    MessagePayload &append(size_t len, char c)
+    {
+        char *d = prepare(size_ + len);
+        memset(d + size_, c, len);
+        set_size(d, size_ + len);
+        return *this;
+    }
+
+    /// Appends a zero-terminated string. @param s bytes. @return *this.
+    MessagePayload &append(const char *s)
+    {
+        return append(s, strlen(s));
+    }
+
+    /// Appends a string. @param s bytes. @return *this.
+    MessagePayload &append(const string &s)
+    {
+        return append(s.data(), s.size());
+    }
+
+    /// Appends another payload. @param s bytes. @return *this.
+    MessagePayload &append(const MessagePayload &s)
+    {
+        return append(s.data(), s.size());
+    }
+
+    /// Appends a byte. @param c the byte. @return *this.
+    MessagePayload &operator+=(char c)
+    {
+        push_back(c);
+        return *this;
+    }
+
+    /// Appends a zero-terminated string. @param s bytes. @return *this.
+    MessagePayload &operator+=(const char *s)
+    {
+        return append(s);
+    }
+
+    /// Appends a string. @param s bytes. @return *this.
+    MessagePayload &operator+=(const string &s)
+    {
+        return append(s);
+    }
+
+    /// Appends another payload. @param s bytes. @return *this.
+    MessagePayload &operator+=(const MessagePayload &s)
+    {
+        return append(s);
+    }
+
+    /// Replaces the contents. @param s bytes; @param len how many. @return
+    /// *this.
+    MessagePayload &assign(const char *s, size_t len)
+    {
+        if (slab_ && slab_->is_shared())
+        {
+            // Avoids copying the old contents when unsharing.
+            clear();
+        }
+        size_ = 0;
+        return append(s, len);
+    }
+
+    /// Replaces the contents with repeated bytes. @param len how many;
+    /// @param c value. @return *this.
+    MessagePayload &assign(size_t len, char c)
+    {
+        if (slab_ && slab_->is_shared())
+        {
+            clear();
+        }
+        size_ = 0;
+        return append(len, c);
+    }
+
+    /// Replaces the contents. @param s bytes. @return *this.
+    MessagePayload &assign(const string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    /// @return a string with a part of the payload. @param ofs first byte;
+    /// @param len how many bytes at most.
+    string substr(size_t ofs, size_t len = string::npos) const
+    {
+        HASSERT(ofs <= size_);
+        if (len > size_ - ofs)
+        {
+            len = size_ - ofs;
+        }
+        return string(data() + ofs, len);
+    }
+
+    /// Exchanges the contents with another payload. @param o payload.
+    void swap(MessagePayload &o)
+    {
+        std::swap(slab_, o.slab_);
+        std::swap(size_, o.size_);
+        char tmp[INLINE_SIZE + 1];
+        memcpy(tmp, inline_, sizeof(tmp));
+        memcpy(inline_, o.inline_, sizeof(tmp));
+        memcpy(o.inline_, tmp, sizeof(tmp));
+    }
+
+    /// Exchanges the contents with a string. This copies the bytes. @param s
+    /// string.
+    void swap(string &s)
+    {
+        string tmp(data(), size_);
+        assign(s.data(), s.size());
+        s.swap(tmp);
+    }
+
+    /// @return a copy of the payload as a string.
+    string str() const
+    {
+        return string(data(), size_);
+    }
+
+    /// @return a copy of the payload as a string.
+    operator string() const
+    {
+        return str();
+    }
+
+private:
+    /// Sets the contents of a newly constructed object. @param s bytes to
+    /// copy, or nullptr to leave them uninitialized; @param len how many.
+    void init(const char *s, size_t len);
+
+    /// Makes sure that the bytes are not shared with another payload and
+    /// that there is room for a given number of bytes.
+    /// @param len the desired capacity.
+    /// @param old if not null, the replaced buffer is returned here instead
+    /// of being released; the caller has to unref it.
+    /// @return pointer to the writable bytes.
+    char *prepare(size_t len, RawBuffer **old = nullptr)
+    {
+        if (slab_)
+        {
+            if (len < slab_->capacity() && !slab_->is_shared())
+            {
+                return slab_->data();
+            }
+        }
+        else if (len <= INLINE_SIZE)
+        {
+            return inline_;
+        }
+        return reallocate(len, old);
+    }
+
+    /// Slow path of prepare(): moves the bytes to a new buffer.
+    /// @param len the desired capacity; @param old see prepare(). @return
+    /// pointer to the bytes.
+    char *reallocate(size_t len, RawBuffer **old);
+
+    /// Updates the size and the terminating zero. @param d is the return of
+    /// prepare(); @param len the new size.
+    void set_size(char *d, size_t len)
+    {
+        size_ = len;
+        d[len] = 0;
+    }
+
+    /// Buffer holding the bytes, or nullptr if they are stored inline.
+    RawBuffer *slab_;
+    /// Number of bytes in the payload.
+    uint16_t size_;
+    /// Storage for short payloads (plus terminating zero).
+    char inline_[INLINE_SIZE + 1];
+};
+
+/// @return true if the two payloads have the same bytes. @param a @param b
+/// payloads to compare.
+inline bool operator==(const MessagePayload &a, const MessagePayload &b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+/// @return true if the payload and the string have the same bytes. @param a
+/// @param b payloads to compare.
+inline bool operator==(const MessagePayload &a, const string &b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+/// @return true if the payload and the string have the same bytes. @param a
+/// @param b payloads to compare.
+inline bool operator==(const string &a, const MessagePayload &b)
+{
+    return b == a;
+}
+
+/// @return true if the payload and the string have the same bytes. @param a
+/// @param b payloads to compare.
+inline bool operator==(const MessagePayload &a, const char *b)
+{
+    size_t len = strlen(b);
+    return a.size() == len && memcmp(a.data(), b, len) == 0;
+}
+
+/// @return true if the payload and the string have the same bytes. @param a
+/// @param b payloads to compare.
+inline bool operator==(const char *a, const MessagePayload &b)
+{
+    return b == a;
+}
+
+/// @return true if the payloads differ. @param a @param b payloads.
+template <class T> inline bool operator!=(const MessagePayload &a, const T &b)
+{
+    return !(a == b);
+}
+
+/// @return true if the payloads differ. @param a @param b payloads.
+inline bool operator!=(const string &a, const MessagePayload &b)
+{
+    return !(b == a);
+}
+
 } // namespace openlcb
 
 #endif // _OPENLCB_PAYLOAD_HXX_
@@ -36,9 +36,11 @@
 #ifndef _OPENLCB_ROUTNGLOGIC_HXX_
 #define _OPENLCB_ROUTNGLOGIC_HXX_
 
+#include <atomic>
+#include <memory>
 #include <set>
 #include <map>
-#include <unordered_map>
+#include <vector>
 
 #include "os/OS.hxx"
 #include "openlcb/EventHandler.hxx"
@@ -61,15 +63,38 @@ uint8_t event_range_to_bit_count(EventId *event);
  *
  * The routing table contains which direction to send addressed packets as well
  * as filters for the event IDs that have listeners in a given port.
+ *
+ * The address table is read on every frame, so lookups take no lock: it is
+ * an open-addressing hash table with atomic slots, and readers only ever
+ * load from it. Writers are serialized by a mutex and only write when a
+ * mapping actually changes. Entries are never deleted, only nulled out. When
+ * the table fills up, a copy with twice the size is published; the old
+ * copies are kept until the destructor, because readers may still be
+ * looking at them.
+ *
+ * The event filter of a port is only trusted once the port has finished
+ * identifying its consumers. Nodes answer an Identify Events, or announce
+ * themselves after Initialization Complete, with a burst of Consumer /
+ * Producer Identified messages; the burst is considered complete once no
+ * identification has arrived from the port for the settle time. Until then
+ * all event reports are forwarded to the port.
+ *
+ * Address must be an integer type; the address 0 is not valid.
  */
 template <class Port, typename Address> class RoutingLogic
 {
 public:
-    RoutingLogic()
-    {
-    }
-    ~RoutingLogic()
+    /** Constructor.
+     *
+     * @param settle_nsec is how long a port has to be quiet after an
+     * identification or a new node before its event filter is used.
+     */
+    RoutingLogic(long long settle_nsec = 0)
+        : settleNsec_(settle_nsec)
     {
+        AddressTable *t = new AddressTable(INITIAL_ADDRESS_TABLE_SIZE);
+        allTables_.emplace_back(t);
+        addressTable_.store(t, std::memory_order_release);
     }
 
     /** Clears all entries in the routing table related to a given port, as the
@@ -79,18 +104,24 @@ public:
      */
     void remove_port(Port *port)
     {
-        OSMutexLock l(&lock_);
-        eventRoutingTable_.erase(port);
-        // Removing entries from a hashmap invalidates an iterator, thus it is
-        // safer to null them out than actually remove. Having a null value
-        // will cause address lookup to return null for a node that has not
-        // been seen since then elsewhere, which is exactly the behavior we
-        // want.
-        for (auto &it : addressRoutingTable_)
         {
-            if (it.second == port)
+            OSMutexLock l(&lock_);
+            eventRoutingTable_.erase(port);
+        }
+        // Lookups may be running in parallel, thus we null out the entries
+        // instead of removing them. Having a null value will cause address
+        // lookup to return null for a node that has not been seen since then
+        // elsewhere, which is exactly the behavior we want. Older copies of
+        // the table are cleaned too, because a reader may have just loaded
+        // one of those.
+        OSMutexLock l(&writeLock_);
+        for (const auto &t : allTables_)
+        {
+            for (size_t i = 0; i <= t->mask; ++i)
             {
-                it.second = nullptr;
+                Port *expected = port;
+                t->slots[i].port.compare_exchange_strong(
+                    expected, nullptr, std::memory_order_release);
             }
         }
     }
@@ -104,24 +135,51 @@ public:
      */
     void add_node_id_to_route(Port *port, Address source)
     {
-        OSMutexLock l(&lock_);
-        addressRoutingTable_[source] = port;
+        HASSERT(source != 0);
+        if (lookup_port_for_address(source) == port)
+        {
+            // Common case: we knew this already. No need to write anything.
+            return;
+        }
+        OSMutexLock l(&writeLock_);
+        AddressTable *t = addressTable_.load(std::memory_order_relaxed);
+        AddressSlot *slot = t->find_slot(source);
+        if (slot->address.load(std::memory_order_relaxed) == source)
+        {
+            slot->port.store(port, std::memory_order_release);
+            return;
+        }
+        if ((t->count + 1) * 2 > t->mask + 1)
+        {
+            t = grow(t);
+            slot = t->find_slot(source);
+        }
+        // The port has to be visible before the key, because readers stop at
+        // the key.
+        slot->port.store(port, std::memory_order_relaxed);
+        slot->address.store(source, std::memory_order_release);
+        ++t->count;
     }
 
-    /** Looks up which port an addressed packet should be sent to.
+    /** Looks up which port an addressed packet should be sent to. Does not
+     * block.
      *
      * @param dest is the address of the destination node that needs to be
      * contacted.
      * @returns a (live) port if the address is in the routing table, otherwise
-     * nullptr.
+     * nullptr. For dest == 0 (which marks free slots) the result is
+     * meaningless: it may be the port of a slot that a concurrent
+     * add_node_id_to_route() is still filling in.
      */
     Port *lookup_port_for_address(Address dest)
     {
-        OSMutexLock l(&lock_);
-        auto it = addressRoutingTable_.find(dest);
-        if (it == addressRoutingTable_.end())
+        AddressTable *t = addressTable_.load(std::memory_order_acquire);
+        AddressSlot *slot = t->find_slot(dest);
+        if (slot->address.load(std::memory_order_acquire) != dest)
+        {
             return nullptr;
-        return it->second;
+        }
+        return slot->port.load(std::memory_order_acquire);
     }
 
     /** Declares that there is a consumer for the given event ID on the given
@@ -133,7 +191,10 @@ public:
     void register_consumer(Port *port, EventId event)
     {
         OSMutexLock l(&lock_);
-        eventRoutingTable_[port].registeredConsumers_[0].insert(event);
+        EventSet &es = eventRoutingTable_[port];
+        es.registered_ = true;
+        es.settledAt_ = os_get_time_monotonic() + settleNsec_;
+        es.registeredConsumers_[0].insert(event);
     }
 
     /** Declares that there is a consumer for the given event ID range on the
@@ -146,8 +207,27 @@ public:
     {
         OSMutexLock l(&lock_);
         uint8_t bit_count = event_range_to_bit_count(&encoded_range);
-        eventRoutingTable_[port].registeredConsumers_[bit_count].insert(
-            encoded_range);
+        EventSet &es = eventRoutingTable_[port];
+        es.registered_ = true;
+        es.settledAt_ = os_get_time_monotonic() + settleNsec_;
+        es.registeredConsumers_[bit_count].insert(encoded_range);
+    }
+
+    /** Declares that there may be consumers on the given port that we have
+     * not heard about, because a new node has just joined there. All PCER
+     * messages will be forwarded to the port until it has been quiet for the
+     * settle time, which gives the new node time to identify its consumers.
+     * The consumers registered so far are kept.
+     *
+     * @param port is where the new node has appeared. */
+    void set_port_unknown(Port *port)
+    {
+        OSMutexLock l(&lock_);
+        auto ip = eventRoutingTable_.find(port);
+        if (ip != eventRoutingTable_.end())
+        {
+            ip->second.settledAt_ = os_get_time_monotonic() + settleNsec_;
+        }
     }
 
     /** Declares that there is a producer for the given event ID on the given
@@ -181,14 +261,24 @@ public:
      * @param port is the port to query.
      * @param event is the event ID from the PCER message.
      *
-     * @return true if the given event has a consumer on the given port. */
+     * @return true if the given event has a consumer on the given port, or
+     * if we have not yet learned which consumers the port has. */
     bool check_pcer(Port *port, EventId event)
     {
         OSMutexLock l(&lock_);
         auto ip = eventRoutingTable_.find(port);
-        if (ip == eventRoutingTable_.end())
+        if (ip == eventRoutingTable_.end() || !ip->second.registered_)
+        {
+            return true;
+        }
+        if (ip->second.settledAt_)
         {
-            return false;
+            if (os_get_time_monotonic() < ip->second.settledAt_)
+            {
+                return true;
+            }
+            // Saves reading the clock for the next event.
+            ip->second.settledAt_ = 0;
         }
         for (auto im = ip->second.registeredConsumers_.begin();
              im != ip->second.registeredConsumers_.end(); ++im)
@@ -215,15 +305,116 @@ public:
     }
 
 private:
-    /// Protects all internal data structures.
+    /// Number of slots in the address table to start with.
+    static constexpr size_t INITIAL_ADDRESS_TABLE_SIZE = 64;
+
+    /// One entry of the address table.
+    struct AddressSlot
+    {
+        /// Creates a free slot.
+        AddressSlot()
+            : address(0)
+            , port(nullptr)
+        {
+        }
+
+        /// Node address, or 0 if the slot is free. Once set, it never
+        /// changes.
+        std::atomic<Address> address;
+        /// Where the node is reachable.
+        std::atomic<Port *> port;
+    };
+
+    /// Open-addressing hash table with linear probing, at most half full.
+    struct AddressTable
+    {
+        /// Number of slots minus one. The number of slots is a power of two.
+        size_t mask;
+        /// Number of slots in use. Only touched by writers.
+        size_t count;
+        /// The entries (mask + 1 of them).
+        std::unique_ptr<AddressSlot[]> slots;
+
+        /// Creates an empty table. @param size number of slots, must be a
+        /// power of two.
+        AddressTable(size_t size)
+            : mask(size - 1)
+            , count(0)
+            , slots(new AddressSlot[size])
+        {
+        }
+
+        /// @return the slot that holds an address, or the free slot where it
+        /// should be inserted. @param a the address to look for.
+        AddressSlot *find_slot(Address a)
+        {
+            size_t i = hash(a) & mask;
+            while (true)
+            {
+                Address k = slots[i].address.load(std::memory_order_acquire);
+                if (k == a || k == 0)
+                {
+                    return &slots[i];
+                }
+                i = (i + 1) & mask;
+            }
+        }
+
+        /// @return hash value for an address. @param a address.
+        static size_t hash(Address a)
+        {
+            uint64_t h = static_cast<uint64_t>(a) * UINT64_C(0x9E3779B97F4A7C15);
+            return static_cast<size_t>(h >> 32);
+        }
+    };
+
+    /// Publishes a copy of a table with twice the size. Must be called with
+    /// writeLock_ held. @param t the current table. @return the new table.
+    AddressTable *grow(AddressTable *t)
+    {
+        AddressTable *n = new AddressTable((t->mask + 1) * 2);
+        for (size_t i = 0; i <= t->mask; ++i)
+        {
+            Address a = t->slots[i].address.load(std::memory_order_relaxed);
+            if (a == 0)
+            {
+                continue;
+            }
+            AddressSlot *slot = n->find_slot(a);
+            slot->port.store(t->slots[i].port.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            slot->address.store(a, std::memory_order_relaxed);
+            ++n->count;
+        }
+        allTables_.emplace_back(n);
+        addressTable_.store(n, std::memory_order_release);
+        return n;
+    }
+
+    /// How long a port has to be quiet before its event filter is used.
+    long long settleNsec_;
+    /// Protects the event routing table.
     OSMutex lock_;
 
-    /// Stores all known addresses and which port they route to.
-    std::unordered_map<Address, Port *> addressRoutingTable_;
+    /// Serializes the writers of the address table.
+    OSMutex writeLock_;
+    /// The current address table. Stores all known addresses and which port
+    /// they route to.
+    std::atomic<AddressTable *> addressTable_;
+    /// Every address table ever allocated (including the current one). Old
+    /// tables are kept until destruction, because readers may still use them.
+    std::vector<std::unique_ptr<AddressTable>> allTables_;
 
     /// The per-port event information.
     struct EventSet
     {
+        /// True once a consumer or producer has been registered on this
+        /// port.
+        bool registered_{false};
+        /// Until this time (os_get_time_monotonic) there may be consumers on
+        /// this port that have not been registered yet. 0 if that time has
+        /// passed.
+        long long settledAt_{0};
         /// key: number of bits set in the mask part. Valid values:
         /// 0..64. Value of 0 means individual event.
         std::map<uint8_t, std::set<EventId>> registeredConsumers_;
@@ -42,6 +42,7 @@
 #include <termios.h> /* tc* functions */
 #endif
 #if defined(__linux__)
+#include "openlcb/SocketCanFilters.hxx"
 #include "utils/HubDeviceSelect.hxx"
 #include <linux/sockios.h>
 #include <sys/ioctl.h>
@@ -214,7 +215,8 @@ void SimpleCanStackBase::start_iface(bool restart)
     }
 
     // Bootstraps the fresh alias allocation process.
-    if_can()->alias_allocator()->send(if_can()->alias_allocator()->alloc());
+    if_can()->alias_allocator()->reserve_aliases(
+        config_reserved_alias_pool_size());
 }
 
 void SimpleStackBase::restart_stack()
@@ -401,36 +403,29 @@ void SimpleCanStackBase::add_gridconnect_tty(
 void SimpleCanStackBase::add_socketcan_port_select(
     const char *device, int loopback)
 {
-    int s;
-    struct sockaddr_can addr;
-    struct ifreq ifr;
-
-    s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
-
-    // Set the blocking limit to the minimum allowed, typically 1024 in Linux
-    int sndbuf = 0;
-    setsockopt(s, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
-
-    // turn on/off loopback
-    setsockopt(s, SOL_CAN_RAW, CAN_RAW_LOOPBACK, &loopback, sizeof(loopback));
-
-    // setup error notifications
-    can_err_mask_t err_mask = CAN_ERR_TX_TIMEOUT | CAN_ERR_LOSTARB |
-        CAN_ERR_CRTL | CAN_ERR_PROT | CAN_ERR_TRX | CAN_ERR_ACK |
-        CAN_ERR_BUSOFF | CAN_ERR_BUSERROR | CAN_ERR_RESTARTED;
-    setsockopt(s, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask));
-    strcpy(ifr.ifr_name, device);
-
-    ::ioctl(s, SIOCGIFINDEX, &ifr);
-
-    addr.can_family = AF_CAN;
-    addr.can_ifindex = ifr.ifr_ifindex;
-
-    bind(s, (struct sockaddr *)&addr, sizeof(addr));
-
-    auto *port = new HubDeviceSelect<CanHubFlow>(can_hub(), s);
+    int s = SocketCanHubPort::open_socket(device, loopback);
+    HASSERT(s >= 0);
+    auto *port = new SocketCanHubPort(can_hub(), s);
+    socketCanPorts_.push_back(port);
     additionalComponents_.emplace_back(port);
 }
+
+void SimpleCanStackBase::restrict_socketcan_to_local_nodes()
+{
+    std::vector<NodeAlias> aliases;
+    executor()->sync_run([this, &aliases]() {
+        if_can()->local_aliases()->for_each(
+            [](void *ctx, NodeID, NodeAlias alias) {
+                static_cast<std::vector<NodeAlias> *>(ctx)->push_back(alias);
+            },
+            &aliases);
+    });
+    auto filters = socketcan_local_node_filters(aliases);
+    for (auto *port : socketCanPorts_)
+    {
+        port->set_filters(filters);
+    }
+}
 #endif
 extern Pool *const __attribute__((__weak__)) g_incoming_datagram_allocator =
     init_main_buffer_pool();
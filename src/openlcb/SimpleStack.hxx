@@ -61,6 +61,9 @@
 #ifdef __FreeRTOS__
 #include "utils/HubDeviceSelect.hxx"
 #endif
+#if defined(__linux__)
+#include "utils/SocketCanHub.hxx"
+#endif
 
 namespace openmrn_arduino
 {
@@ -361,6 +364,14 @@ public:
     ///                  0 to enable loopback localy to other open references,
     ///                  in most cases, this paramter won't matter
     void add_socketcan_port_select(const char *device, int loopback = 1);
+
+    /// Installs kernel receive filters on the ports added with
+    /// add_socketcan_port_select() so that datagram and stream frames
+    /// addressed to other nodes never reach this process. Call it after the
+    /// stack has started, and again when the local aliases change. Must not
+    /// be used if frames from the socketcan port are forwarded to other
+    /// nodes, e.g. via a TCP hub.
+    void restrict_socketcan_to_local_nodes();
 #endif
 
     /// Starts a TCP server on the specified port in listening mode. Each
@@ -460,6 +471,12 @@ private:
     /// the CAN interface to function. Will be called exactly once by the
     /// constructor of the base class.
     std::unique_ptr<PhysicalIf> create_if(const openlcb::NodeID node_id);
+
+#if defined(__linux__)
+    /// Ports added by add_socketcan_port_select. Owned by
+    /// additionalComponents_.
+    std::vector<SocketCanHubPort *> socketCanPorts_;
+#endif
 };
 
 class SimpleTcpStackBase : public SimpleStackBase
@@ -0,0 +1,100 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file SocketCanFilters.hxx
+ *
+ * Kernel receive filters for SocketCAN ports that only serve local nodes.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _OPENLCB_SOCKETCANFILTERS_HXX_
+#define _OPENLCB_SOCKETCANFILTERS_HXX_
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+
+#include <linux/can.h>
+#include <vector>
+
+#include "openlcb/CanDefs.hxx"
+
+namespace openlcb
+{
+
+/// Computes SocketCAN receive filters (see SocketCanHubPort::set_filters)
+/// that let through only the OpenLCB frames that local nodes with the given
+/// aliases need to see:
+///
+/// - all CAN control frames (CID, RID, AMD, AME, AMR), for alias conflict
+///   detection;
+/// - all global and addressed message frames. The destination of addressed
+///   messages and the event ID of event reports are in the payload, which the
+///   kernel filters cannot look at;
+/// - datagram and stream frames whose destination is one of the aliases.
+///
+/// Everything else, i.e. datagram and stream traffic between other nodes and
+/// standard (11-bit) frames, is dropped by the kernel. Not suitable for ports
+/// that forward traffic to other nodes (bridges, hubs).
+///
+/// @param aliases the aliases of the local nodes, including reserved ones.
+/// @return the filter list.
+inline std::vector<struct can_filter> socketcan_local_node_filters(
+    const std::vector<NodeAlias> &aliases)
+{
+    std::vector<struct can_filter> ret;
+    struct can_filter f;
+    // Control frames: frame type bit is zero.
+    f.can_id = CAN_EFF_FLAG;
+    f.can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | CanDefs::FRAME_TYPE_MASK;
+    ret.push_back(f);
+    // Global and addressed messages.
+    f.can_id = CAN_EFF_FLAG | CanDefs::FRAME_TYPE_MASK |
+        (CanDefs::GLOBAL_ADDRESSED << CanDefs::CAN_FRAME_TYPE_SHIFT);
+    f.can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | CanDefs::FRAME_TYPE_MASK |
+        CanDefs::CAN_FRAME_TYPE_MASK;
+    ret.push_back(f);
+    // Datagrams and streams to the local nodes.
+    for (NodeAlias a : aliases)
+    {
+        if (!a)
+        {
+            continue;
+        }
+        f.can_id = CAN_EFF_FLAG | CanDefs::FRAME_TYPE_MASK |
+            ((uint32_t)a << CanDefs::DST_SHIFT);
+        f.can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | CanDefs::FRAME_TYPE_MASK |
+            CanDefs::DST_MASK;
+        ret.push_back(f);
+    }
+    return ret;
+}
+
+} // namespace openlcb
+
+#endif // __linux__
+
+#endif // _OPENLCB_SOCKETCANFILTERS_HXX_
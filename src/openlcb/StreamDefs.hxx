@@ -31,6 +31,9 @@
  * @date 14 December 2014
  */
 
+#ifndef _OPENLCB_STREAMDEFS_HXX_
+#define _OPENLCB_STREAMDEFS_HXX_
+
 #include "openlcb/If.hxx"
 
 namespace openlcb
@@ -41,6 +44,9 @@ struct StreamDefs
 {
     static const uint16_t MAX_PAYLOAD = 0xffff;
 
+    /// Stream ID value meaning "not assigned" / "no preference".
+    static const uint8_t INVALID_STREAM_ID = 0xff;
+
     enum Flags
     {
         FLAG_CARRIES_ID = 0x01,
@@ -59,9 +65,15 @@ struct StreamDefs
         REJECT_TEMPORARY_OUT_OF_ORDER = 0x40,
     };
 
+    /// Creates the payload of a Stream Initiate Request message.
+    /// @param max_buffer_size proposed window size in bytes.
+    /// @param has_ident true if the stream data will carry the content UID.
+    /// @param src_stream_id source stream ID assigned by the sender.
+    /// @param dst_stream_id suggested destination stream ID, or
+    /// INVALID_STREAM_ID to let the receiver assign one.
     static Payload create_initiate_request(uint16_t max_buffer_size,
-                                           bool has_ident,
-                                           uint8_t src_stream_id)
+        bool has_ident, uint8_t src_stream_id,
+        uint8_t dst_stream_id = INVALID_STREAM_ID)
     {
         Payload p(5, 0);
         p[0] = max_buffer_size >> 8;
@@ -69,6 +81,41 @@ struct StreamDefs
         p[2] = has_ident ? FLAG_CARRIES_ID : 0;
         p[3] = 0;
         p[4] = src_stream_id;
+        if (dst_stream_id != INVALID_STREAM_ID)
+        {
+            p.push_back(dst_stream_id);
+        }
+        return p;
+    }
+
+    /// Creates the payload of a Stream Initiate Reply message.
+    /// @param max_buffer_size negotiated window size in bytes (zero when
+    /// rejecting).
+    /// @param src_stream_id source stream ID from the request.
+    /// @param dst_stream_id destination stream ID assigned by the receiver.
+    /// @param flags FLAG_ACCEPT, or the reject flags.
+    /// @param additional_flags reject reason.
+    static Payload create_initiate_response(uint16_t max_buffer_size,
+        uint8_t src_stream_id, uint8_t dst_stream_id,
+        uint8_t flags = FLAG_ACCEPT, uint8_t additional_flags = 0)
+    {
+        Payload p(6, 0);
+        p[0] = max_buffer_size >> 8;
+        p[1] = max_buffer_size & 0xff;
+        p[2] = flags;
+        p[3] = additional_flags;
+        p[4] = src_stream_id;
+        p[5] = dst_stream_id;
+        return p;
+    }
+
+    /// Creates the payload of a Stream Data Proceed message.
+    static Payload create_data_proceed(
+        uint8_t src_stream_id, uint8_t dst_stream_id)
+    {
+        Payload p(4, 0);
+        p[0] = src_stream_id;
+        p[1] = dst_stream_id;
         return p;
     }
 
@@ -79,6 +126,21 @@ struct StreamDefs
         p[1] = dst_stream_id;
         return p;
     }
+
+    /// Creates the payload of a Stream Data Complete message carrying the
+    /// total number of bytes transferred.
+    static Payload create_close_request(
+        uint8_t src_stream_id, uint8_t dst_stream_id, uint32_t total_bytes)
+    {
+        Payload p = create_close_request(src_stream_id, dst_stream_id);
+        p.push_back((total_bytes >> 24) & 0xff);
+        p.push_back((total_bytes >> 16) & 0xff);
+        p.push_back((total_bytes >> 8) & 0xff);
+        p.push_back(total_bytes & 0xff);
+        return p;
+    }
 };
 
 } // namespace openlcb
+
+#endif // _OPENLCB_STREAMDEFS_HXX_
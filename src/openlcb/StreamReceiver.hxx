@@ -0,0 +1,444 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file StreamReceiver.hxx
+ *
+ * Sink side of the OpenLCB stream protocol.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _OPENLCB_STREAMRECEIVER_HXX_
+#define _OPENLCB_STREAMRECEIVER_HXX_
+
+#include "executor/StateFlow.hxx"
+#include "openlcb/If.hxx"
+#include "openlcb/StreamDefs.hxx"
+
+namespace openlcb
+{
+
+/// Accepts one incoming OpenLCB stream and collects its data into a string.
+///
+/// The receiver grants a window of at most max_window bytes. Whenever a full
+/// window has arrived, it either sends the Stream Data Proceed message right
+/// away (automatic mode), or notifies the consumer, which then processes the
+/// data and calls proceed() (manual mode, see set_window_notify()).
+///
+/// The operation completes when the source closes the stream, or when no
+/// stream traffic arrives for the timeout period. All calls have to be made on
+/// the interface's executor.
+class StreamReceiver : public StateFlowBase
+{
+public:
+    /// Result codes in addition to the ones in Defs::ErrorCodes.
+    enum ResultCodes
+    {
+        OPERATION_SUCCESS = 0,
+        OPERATION_PENDING = 0x20000,
+        /// No stream traffic arrived for the timeout period.
+        TIMEOUT = Defs::ERROR_PERMANENT | Defs::OPENMRN_TIMEOUT,
+    };
+
+    /// Constructor. @param iface is the interface to receive the stream on.
+    StreamReceiver(If *iface)
+        : StateFlowBase(iface)
+    {
+    }
+
+    ~StreamReceiver()
+    {
+        unregister_handlers();
+    }
+
+    /// Starts listening for a stream.
+    /// @param node the local node that will receive the stream.
+    /// @param src the node that is expected to send the stream.
+    /// @param dst_stream_id our stream ID. Incoming requests suggesting a
+    /// different destination stream ID are ignored.
+    /// @param max_window largest window to grant to the sender.
+    /// @param target received data gets appended to this string.
+    /// @param done will be notified when the stream completes or fails. May
+    /// be nullptr; see notify_when_done().
+    void start_receive(Node *node, NodeHandle src, uint8_t dst_stream_id,
+        uint16_t max_window, std::string *target, Notifiable *done)
+    {
+        HASSERT(is_terminated() && !isRegistered_);
+        node_ = node;
+        src_ = src;
+        dstStreamId_ = dst_stream_id;
+        srcStreamId_ = StreamDefs::INVALID_STREAM_ID;
+        maxWindow_ = max_window;
+        windowSize_ = 0;
+        windowRemaining_ = 0;
+        target_ = target;
+        done_ = done;
+        totalBytes_ = 0;
+        progress_ = 0;
+        lastProgress_ = 0;
+        isStarted_ = false;
+        result_ = OPERATION_PENDING;
+        register_handlers();
+        start_flow(STATE(wait_for_traffic));
+    }
+
+    /// Switches to manual mode: the receiver will notify n after each full
+    /// window instead of sending the proceed message on its own. Call before
+    /// start_receive(). @param n notifiable, or nullptr for automatic mode.
+    void set_window_notify(Notifiable *n)
+    {
+        windowNotify_ = n;
+    }
+
+    /// Sets whom to notify when the receive operation ends. If it has already
+    /// ended, n is notified right away. @param n notifiable.
+    void notify_when_done(Notifiable *n)
+    {
+        if (is_terminated())
+        {
+            n->notify();
+        }
+        else
+        {
+            done_ = n;
+        }
+    }
+
+    /// Sends a Stream Data Proceed message to the source, granting another
+    /// window. Used in manual mode after the consumer processed the data.
+    void proceed()
+    {
+        if (!isRegistered_ || !isStarted_)
+        {
+            return;
+        }
+        send_message(Defs::MTI_STREAM_PROCEED,
+            StreamDefs::create_data_proceed(srcStreamId_, dstStreamId_));
+    }
+
+    /// Terminates the receive operation with an error, for example when the
+    /// source node reported a failure through a different channel.
+    /// @param error is the error code to report in result().
+    void cancel(int error)
+    {
+        if (result_ == OPERATION_PENDING)
+        {
+            result_ = error;
+            timer_.trigger();
+        }
+    }
+
+    /// Ends the stream early, for example because the received data could
+    /// not be stored. The source is sent a Stream Data Complete message, so
+    /// that it stops sending.
+    /// @param error is the error code to report in result().
+    void terminate(int error)
+    {
+        if (result_ != OPERATION_PENDING)
+        {
+            return;
+        }
+        if (isRegistered_ && isStarted_)
+        {
+            send_message(Defs::MTI_STREAM_COMPLETE,
+                StreamDefs::create_close_request(srcStreamId_, dstStreamId_));
+        }
+        unregister_handlers();
+        cancel(error);
+    }
+
+    /// @return true if the receive operation ended and the handlers are
+    /// unregistered.
+    bool is_done()
+    {
+        return is_terminated();
+    }
+
+    /// @return 0 if the stream completed successfully, OPERATION_PENDING if
+    /// it is still in progress, otherwise an error code.
+    int result()
+    {
+        return result_;
+    }
+
+    /// @return the window size granted to the sender.
+    uint16_t window_size()
+    {
+        return windowSize_;
+    }
+
+    /// @return number of data bytes received.
+    uint32_t total_bytes()
+    {
+        return totalBytes_;
+    }
+
+    /// Sets how long the stream may be idle before we give up.
+    /// @param timeout_nsec is the timeout in nanoseconds.
+    void set_timeout(long long timeout_nsec)
+    {
+        timeoutNsec_ = timeout_nsec;
+    }
+
+private:
+    /// Watchdog state: periodically checks that there is stream traffic.
+    Action wait_for_traffic()
+    {
+        lastProgress_ = progress_;
+        return sleep_and_call(&timer_, timeoutNsec_, STATE(check_traffic));
+    }
+
+    Action check_traffic()
+    {
+        if (result_ != OPERATION_PENDING)
+        {
+            // Completed or aborted.
+            return call_immediately(STATE(finish));
+        }
+        if (progress_ == lastProgress_)
+        {
+            LOG(INFO, "StreamReceiver: timeout. Received %u bytes.",
+                (unsigned)totalBytes_);
+            result_ = TIMEOUT;
+            return call_immediately(STATE(finish));
+        }
+        return call_immediately(STATE(wait_for_traffic));
+    }
+
+    Action finish()
+    {
+        unregister_handlers();
+        Notifiable *d = done_;
+        done_ = nullptr;
+        Action a = set_terminated();
+        if (d)
+        {
+            d->notify();
+        }
+        return a;
+    }
+
+    /// @return true if the message comes from the stream source and is
+    /// addressed to our node.
+    bool is_from_source(GenMessage *m)
+    {
+        return m->dstNode == node_ && iface()->matching_node(src_, m->src);
+    }
+
+    /// Handler for Stream Initiate Request messages.
+    void initiate_received(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (isStarted_ || !is_from_source(m) || payload.size() < 5 ||
+            (payload.size() >= 6 &&
+                (uint8_t)payload[5] != StreamDefs::INVALID_STREAM_ID &&
+                (uint8_t)payload[5] != dstStreamId_))
+        {
+            return message->unref();
+        }
+        uint16_t proposed = ((uint8_t)payload[0] << 8) | (uint8_t)payload[1];
+        srcStreamId_ = payload[4];
+        if (m->src.alias)
+        {
+            src_.alias = m->src.alias;
+        }
+        message->unref();
+        windowSize_ = std::min(proposed, maxWindow_);
+        windowRemaining_ = windowSize_;
+        isStarted_ = true;
+        ++progress_;
+        if (!windowSize_)
+        {
+            send_message(Defs::MTI_STREAM_INITIATE_REPLY,
+                StreamDefs::create_initiate_response(0, srcStreamId_,
+                    dstStreamId_, StreamDefs::FLAG_PERMANENT_ERROR,
+                    StreamDefs::REJECT_PERMANENT_INVALID_REQUEST));
+            cancel(Defs::ERROR_INVALID_ARGS);
+            return;
+        }
+        send_message(Defs::MTI_STREAM_INITIATE_REPLY,
+            StreamDefs::create_initiate_response(
+                windowSize_, srcStreamId_, dstStreamId_));
+    }
+
+    /// Handler for Stream Data messages.
+    void data_received(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (!isStarted_ || !is_from_source(m) || payload.empty() ||
+            (uint8_t)payload[0] != dstStreamId_)
+        {
+            return message->unref();
+        }
+        size_t len = payload.size() - 1;
+        target_->append(payload.data() + 1, len);
+        message->unref();
+        totalBytes_ += len;
+        ++progress_;
+        while (len)
+        {
+            if (len < windowRemaining_)
+            {
+                windowRemaining_ -= len;
+                break;
+            }
+            // Window full. A misbehaving sender might overrun the window; we
+            // do not enforce it, just count windows.
+            len -= windowRemaining_;
+            windowRemaining_ = windowSize_;
+            if (windowNotify_)
+            {
+                windowNotify_->notify();
+            }
+            else
+            {
+                proceed();
+            }
+        }
+    }
+
+    /// Handler for Stream Data Complete messages.
+    void complete_received(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (!isStarted_ || !is_from_source(m) || payload.size() < 2 ||
+            (uint8_t)payload[0] != srcStreamId_ ||
+            (uint8_t)payload[1] != dstStreamId_)
+        {
+            return message->unref();
+        }
+        int result = OPERATION_SUCCESS;
+        if (payload.size() >= 6)
+        {
+            uint32_t total = ((uint8_t)payload[2] << 24) |
+                ((uint8_t)payload[3] << 16) | ((uint8_t)payload[4] << 8) |
+                (uint8_t)payload[5];
+            if (total != totalBytes_)
+            {
+                LOG(WARNING,
+                    "StreamReceiver: sender reported %u bytes, received %u.",
+                    (unsigned)total, (unsigned)totalBytes_);
+                result = Defs::ERROR_TEMPORARY;
+            }
+        }
+        message->unref();
+        ++progress_;
+        unregister_handlers();
+        cancel(result);
+    }
+
+    /// Sends an addressed message to the stream source.
+    /// @param mti message type
+    /// @param payload message contents
+    void send_message(Defs::MTI mti, const Payload &payload)
+    {
+        auto *b = iface()->addressed_message_write_flow()->alloc();
+        b->data()->reset(mti, node_->node_id(), src_, payload);
+        iface()->addressed_message_write_flow()->send(b);
+    }
+
+    void register_handlers()
+    {
+        isRegistered_ = true;
+        iface()->dispatcher()->register_handler(&initiateHandler_,
+            Defs::MTI_STREAM_INITIATE_REQUEST, Defs::MTI_EXACT);
+        iface()->dispatcher()->register_handler(
+            &dataHandler_, Defs::MTI_STREAM_DATA, Defs::MTI_EXACT);
+        iface()->dispatcher()->register_handler(
+            &completeHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
+    }
+
+    void unregister_handlers()
+    {
+        if (!isRegistered_)
+        {
+            return;
+        }
+        isRegistered_ = false;
+        iface()->dispatcher()->unregister_handler(&initiateHandler_,
+            Defs::MTI_STREAM_INITIATE_REQUEST, Defs::MTI_EXACT);
+        iface()->dispatcher()->unregister_handler(
+            &dataHandler_, Defs::MTI_STREAM_DATA, Defs::MTI_EXACT);
+        iface()->dispatcher()->unregister_handler(
+            &completeHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
+    }
+
+    /// @return the interface we are receiving the stream on.
+    If *iface()
+    {
+        return static_cast<If *>(service());
+    }
+
+    /// Local node receiving the stream.
+    Node *node_{nullptr};
+    /// Source of the stream.
+    NodeHandle src_;
+    /// Where to append the incoming data.
+    std::string *target_{nullptr};
+    /// Whom to notify when the stream is done.
+    Notifiable *done_{nullptr};
+    /// If not null, notified after each full window (manual mode).
+    Notifiable *windowNotify_{nullptr};
+    /// How long the stream may be idle.
+    long long timeoutNsec_{SEC_TO_NSEC(3)};
+    /// Number of data bytes received.
+    uint32_t totalBytes_{0};
+    /// Incremented for every incoming stream message.
+    uint32_t progress_{0};
+    /// Value of progress_ when the watchdog last looked.
+    uint32_t lastProgress_{0};
+    /// Result of the receive operation.
+    int result_{OPERATION_SUCCESS};
+    /// Largest window we grant.
+    uint16_t maxWindow_{0};
+    /// Window granted to the sender.
+    uint16_t windowSize_{0};
+    /// Bytes still to arrive in the current window.
+    uint16_t windowRemaining_{0};
+    /// Sender's stream ID.
+    uint8_t srcStreamId_{StreamDefs::INVALID_STREAM_ID};
+    /// Our stream ID.
+    uint8_t dstStreamId_{StreamDefs::INVALID_STREAM_ID};
+    /// True after the initiate request was accepted.
+    bool isStarted_{false};
+    /// True while the message handlers are registered.
+    bool isRegistered_{false};
+    MessageHandler::GenericHandler initiateHandler_{
+        this, &StreamReceiver::initiate_received};
+    MessageHandler::GenericHandler dataHandler_{
+        this, &StreamReceiver::data_received};
+    MessageHandler::GenericHandler completeHandler_{
+        this, &StreamReceiver::complete_received};
+    StateFlowTimer timer_{this};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_STREAMRECEIVER_HXX_
@@ -0,0 +1,466 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file StreamSender.hxx
+ *
+ * Source side of the OpenLCB stream protocol.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _OPENLCB_STREAMSENDER_HXX_
+#define _OPENLCB_STREAMSENDER_HXX_
+
+#include "executor/StateFlow.hxx"
+#include "openlcb/If.hxx"
+#include "openlcb/StreamDefs.hxx"
+
+namespace openlcb
+{
+
+/// Opens an OpenLCB stream to a (remote or local) node and pushes data into
+/// it, respecting the window negotiated with the receiver: after each window
+/// worth of bytes the sender stops and waits for a Stream Data Proceed
+/// message.
+///
+/// Usage: call start_stream(), then any number of send_data(), then
+/// close_stream(). Each call takes a Notifiable that is called when the
+/// operation is complete; result() tells the outcome. Only one operation may
+/// be outstanding at any time, and all calls have to be made on the
+/// interface's executor.
+class StreamSender : public StateFlowBase
+{
+public:
+    /// Stream data messages carry at most this many bytes of data. This is a
+    /// multiple of 7 so that on CAN every frame is full.
+    static constexpr unsigned MAX_BYTES_PER_MESSAGE = 7 * 32;
+    static_assert(MAX_BYTES_PER_MESSAGE + 1 <= 255,
+        "The CAN interface renders stream data messages of up to 255 bytes.");
+
+    /// Result codes in addition to the ones in Defs::ErrorCodes.
+    enum ResultCodes
+    {
+        OPERATION_SUCCESS = 0,
+        OPERATION_PENDING = 0x20000,
+        /// Timeout waiting for the initiate reply or a proceed message.
+        TIMEOUT = Defs::ERROR_PERMANENT | Defs::OPENMRN_TIMEOUT,
+        /// The receiver ended the stream early.
+        TERMINATED_BY_RECEIVER = Defs::ERROR_PERMANENT,
+    };
+
+    /// Constructor. @param iface is the interface the stream will be sent on.
+    StreamSender(If *iface)
+        : StateFlowBase(iface)
+    {
+    }
+
+    ~StreamSender()
+    {
+        unregister_handlers();
+    }
+
+    /// Sends a Stream Initiate Request and waits for the reply.
+    /// @param node local node that is the source of the stream.
+    /// @param dst node to send the stream to.
+    /// @param src_stream_id stream ID assigned by us.
+    /// @param dst_stream_id suggested destination stream ID, or
+    /// StreamDefs::INVALID_STREAM_ID.
+    /// @param max_buffer_size largest window we would like to use.
+    /// @param done will be notified when the stream is open or the request
+    /// failed.
+    void start_stream(Node *node, NodeHandle dst, uint8_t src_stream_id,
+        uint8_t dst_stream_id, uint16_t max_buffer_size, Notifiable *done)
+    {
+        HASSERT(is_terminated() && !isOpen_);
+        node_ = node;
+        dst_ = dst;
+        srcStreamId_ = src_stream_id;
+        dstStreamId_ = dst_stream_id;
+        windowSize_ = max_buffer_size;
+        credit_ = 0;
+        totalBytes_ = 0;
+        replyArrived_ = false;
+        isTerminatedByReceiver_ = false;
+        done_ = done;
+        result_ = OPERATION_PENDING;
+        start_flow(STATE(send_initiate));
+    }
+
+    /// Sends data over an open stream. The data is not copied; it has to stay
+    /// alive until done is notified.
+    /// @param data bytes to send.
+    /// @param len number of bytes to send.
+    /// @param done will be notified when all bytes are handed over to the
+    /// interface, or when the receiver stopped granting window or ended the
+    /// stream.
+    void send_data(const void *data, size_t len, Notifiable *done)
+    {
+        HASSERT(is_terminated() && isOpen_);
+        data_ = static_cast<const uint8_t *>(data);
+        remaining_ = len;
+        done_ = done;
+        result_ = OPERATION_PENDING;
+        cancelResult_ = isTerminatedByReceiver_ ? TERMINATED_BY_RECEIVER : 0;
+        start_flow(STATE(send_next_chunk));
+    }
+
+    /// Stops the current send_data() operation, for example when the
+    /// receiver reported a failure through a different channel. The stream
+    /// stays open; the caller should close it.
+    /// @param error is the result to report for the send_data() operation.
+    void cancel(int error)
+    {
+        if (is_terminated() || !isOpen_)
+        {
+            return;
+        }
+        cancelResult_ = error;
+        if (sleeping_)
+        {
+            timer_.trigger();
+        }
+    }
+
+    /// Sends the Stream Data Complete message and releases the stream.
+    /// @param done will be notified when the message is sent.
+    void close_stream(Notifiable *done)
+    {
+        HASSERT(is_terminated() && isOpen_);
+        done_ = done;
+        result_ = OPERATION_PENDING;
+        start_flow(STATE(send_close));
+    }
+
+    /// @return the result of the last operation: 0 for success, otherwise an
+    /// error code.
+    int result()
+    {
+        return result_;
+    }
+
+    /// @return true if the stream is open for sending data.
+    bool is_open()
+    {
+        return isOpen_;
+    }
+
+    /// @return the window size agreed with the receiver.
+    uint16_t window_size()
+    {
+        return windowSize_;
+    }
+
+    /// @return the stream ID assigned by the receiver.
+    uint8_t dst_stream_id()
+    {
+        return dstStreamId_;
+    }
+
+    /// @return the number of data bytes sent since the stream was opened.
+    uint32_t total_bytes()
+    {
+        return totalBytes_;
+    }
+
+    /// Sets how long we wait for the initiate reply and for each proceed
+    /// message. @param timeout_nsec is the timeout in nanoseconds.
+    void set_timeout(long long timeout_nsec)
+    {
+        timeoutNsec_ = timeout_nsec;
+    }
+
+private:
+    Action send_initiate()
+    {
+        iface()->dispatcher()->register_handler(&initiateReplyHandler_,
+            Defs::MTI_STREAM_INITIATE_REPLY, Defs::MTI_EXACT);
+        return allocate_and_call(
+            iface()->addressed_message_write_flow(), STATE(fill_initiate));
+    }
+
+    Action fill_initiate()
+    {
+        auto *b = get_allocation_result(iface()->addressed_message_write_flow());
+        b->data()->reset(Defs::MTI_STREAM_INITIATE_REQUEST, node_->node_id(),
+            dst_,
+            StreamDefs::create_initiate_request(
+                windowSize_, false, srcStreamId_, dstStreamId_));
+        iface()->addressed_message_write_flow()->send(b);
+        sleeping_ = true;
+        return sleep_and_call(
+            &timer_, timeoutNsec_, STATE(initiate_reply_done));
+    }
+
+    /// Handler for incoming Stream Initiate Reply messages.
+    void initiate_replied(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (replyArrived_ || m->dstNode != node_ ||
+            !iface()->matching_node(dst_, m->src) || payload.size() < 6 ||
+            (uint8_t)payload[4] != srcStreamId_)
+        {
+            // Not for us.
+            return message->unref();
+        }
+        windowSize_ = ((uint8_t)payload[0] << 8) | (uint8_t)payload[1];
+        streamFlags_ = payload[2];
+        streamAdditionalFlags_ = payload[3];
+        dstStreamId_ = payload[5];
+        if (m->src.alias)
+        {
+            dst_.alias = m->src.alias;
+        }
+        replyArrived_ = true;
+        message->unref();
+        if (sleeping_)
+        {
+            timer_.trigger();
+        }
+    }
+
+    Action initiate_reply_done()
+    {
+        sleeping_ = false;
+        iface()->dispatcher()->unregister_handler(&initiateReplyHandler_,
+            Defs::MTI_STREAM_INITIATE_REPLY, Defs::MTI_EXACT);
+        if (!replyArrived_)
+        {
+            return return_with_result(TIMEOUT);
+        }
+        if (!(streamFlags_ & StreamDefs::FLAG_ACCEPT))
+        {
+            if (streamFlags_ & StreamDefs::FLAG_PERMANENT_ERROR)
+            {
+                return return_with_result(
+                    Defs::ERROR_PERMANENT | streamAdditionalFlags_);
+            }
+            return return_with_result(
+                Defs::ERROR_TEMPORARY | streamAdditionalFlags_);
+        }
+        if (!windowSize_)
+        {
+            // Accepted with zero buffer size; we cannot send anything.
+            return return_with_result(Defs::ERROR_INVALID_ARGS);
+        }
+        credit_ = windowSize_;
+        isOpen_ = true;
+        iface()->dispatcher()->register_handler(
+            &proceedHandler_, Defs::MTI_STREAM_PROCEED, Defs::MTI_EXACT);
+        iface()->dispatcher()->register_handler(
+            &completeHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
+        return return_with_result(OPERATION_SUCCESS);
+    }
+
+    Action send_next_chunk()
+    {
+        if (cancelResult_)
+        {
+            return return_with_result(cancelResult_);
+        }
+        if (!remaining_)
+        {
+            return return_with_result(OPERATION_SUCCESS);
+        }
+        if (!credit_)
+        {
+            sleeping_ = true;
+            return sleep_and_call(
+                &timer_, timeoutNsec_, STATE(proceed_wait_done));
+        }
+        return allocate_and_call(
+            iface()->addressed_message_write_flow(), STATE(fill_data));
+    }
+
+    Action fill_data()
+    {
+        auto *b = get_allocation_result(iface()->addressed_message_write_flow());
+        size_t len = std::min(remaining_, (size_t)MAX_BYTES_PER_MESSAGE);
+        len = std::min(len, (size_t)credit_);
+        b->data()->reset(
+            Defs::MTI_STREAM_DATA, node_->node_id(), dst_, EMPTY_PAYLOAD);
+        MessagePayload &p = b->data()->payload;
+        p.reserve(len + 1);
+        p.push_back(dstStreamId_);
+        p.append((const char *)data_, len);
+        iface()->addressed_message_write_flow()->send(b);
+        data_ += len;
+        remaining_ -= len;
+        credit_ -= len;
+        totalBytes_ += len;
+        return call_immediately(STATE(send_next_chunk));
+    }
+
+    /// Handler for incoming Stream Data Proceed messages.
+    void proceed_received(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (m->dstNode != node_ || !iface()->matching_node(dst_, m->src) ||
+            payload.size() < 2 || (uint8_t)payload[0] != srcStreamId_ ||
+            (uint8_t)payload[1] != dstStreamId_)
+        {
+            return message->unref();
+        }
+        message->unref();
+        credit_ += windowSize_;
+        if (sleeping_)
+        {
+            timer_.trigger();
+        }
+    }
+
+    /// Handler for Stream Data Complete messages, which the receiver sends
+    /// when it ends the stream early.
+    void complete_received(Buffer<GenMessage> *message)
+    {
+        auto *m = message->data();
+        const auto &payload = m->payload;
+        if (m->dstNode != node_ || !iface()->matching_node(dst_, m->src) ||
+            payload.size() < 2 || (uint8_t)payload[0] != srcStreamId_ ||
+            (uint8_t)payload[1] != dstStreamId_)
+        {
+            return message->unref();
+        }
+        message->unref();
+        isTerminatedByReceiver_ = true;
+        cancel(TERMINATED_BY_RECEIVER);
+    }
+
+    Action proceed_wait_done()
+    {
+        sleeping_ = false;
+        if (!credit_ && !cancelResult_)
+        {
+            // The stream stays open; the caller should close it.
+            return return_with_result(TIMEOUT);
+        }
+        return call_immediately(STATE(send_next_chunk));
+    }
+
+    Action send_close()
+    {
+        unregister_handlers();
+        return allocate_and_call(
+            iface()->addressed_message_write_flow(), STATE(fill_close));
+    }
+
+    Action fill_close()
+    {
+        auto *b = get_allocation_result(iface()->addressed_message_write_flow());
+        b->data()->reset(Defs::MTI_STREAM_COMPLETE, node_->node_id(), dst_,
+            StreamDefs::create_close_request(
+                srcStreamId_, dstStreamId_, totalBytes_));
+        iface()->addressed_message_write_flow()->send(b);
+        return return_with_result(OPERATION_SUCCESS);
+    }
+
+    /// Terminates the current operation and notifies the caller.
+    /// @param result is the result code to report.
+    Action return_with_result(int result)
+    {
+        result_ = result;
+        Notifiable *d = done_;
+        done_ = nullptr;
+        Action a = set_terminated();
+        if (d)
+        {
+            d->notify();
+        }
+        return a;
+    }
+
+    /// Removes all message handlers that we might have registered.
+    void unregister_handlers()
+    {
+        if (isOpen_)
+        {
+            isOpen_ = false;
+            iface()->dispatcher()->unregister_handler(
+                &proceedHandler_, Defs::MTI_STREAM_PROCEED, Defs::MTI_EXACT);
+            iface()->dispatcher()->unregister_handler(
+                &completeHandler_, Defs::MTI_STREAM_COMPLETE, Defs::MTI_EXACT);
+        }
+    }
+
+    /// @return the interface we are sending the stream on.
+    If *iface()
+    {
+        return static_cast<If *>(service());
+    }
+
+    /// Local node sending the stream.
+    Node *node_{nullptr};
+    /// Receiver of the stream.
+    NodeHandle dst_;
+    /// Pointer to the next byte to send.
+    const uint8_t *data_{nullptr};
+    /// How many bytes are left from the current send_data() call.
+    size_t remaining_{0};
+    /// Whom to notify when the current operation is done.
+    Notifiable *done_{nullptr};
+    /// How long to wait for replies and proceed messages.
+    long long timeoutNsec_{SEC_TO_NSEC(3)};
+    /// Total number of data bytes sent.
+    uint32_t totalBytes_{0};
+    /// How many more bytes we may send before a proceed message is needed.
+    uint32_t credit_{0};
+    /// Result of the last operation.
+    int result_{OPERATION_SUCCESS};
+    /// Non-zero if the current send_data() was cancelled with this error.
+    int cancelResult_{0};
+    /// Negotiated window size.
+    uint16_t windowSize_{0};
+    /// Our stream ID.
+    uint8_t srcStreamId_{StreamDefs::INVALID_STREAM_ID};
+    /// Receiver's stream ID.
+    uint8_t dstStreamId_{StreamDefs::INVALID_STREAM_ID};
+    /// Flags from the initiate reply.
+    uint8_t streamFlags_{0};
+    /// Additional flags (reject reason) from the initiate reply.
+    uint8_t streamAdditionalFlags_{0};
+    /// True when the initiate reply has arrived.
+    bool replyArrived_{false};
+    /// True while we are sleeping on the timer waiting for a message.
+    bool sleeping_{false};
+    /// True while the stream is open and the proceed and complete handlers
+    /// are registered.
+    bool isOpen_{false};
+    /// True if the receiver has ended the stream.
+    bool isTerminatedByReceiver_{false};
+    MessageHandler::GenericHandler initiateReplyHandler_{
+        this, &StreamSender::initiate_replied};
+    MessageHandler::GenericHandler proceedHandler_{
+        this, &StreamSender::proceed_received};
+    MessageHandler::GenericHandler completeHandler_{
+        this, &StreamSender::complete_received};
+    StateFlowTimer timer_{this};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_STREAMSENDER_HXX_
@@ -351,7 +351,7 @@ struct TractionDefs {
      * @returns true if the last_set_speed value was present and non-NaN.
      * @param p is the response payload.
      * @param v is the velocity that will be set to the speed value. */
-    static bool speed_get_parse_last(const Payload &p, Velocity *v)
+    static bool speed_get_parse_last(const MessagePayload &p, Velocity *v)
     {
         if (p.size() < 3)
         {
@@ -391,7 +391,7 @@ struct TractionDefs {
      * @param value will be set to the output value.
      * @param address will be set to the function address. */
     static bool fn_get_parse(
-        const Payload &p, uint16_t *value, unsigned *address)
+        const MessagePayload &p, uint16_t *value, unsigned *address)
     {
         if (p.size() < 6)
         {
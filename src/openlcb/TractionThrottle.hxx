@@ -482,7 +482,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const MessagePayload &payload = handler_.response()->data()->payload;
         if (payload.size() < 3)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS);
@@ -573,7 +573,7 @@ private:
         {
             return;
         }
-        const Payload &p = msg->data()->payload;
+        const MessagePayload &p = msg->data()->payload;
         if (p.size() < 1)
             return;
         switch (p[0])
@@ -631,7 +631,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const MessagePayload &payload = handler_.response()->data()->payload;
         if (payload.size() < 9)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS);
@@ -688,7 +688,7 @@ private:
         }
 
         AutoReleaseBuffer<GenMessage> rb(handler_.response());
-        const string &payload = handler_.response()->data()->payload;
+        const MessagePayload &payload = handler_.response()->data()->payload;
         if (payload.size() < 3)
         {
             return return_with_error(Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
@@ -719,7 +719,7 @@ private:
         {
             return;
         }
-        const Payload &p = msg->data()->payload;
+        const MessagePayload &p = msg->data()->payload;
         if (p.size() < 1)
             return;
         switch (p[0])
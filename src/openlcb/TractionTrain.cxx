@@ -230,14 +230,14 @@ struct TrainService::Impl
 
         Action handle_query()
         {
-            Payload *p = initialize_response();
+            MessagePayload *p = initialize_response();
             uint8_t cmd = payload()[0];
             switch (cmd)
             {
                 case TractionDefs::REQ_QUERY_SPEED:
                 {
                     p->resize(8);
-                    uint8_t *d = reinterpret_cast<uint8_t *>(&(*p)[0]);
+                    uint8_t *d = reinterpret_cast<uint8_t *>(p->mutable_data());
                     d[0] = TractionDefs::RESP_QUERY_SPEED;
                     speed_to_fp16(train_node()->train()->get_speed(), d + 1);
                     d[3] = 0; // status byte: reserved.
@@ -250,7 +250,7 @@ struct TrainService::Impl
                 case TractionDefs::REQ_QUERY_FN:
                 {
                     p->resize(6);
-                    uint8_t *d = reinterpret_cast<uint8_t *>(&(*p)[0]);
+                    uint8_t *d = reinterpret_cast<uint8_t *>(p->mutable_data());
                     d[0] = TractionDefs::RESP_QUERY_FN;
                     d[1] = payload()[1];
                     d[2] = payload()[2];
@@ -271,15 +271,16 @@ struct TrainService::Impl
 
         Action handle_controller_config()
         {
-            Payload &p = *initialize_response();
+            MessagePayload &p = *initialize_response();
             uint8_t subcmd = payload()[1];
             switch (subcmd)
             {
                 case TractionDefs::CTRLREQ_ASSIGN_CONTROLLER:
                 {
                     p.resize(3);
-                    p[0] = TractionDefs::RESP_CONTROLLER_CONFIG;
-                    p[1] = TractionDefs::CTRLRESP_ASSIGN_CONTROLLER;
+                    char *d = p.mutable_data();
+                    d[0] = TractionDefs::RESP_CONTROLLER_CONFIG;
+                    d[1] = TractionDefs::CTRLRESP_ASSIGN_CONTROLLER;
                     NodeHandle supplied_controller = {0, 0};
                     if (size() < 9)
                         return reject_permanent();
@@ -300,11 +301,11 @@ struct TrainService::Impl
                     {
                         /** @TODO (balazs.racz): we need to implement stealing
                          * a train from the existing controller. */
-                        p[2] = TractionDefs::CTRLRESP_ASSIGN_ERROR_CONTROLLER;
+                        d[2] = TractionDefs::CTRLRESP_ASSIGN_ERROR_CONTROLLER;
                         return send_response();
                     }
                     train_node()->set_controller(supplied_controller);
-                    p[2] = 0;
+                    d[2] = 0;
                     return send_response();
                 }
                 case TractionDefs::CTRLREQ_QUERY_CONTROLLER:
@@ -312,13 +313,14 @@ struct TrainService::Impl
                     NodeHandle h = train_node()->get_controller();
                     p.reserve(11);
                     p.resize(9);
-                    p[0] = TractionDefs::RESP_CONTROLLER_CONFIG;
-                    p[1] = TractionDefs::CTRLRESP_QUERY_CONTROLLER;
-                    p[2] = 0;
-                    node_id_to_data(h.id, &p[3]);
+                    char *d = p.mutable_data();
+                    d[0] = TractionDefs::RESP_CONTROLLER_CONFIG;
+                    d[1] = TractionDefs::CTRLRESP_QUERY_CONTROLLER;
+                    d[2] = 0;
+                    node_id_to_data(h.id, d + 3);
                     if (h.alias)
                     {
-                        p[2] |= 1;
+                        d[2] |= 1;
                         p.push_back(h.alias >> 8);
                         p.push_back(h.alias & 0xff);
                     }
@@ -461,7 +463,7 @@ struct TrainService::Impl
                 b->data()->dst = NodeHandle(dst);
                 b->data()->dstNode = nullptr;
                 if (flip_speed) {
-                    b->data()->payload[1] ^= 0x80;
+                    b->data()->payload.mutable_data()[1] ^= 0x80;
                 }
                 iface()->addressed_message_write_flow()->send(b);
                 return exit();
@@ -491,7 +493,7 @@ struct TrainService::Impl
                              NodeHandle(dst), message()->data()->payload);
             if ((payload()[0] == TractionDefs::REQ_SET_SPEED) &&
                 (flags & TractionDefs::CNSTFLAGS_REVERSE)) {
-                b->data()->payload[1] ^= 0x80;
+                b->data()->payload.mutable_data()[1] ^= 0x80;
             }
             iface()->addressed_message_write_flow()->send(b);
             ++nextConsistIndex_;
@@ -500,7 +502,7 @@ struct TrainService::Impl
 
         Action handle_traction_mgmt()
         {
-            Payload &p = *initialize_response();
+            MessagePayload &p = *initialize_response();
             uint8_t cmd = payload()[1];
             switch (cmd)
             {
@@ -537,7 +539,7 @@ struct TrainService::Impl
          * flow) and fills in src, dest as a response message for traction
          * protocol. The caller only needs to provide the payload.
          */
-        Payload *initialize_response()
+        MessagePayload *initialize_response()
         {
             ensure_response_exists();
             response_->data()->reset(Defs::MTI_TRACTION_CONTROL_REPLY,
@@ -33,6 +33,29 @@
 
 #include "utils/constants.hxx"
 
+/** Maximum number of queued event messages processed by the event service
+ * without yielding to the executor. */
+DEFAULT_CONST(event_service_batch_size, 8);
+
+/** Number of frames queued per port in the GcCanRoutingHub before normal and
+ * low priority frames get dropped. */
+DEFAULT_CONST(routing_hub_port_queue_depth, 64);
+
+/** Quiet time after event identification in the GcCanRoutingHub before event
+ * reports get filtered. */
+DEFAULT_CONST(routing_hub_event_settle_msec, 500);
+
+/** Maximum number of aliases checked at the same time by the alias
+ * allocator. */
+DEFAULT_CONST(alias_allocator_batch_size, 8);
+
+/** Number of aliases reserved at startup by a SimpleCanStack. */
+DEFAULT_CONST(reserved_alias_pool_size, 1);
+
+/** Low-water mark of the reserved alias pool; 0 disables holding back
+ * reallocations. */
+DEFAULT_CONST(reserved_alias_low_water, 0);
+
 /** Number of entries in the remote alias cache */
 DEFAULT_CONST(remote_alias_cache_size, 10);
 
@@ -54,6 +77,11 @@ DEFAULT_CONST(num_datagram_clients, 2);
  * datagram handler. */
 DEFAULT_CONST(num_memory_spaces, 5);
 
+/** Window size in bytes for memory config reads and writes using streams. The
+ * memory config server allocates a buffer of this size while a stream
+ * transfer is in progress. */
+DEFAULT_CONST(memory_config_stream_window, 1024);
+
 /** Set to CONSTANT_TRUE if you want to export an "all memory" memory space
  * from the SimpleStack. Note that this should not be enabled in production,
  * because there is no protection against segfaults in it. */
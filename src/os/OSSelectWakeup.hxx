@@ -48,6 +48,10 @@
 #include <signal.h>
 #endif
 
+#if OPENMRN_HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef __WINNT__
 #include <winsock2.h>
 #elif OPENMRN_HAVE_SELECT
@@ -110,6 +114,17 @@ public:
     void wakeup()
     {
         bool need_wakeup = false;
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+        // If a wakeup is already pending, the select thread has either been
+        // signaled, or will see the flag before it goes to sleep. Either way
+        // it will look at everything we did before this call.
+        if (__atomic_load_n(&pendingWakeup_, __ATOMIC_SEQ_CST))
+        {
+            return;
+        }
+        __atomic_store_n(&pendingWakeup_, true, __ATOMIC_SEQ_CST);
+        need_wakeup = __atomic_load_n(&inSelect_, __ATOMIC_SEQ_CST);
+#else
         {
             AtomicHolder l(this);
             pendingWakeup_ = true;
@@ -118,6 +133,7 @@ public:
                 need_wakeup = true;
             }
         }
+#endif
         if (need_wakeup)
         {
 #if OPENMRN_FEATURE_DEVICE_SELECT
@@ -174,6 +190,12 @@ public:
     int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
         long long deadline_nsec)
     {
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+        if (enter_select())
+        {
+            deadline_nsec = 0;
+        }
+#else
         {
             AtomicHolder l(this);
             inSelect_ = true;
@@ -188,6 +210,7 @@ public:
 #endif
             }
         }
+#endif
 #if OPENMRN_FEATURE_DEVICE_SELECT
         int ret =
             Device::select(nfds, readfds, writefds, exceptfds, deadline_nsec);
@@ -223,15 +246,72 @@ public:
 #elif !defined(OPENMRN_FEATURE_SINGLE_THREADED)
         #error no select implementation in multi threaded OS.
 #endif
+        exit_select();
+        return ret;
+    }
+
+#if OPENMRN_HAVE_EPOLL
+    /** Portable call to an epoll_wait that can be woken up asynchronously from
+     * a different thread. The wakeup semantics are the same as in select().
+     *
+     * @param epfd is the epoll file descriptor.
+     * @param events is as a regular ::epoll_wait call.
+     * @param maxevents is as a regular ::epoll_wait call.
+     * @param deadline_nsec is the maximum time to sleep if no fd activity and
+     * no wakeup happens. -1 to sleep indefinitely, 0 to return immediately.
+     * Rounded up to the next millisecond.
+     *
+     * @return what epoll_wait would return (number of ready events, 0 in case
+     * of timeout), or -1 and errno==EINTR if the call was woken up
+     * asynchronously
+     */
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+        long long deadline_nsec)
+    {
+        if (enter_select())
         {
-            AtomicHolder l(this);
-            pendingWakeup_ = false;
-            inSelect_ = false;
+            deadline_nsec = 0;
+        }
+        int timeout_msec = -1;
+        if (deadline_nsec >= 0)
+        {
+            timeout_msec = (deadline_nsec + 999999) / 1000000;
         }
+        int ret =
+            ::epoll_pwait(epfd, events, maxevents, timeout_msec, &origMask_);
+        exit_select();
         return ret;
     }
+#endif
 
 private:
+    /// Marks that the select thread is about to go to sleep. @return true if
+    /// there is a pending wakeup, i.e. the sleep should not block.
+    bool enter_select()
+    {
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+        __atomic_store_n(&inSelect_, true, __ATOMIC_SEQ_CST);
+        return __atomic_load_n(&pendingWakeup_, __ATOMIC_SEQ_CST);
+#else
+        AtomicHolder l(this);
+        inSelect_ = true;
+        return pendingWakeup_;
+#endif
+    }
+
+    /// Marks that the select thread has woken up.
+    void exit_select()
+    {
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+        __atomic_store_n(&pendingWakeup_, false, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&inSelect_, false, __ATOMIC_SEQ_CST);
+#else
+        AtomicHolder l(this);
+        pendingWakeup_ = false;
+        inSelect_ = false;
+#endif
+    }
+
 #ifdef ESP32
     void esp_allocate_vfs_fd();
     void esp_deallocate_vfs_fd();
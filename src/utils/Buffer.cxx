@@ -33,12 +33,22 @@
 
 #include "utils/Buffer.hxx"
 
+#include "nmranet_config.h"
+#include "utils/SlabPool.hxx"
+
 DynamicPool *mainBufferPool = nullptr;
 
 Pool* init_main_buffer_pool()
 {
     if (!mainBufferPool)
     {
+#if OPENMRN_FEATURE_SLAB_POOL
+        if (config_main_buffer_pool_use_slab() == CONSTANT_TRUE)
+        {
+            mainBufferPool = new SlabPool();
+            return mainBufferPool;
+        }
+#endif
         mainBufferPool = new DynamicPool(
             Bucket::init(16, 32, 48, LARGEST_BUFFERPOOL_BUCKET, 0));
     }
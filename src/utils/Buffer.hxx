@@ -58,6 +58,7 @@ class LimitedPool;
 class Pool;
 template <class T> class Buffer;
 class BufferBase;
+class RawBuffer;
 
 namespace openlcb
 {
@@ -177,6 +178,9 @@ protected:
     /** Allow FixedPool access to our constructor */
     friend class FixedPool;
 
+    /** Allow SlabPool access to our constructor */
+    friend class SlabPool;
+
     /** Allow LimitedPool access to our fields */
     friend class LimitedPool;
 
@@ -266,6 +270,59 @@ template<typename T> BufferPtr<T> get_buffer_deleter(Buffer<T>* b) {
     return BufferPtr<T>(b);
 }
 
+/// Buffer with a variable number of raw bytes as payload, for data whose
+/// length is only known at runtime. The bytes are allocated from the pool
+/// together with the buffer header. The reference count is maintained
+/// atomically, so a RawBuffer may be shared between flows running on
+/// different threads.
+class RawBuffer : public BufferBase
+{
+public:
+    /// Allocates a new raw buffer synchronously.
+    /// @param pool is the pool to allocate from.
+    /// @param capacity is the minimum number of bytes needed.
+    /// @return the new buffer with a reference count of 1.
+    static inline RawBuffer *alloc(Pool *pool, size_t capacity);
+
+    /// Adds another reference to the buffer. @return this.
+    RawBuffer *ref()
+    {
+        __atomic_add_fetch(&count_, 1, __ATOMIC_RELAXED);
+        return this;
+    }
+
+    /// Removes a reference; frees the buffer when the last reference is gone.
+    inline void unref();
+
+    /// @return true if there is more than one reference to this buffer.
+    bool is_shared()
+    {
+        return __atomic_load_n(&count_, __ATOMIC_ACQUIRE) > 1;
+    }
+
+    /// @return the number of bytes available in this buffer.
+    size_t capacity()
+    {
+        return size_ - sizeof(RawBuffer);
+    }
+
+    /// @return pointer to the first byte of the buffer.
+    char *data()
+    {
+        return reinterpret_cast<char *>(this + 1);
+    }
+
+private:
+    /// Constructor. @param size is the total size of the allocation including
+    /// this header. @param pool is where the memory came from.
+    RawBuffer(size_t size, Pool *pool)
+        : BufferBase(size, pool)
+    {
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RawBuffer);
+};
+
 /** Pool of previously allocated, but currently unused, items. */
 class Pool
 {
@@ -367,6 +424,8 @@ private:
 
     /** Allow Buffer to access this class */
     template <class T> friend class Buffer;
+    /** Allow RawBuffer to access this class */
+    friend class RawBuffer;
 
     DISALLOW_COPY_AND_ASSIGN(Pool);
 };
@@ -643,4 +702,23 @@ template <class T> void Buffer<T>::unref()
     }
 }
 
+RawBuffer *RawBuffer::alloc(Pool *pool, size_t capacity)
+{
+    size_t size = sizeof(RawBuffer) + capacity;
+    HASSERT(size <= UINT16_MAX);
+    RawBuffer *result =
+        static_cast<RawBuffer *>(pool->alloc_untyped(size, nullptr));
+    new (result) RawBuffer(size, pool);
+    return result;
+}
+
+void RawBuffer::unref()
+{
+    if (__atomic_sub_fetch(&count_, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        this->~RawBuffer();
+        pool_->free(this);
+    }
+}
+
 #endif /* _UTILS_BUFFER_HXX_ */
@@ -32,10 +32,12 @@
  * @date 26 May 2016
  */
 
+#include <string.h>
 #include <string>
 
 #include "utils/GcStreamParser.hxx"
 #include "utils/gc_format.h"
+#include "can_frame.h"
 
 bool GcStreamParser::consume_byte(char c)
 {
@@ -87,3 +89,61 @@ bool GcStreamParser::parse_frame_to_output(struct can_frame* output_frame) {
     int ret = gc_format_parse(cbuf_, output_frame);
     return (ret == 0);
 }
+
+size_t GcStreamParser::parse_buffer(const char *data, size_t len,
+    struct can_frame *frames, size_t max_frames, size_t *num_frames)
+{
+    const char *p = data;
+    const char *end = data + len;
+    size_t n = 0;
+    while (p < end && n < max_frames)
+    {
+        if (offset_ >= 0)
+        {
+            // In the middle of a packet that started in an earlier block, or
+            // one that does not fit the fast path.
+            if (consume_byte(*p++) && parse_frame_to_output(frames + n))
+            {
+                ++n;
+            }
+            continue;
+        }
+        const char *start = (const char *)memchr(p, ':', end - p);
+        if (!start)
+        {
+            // Drop bytes to the floor -- we're not in a packet.
+            p = end;
+            break;
+        }
+        const char *body = start + 1;
+        size_t window = end - body;
+        if (window > sizeof(cbuf_) - 1)
+        {
+            window = sizeof(cbuf_) - 1;
+        }
+        const char *term = (const char *)memchr(body, ';', window);
+        const char *restart = (const char *)memchr(
+            body, ':', term ? term - body : window);
+        if (restart)
+        {
+            // A new packet starts before this one ended.
+            p = restart;
+            continue;
+        }
+        if (!term)
+        {
+            // Packet continues in the next block, or is too long. The byte by
+            // byte path sorts this out.
+            p = start;
+            consume_byte(*p++);
+            continue;
+        }
+        if (gc_format_parse_packet(body, term - body, frames + n) == 0)
+        {
+            ++n;
+        }
+        p = term + 1;
+    }
+    *num_frames = n;
+    return p - data;
+}
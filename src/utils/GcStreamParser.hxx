@@ -35,6 +35,7 @@
 #ifndef _UTILS_GCSTREAMPARSER_HXX_
 #define _UTILS_GCSTREAMPARSER_HXX_
 
+#include <stddef.h>
 #include <string>
 
 /**
@@ -69,6 +70,22 @@ public:
     /** @param payload fills with the current contents of the frame buffer. */
     void frame_buffer(std::string *payload);
 
+    /** Parses a block of characters from the source stream into CAN
+     * frames. Has the same effect as calling consume_byte() and
+     * parse_frame_to_output() for each character, but packets that are
+     * entirely within the block are parsed in place. Packets with a format
+     * error are dropped.
+     *
+     * @param data is the next characters from the source stream.
+     * @param len is the number of characters in data.
+     * @param frames is the output array.
+     * @param max_frames is the size of the output array.
+     * @param num_frames will be set to the number of frames written.
+     * @return the number of characters consumed. Less than len only if the
+     * output array got full. */
+    size_t parse_buffer(const char *data, size_t len,
+        struct can_frame *frames, size_t max_frames, size_t *num_frames);
+
 private:
     /// Collects data from a partial GC packet.
     char cbuf_[32];
@@ -42,7 +42,8 @@ void GcTcpHub::OnNewConnection(int fd)
 {
     const bool use_select =
         (config_gridconnect_tcp_use_select() == CONSTANT_TRUE);
-    create_gc_port_for_can_hub(canHub_, fd, nullptr, use_select);
+    __atomic_add_fetch(&numClients_, 1, __ATOMIC_ACQ_REL);
+    create_gc_port_for_can_hub(canHub_, fd, &clientExit_, use_select);
 }
 
 GcTcpHub::GcTcpHub(CanHubFlow *can_hub, int port)
@@ -60,6 +60,12 @@ public:
         return tcpListener_.is_started();
     }
 
+    /// @return the number of clients currently connected.
+    unsigned get_num_clients()
+    {
+        return __atomic_load_n(&numClients_, __ATOMIC_ACQUIRE);
+    }
+
 private:
     /// Callback when a new connection arrives.
     ///
@@ -67,9 +73,33 @@ private:
     ///
     void OnNewConnection(int fd);
 
+    /// Called when a client connection is closed.
+    class ClientExitNotify : public Notifiable
+    {
+    public:
+        /// Constructor. @param parent the hub owning the clients.
+        ClientExitNotify(GcTcpHub *parent)
+            : parent_(parent)
+        {
+        }
+
+        void notify() override
+        {
+            __atomic_sub_fetch(&parent_->numClients_, 1, __ATOMIC_ACQ_REL);
+        }
+
+    private:
+        /// Hub owning the clients.
+        GcTcpHub *parent_;
+    };
+
     /// @param can_hub Which CAN-hub should we attach the TCP gridconnect hub
     /// onto.
     CanHubFlow *canHub_;
+    /// Number of clients currently connected.
+    unsigned numClients_ {0};
+    /// Gets notified when a client is gone.
+    ClientExitNotify clientExit_ {this};
     /// Helper object representing the listening on the socket.
     SocketListener tcpListener_;
 };
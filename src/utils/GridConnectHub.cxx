@@ -40,6 +40,7 @@
 #include "nmranet_config.h"
 #include "utils/Buffer.hxx"
 #include "utils/BufferPort.hxx"
+#include "utils/Atomic.hxx"
 #include "utils/HubDevice.hxx"
 #ifdef OPENMRN_FEATURE_EXECUTOR_SELECT
 #include "utils/HubDeviceSelect.hxx"
@@ -48,6 +49,248 @@
 #include "utils/GcStreamParser.hxx"
 #include "utils/gc_format.h"
 
+/// Gridconnect rendering of one CAN frame, as delivered by a GcRenderFanout
+/// to one gridconnect port. The text itself is shared by all ports that see
+/// the frame; each port's buffer holds one reference to it.
+struct GcTextData
+{
+    GcTextData()
+    {
+    }
+
+    GcTextData(const GcTextData &) = delete;
+    GcTextData &operator=(const GcTextData &) = delete;
+
+    ~GcTextData()
+    {
+        if (text)
+        {
+            text->unref();
+        }
+    }
+
+    /// Rendered text (NUL-terminated). We own one reference.
+    RawBuffer *text {nullptr};
+    /// Number of characters in text, not counting the terminating NUL.
+    unsigned len {0};
+    /// skipMember_ of the frame the text was rendered from.
+    CanHubPortInterface *source {nullptr};
+};
+
+/// Interface of a port that receives rendered frames from a GcRenderFanout.
+typedef FlowInterface<Buffer<GcTextData>> GcTextPortInterface;
+
+/// Renders the frames of a CAN hub to gridconnect text on behalf of all the
+/// gridconnect ports (and packet printers) attached to that hub. There is one
+/// fanout per CAN hub, registered as a single port on the hub. It renders
+/// every frame at most once per format, on the hub's executor, and hands each
+/// attached port a small buffer referencing the shared text. The per-frame
+/// formatting cost thus does not grow with the number of ports.
+class GcRenderFanout : public CanHubPortInterface, private Atomic
+{
+public:
+    /// One port attached to the fanout of a CAN hub. Attaches in the
+    /// constructor and detaches in detach() or the destructor.
+    ///
+    /// This object is also the identity of the port on the CAN hub: frames
+    /// coming from the port have to carry this object in skipMember_, which
+    /// keeps the fanout from echoing them back to the same port.
+    class Member : public CanHubPortInterface
+    {
+    public:
+        /// Constructor.
+        ///
+        /// @param can_hub which CAN hub's frames to receive.
+        /// @param port where to deliver the rendered frames. Will be called
+        /// on the executor of can_hub.
+        /// @param double_bytes if true, each byte of the rendered text will
+        /// be doubled.
+        Member(CanHubFlow *can_hub, GcTextPortInterface *port,
+            bool double_bytes)
+            : port_(port)
+            , doubleBytes_(double_bytes ? 1 : 0)
+        {
+            fanout_ = GcRenderFanout::attach(can_hub, this);
+        }
+
+        ~Member()
+        {
+            detach();
+        }
+
+        /// Stops delivering frames to the port. Frames already sent to the
+        /// port are not affected. Idempotent.
+        void detach()
+        {
+            if (fanout_)
+            {
+                fanout_->remove(this);
+                fanout_ = nullptr;
+            }
+        }
+
+        /// Frames are delivered through the fanout; this object only stands
+        /// for the port in skipMember_ and is never registered on a hub.
+        void send(Buffer<CanHubData> *message, unsigned priority) OVERRIDE
+        {
+            DIE("GcRenderFanout::Member is not a hub port.");
+        }
+
+    private:
+        friend class GcRenderFanout;
+
+        /// Where to deliver the rendered frames.
+        GcTextPortInterface *port_;
+        /// Which fanout we are attached to, or nullptr after detach().
+        GcRenderFanout *fanout_;
+        /// 1 if the port wants the doubled format.
+        unsigned doubleBytes_ : 1;
+    };
+
+    /// Renders a frame and delivers it to all attached ports except the one
+    /// it came from. Called by the CAN hub on the hub's executor.
+    ///
+    /// @param message CAN frame buffer.
+    /// @param priority priority to deliver the rendered text with.
+    void send(Buffer<CanHubData> *message, unsigned priority) OVERRIDE
+    {
+        AutoReleaseBuffer<CanHubData> b(message);
+        // Shared renderings, indexed by the double_bytes flag.
+        RawBuffer *text[2] = {nullptr, nullptr};
+        unsigned len[2] = {0, 0};
+        {
+            AtomicHolder h(this);
+            for (Member *m : members_)
+            {
+                if (m == message->data()->skipMember_)
+                {
+                    continue;
+                }
+                unsigned f = m->doubleBytes_;
+                if (!text[f])
+                {
+                    text[f] = RawBuffer::alloc(mainBufferPool, TEXT_SIZE);
+                    char *end = gc_format_generate(
+                        message->data(), text[f]->data(), f);
+                    *end = 0;
+                    len[f] = end - text[f]->data();
+                }
+                if (!len[f])
+                {
+                    LOG(INFO, "gc generate failed.");
+                    continue;
+                }
+                Buffer<GcTextData> *out;
+                /// @todo(balazs.racz) switch to asynchronous allocation here.
+                mainBufferPool->alloc(&out);
+                out->data()->text = text[f]->ref();
+                out->data()->len = len[f];
+                out->data()->source = message->data()->skipMember_;
+                out->set_done(message->new_child());
+                m->port_->send(out, priority);
+            }
+        }
+        for (RawBuffer *t : text)
+        {
+            if (t)
+            {
+                t->unref();
+            }
+        }
+    }
+
+private:
+    /// Bytes needed to render any frame, in either format, with the
+    /// terminating NUL.
+    static constexpr unsigned TEXT_SIZE = 2 * GC_FORMAT_MAX_FRAME_LENGTH + 1;
+
+    /// Constructor. @param hub the CAN hub to render the frames of.
+    GcRenderFanout(CanHubFlow *hub)
+        : hub_(hub)
+    {
+        hub_->register_port(this);
+    }
+
+    /// Attaches a port to the fanout of a CAN hub, creating the fanout if
+    /// needed.
+    ///
+    /// @param hub the CAN hub.
+    /// @param member the port to attach.
+    /// @return the fanout the port was attached to.
+    static GcRenderFanout *attach(CanHubFlow *hub, Member *member)
+    {
+        AtomicHolder h(&registryLock_);
+        GcRenderFanout *f = head_;
+        while (f && f->hub_ != hub)
+        {
+            f = f->next_;
+        }
+        if (!f)
+        {
+            f = new GcRenderFanout(hub);
+            f->next_ = head_;
+            head_ = f;
+        }
+        AtomicHolder l(f);
+        f->members_.push_back(member);
+        return f;
+    }
+
+    /// Detaches a port. When the last port is gone, the fanout unregisters
+    /// from the hub and gets deleted.
+    ///
+    /// @param member the port to detach.
+    void remove(Member *member)
+    {
+        AtomicHolder h(&registryLock_);
+        {
+            AtomicHolder l(this);
+            for (auto it = members_.begin(); it != members_.end(); ++it)
+            {
+                if (*it == member)
+                {
+                    members_.erase(it);
+                    break;
+                }
+            }
+            if (!members_.empty())
+            {
+                return;
+            }
+        }
+        for (GcRenderFanout **p = &head_; *p; p = &(*p)->next_)
+        {
+            if (*p == this)
+            {
+                *p = next_;
+                break;
+            }
+        }
+        hub_->unregister_port(this);
+        // The hub's executor may be in the middle of calling send(); the
+        // deletion has to queue up behind it.
+        GcRenderFanout *f = this;
+        hub_->service()->executor()->add(
+            new CallbackExecutable([f]() { delete f; }));
+    }
+
+    /// The attached ports.
+    std::vector<Member *> members_;
+    /// Which hub we are rendering for.
+    CanHubFlow *hub_;
+    /// Next fanout in the registry.
+    GcRenderFanout *next_ {nullptr};
+
+    /// Protects the registry.
+    static Atomic registryLock_;
+    /// Registry of all fanouts, one per CAN hub.
+    static GcRenderFanout *head_;
+};
+
+constexpr unsigned GcRenderFanout::TEXT_SIZE;
+Atomic GcRenderFanout::registryLock_;
+GcRenderFanout *GcRenderFanout::head_ = nullptr;
+
 /// Actual implementation for the gridconnect bridge between a string-typed Hub
 /// and a CAN-frame-typed Hub.
 class GCAdapter : public GCAdapterBase
@@ -60,11 +303,11 @@ public:
     /// @param double_bytes if true, upon rendering data each byte will be
     /// doubled. This is an anciant workaround.
     GCAdapter(HubFlow *gc_side, CanHubFlow *can_side, bool double_bytes)
-        : parser_(can_side->service(), can_side, &formatter_)
-        , formatter_(can_side->service(), gc_side, &parser_, double_bytes)
+        : parser_(can_side->service(), can_side, &canMember_)
+        , formatter_(can_side->service(), gc_side, &parser_)
+        , canMember_(can_side, &formatter_, double_bytes)
     {
         gc_side->register_port(&parser_);
-        can_side->register_port(&formatter_);
         isRegistered_ = 1;
     }
 
@@ -79,11 +322,11 @@ public:
     /// doubled. This is an anciant workaround.
     GCAdapter(HubFlow *gc_side_read, HubFlow *gc_side_write,
         CanHubFlow *can_side, bool double_bytes)
-        : parser_(can_side->service(), can_side, &formatter_)
-        , formatter_(can_side->service(), gc_side_write, &parser_, double_bytes)
+        : parser_(can_side->service(), can_side, &canMember_)
+        , formatter_(can_side->service(), gc_side_write, &parser_)
+        , canMember_(can_side, &formatter_, double_bytes)
     {
         gc_side_read->register_port(&parser_);
-        can_side->register_port(&formatter_);
         isRegistered_ = 1;
     }
 
@@ -96,7 +339,7 @@ public:
     {
         if (isRegistered_)
         {
-            parser_.destination()->unregister_port(&formatter_);
+            canMember_.detach();
             /// @todo(balazs.racz) This is incorrect if the 3-pipe constructor
             /// is used.
             formatter_.destination()->unregister_port(&parser_);
@@ -110,10 +353,10 @@ public:
         return formatter_.shutdown() && parser_.is_waiting() && formatter_.is_waiting();
     }
 
-    /// HubPort (on a CAN-typed hub) that turns a binary CAN packet into a
-    /// string-formatted CAN packet, and sends it off to the HubFlow (of type
-    /// string).
-    class BinaryToGCMember : public CanHubPort
+    /// Port (attached to the GcRenderFanout of the CAN hub) that takes the
+    /// string-formatted CAN packets, and sends them off to the HubFlow (of
+    /// type string).
+    class BinaryToGCMember : public StateFlow<Buffer<GcTextData>, QList<1>>
     {
     public:
         /// Constructor.
@@ -122,16 +365,13 @@ public:
         /// @param destination string hub where to write gridconnecct data to.
         /// @param skip_member what to set the skipmember_ field of the outgoing
         /// packets to.
-        /// @param double_bytes if true, upon rendering data each byte will be
-        /// doubled. This is an anciant workaround.
-        BinaryToGCMember(Service *service, HubFlow *destination,
-            HubPort *skip_member, int double_bytes)
-            : CanHubPort(service)
+        BinaryToGCMember(
+            Service *service, HubFlow *destination, HubPort *skip_member)
+            : StateFlow<Buffer<GcTextData>, QList<1>>(service)
             , delayPort_(service, destination, config_gridconnect_buffer_size(),
                   USEC_TO_NSEC(config_gridconnect_buffer_delay_usec()))
             , destination_(destination)
             , skipMember_(skip_member)
-            , double_bytes_(double_bytes)
         {
         }
 
@@ -147,31 +387,17 @@ public:
         
         Action entry() override
         {
-            LOG(VERBOSE, "can packet arrived: %" PRIx32,
-                GET_CAN_FRAME_ID_EFF(*message()->data()));
-            char *end =
-                gc_format_generate(message()->data(), dbuf_, double_bytes_);
-            size_t size = (end - dbuf_);
-            if (size)
-            {
-                Buffer<HubData> *target_buffer = nullptr;
-                /// @todo(balazs.racz) switch to asynchronous allocation here.
-                mainBufferPool->alloc(&target_buffer);
-                target_buffer->data()->skipMember_ = skipMember_;
-                /// @todo(balazs.racz) try to use an assign function for better
-                /// performance.
-                target_buffer->data()->resize(size);
-                memcpy((char *)target_buffer->data()->data(), dbuf_, size);
-                target_buffer->set_done(bn_.reset(this));
-                delayPort_.send(target_buffer, 0);
-                release();
-                return wait_and_call(STATE(buffer_accepted));
-            }
-            else
-            {
-                LOG(INFO, "gc generate failed.");
-            }
-            return release_and_exit();
+            GcTextData *d = message()->data();
+            LOG(VERBOSE, "can packet arrived: %s", d->text->data());
+            Buffer<HubData> *target_buffer = nullptr;
+            /// @todo(balazs.racz) switch to asynchronous allocation here.
+            mainBufferPool->alloc(&target_buffer);
+            target_buffer->data()->skipMember_ = skipMember_;
+            target_buffer->data()->assign(d->text->data(), d->len);
+            target_buffer->set_done(bn_.reset(this));
+            delayPort_.send(target_buffer, 0);
+            release();
+            return wait_and_call(STATE(buffer_accepted));
         }
 
         Action buffer_accepted()
@@ -183,14 +409,10 @@ public:
         /// Helper class that assembles larger outgoing packets from the
         /// individual packets by delaying data a little bit.
         BufferPort delayPort_;
-        /// Destination buffer (characters).
-        char dbuf_[56];
         /// Pipe to send data to.
         HubFlow *destination_;
         /// The pipe member that should be sent as "source".
         HubPort *skipMember_;
-        /// Non-zero if doubling was requested.
-        int double_bytes_;
         /// Helper object
         BarrierNotifiable bn_;
     };
@@ -207,8 +429,8 @@ public:
         /// @param destination Where to write converted binary packets.
         /// @param skip_member what to set skipMember_ of the outgoing packets
         /// to.
-        GCToBinaryMember(
-            Service *service, CanHubFlow *destination, CanHubPort *skip_member)
+        GCToBinaryMember(Service *service, CanHubFlow *destination,
+            CanHubPortInterface *skip_member)
             : HubPort(service)
             , destination_(destination)
             , skipMember_(skip_member)
@@ -296,8 +518,11 @@ public:
 private:
     /// PipeMember doing the parsing.
     GCToBinaryMember parser_;
-    /// PipeMember doing the formatting.
+    /// PipeMember forwarding the formatted packets.
     BinaryToGCMember formatter_;
+    /// Attaches formatter_ to the CAN hub; also the source of the packets
+    /// parser_ sends to the CAN hub.
+    GcRenderFanout::Member canMember_;
     /// 1 if the flows are registered.
     unsigned isRegistered_ : 1;
 };
@@ -320,34 +545,25 @@ GCAdapterBase *GCAdapterBase::CreateGridConnectAdapter(HubFlow *gc_side_read,
 /// Implementation for the gridconnect bridge. Owns all necessary structures,
 /// and is responsible for the initialization, registering, unregistering and
 /// destruction of these structures.
-struct GcPacketPrinter::Impl : public CanHubPortInterface
+struct GcPacketPrinter::Impl : public GcTextPortInterface
 {
     /// Constructor.
     ///
     /// @param can_hub Which hub's packets to write to stdout.
     /// @param timestamped Whether to put timestamps on the packets written.
     Impl(CanHubFlow *can_hub, bool timestamped)
-        : canHub_(can_hub)
-        , timestamped_(timestamped)
+        : timestamped_(timestamped)
+        , canMember_(can_hub, this, false)
     {
-        canHub_->register_port(this);
     }
 
-    ~Impl()
-    {
-        canHub_->unregister_port(this);
-    }
-
-    /// Overridden entry method to send binary data to this hub.
+    /// Overridden entry method to receive the rendered packets.
     ///
-    /// @param message CAN frame buffer.
+    /// @param message gridconnect text of a CAN frame.
     /// @param priority priority
-    void send(Buffer<CanHubData> *message, unsigned priority) OVERRIDE
+    void send(Buffer<GcTextData> *message, unsigned priority) OVERRIDE
     {
-        AutoReleaseBuffer<CanHubData> b(message);
-        char str[40];
-        char* p = gc_format_generate(message->data(), str, false);
-        *p = 0;
+        AutoReleaseBuffer<GcTextData> b(message);
         if (timestamped_)
         {
 #if defined(__linux__) || defined(__MACH__)
@@ -357,20 +573,20 @@ struct GcPacketPrinter::Impl : public CanHubPortInterface
             localtime_r(&tv.tv_sec, &t);
             printf("%04d-%02d-%02d %02d:%02d:%02d:%06ld [%p] ",
                 t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
-                t.tm_sec, (long)tv.tv_usec, message->data()->skipMember_);
+                t.tm_sec, (long)tv.tv_usec, message->data()->source);
 #endif
         }
-        printf("%s", str);
+        printf("%s", message->data()->text->data());
         if (config_gc_generate_newlines() != 1)
         {
             printf("\n");
         }
     }
 
-    /// Which hun are we registered to.
-    CanHubFlow* canHub_;
     /// Whether we are printing timestamps of the packets.
     bool timestamped_;
+    /// Attaches us to the CAN hub.
+    GcRenderFanout::Member canMember_;
 };
 
 GcPacketPrinter::GcPacketPrinter(CanHubFlow *can_hub, bool timestamped) : impl_(new Impl(can_hub, timestamped))
@@ -407,7 +623,10 @@ struct GcHubPort : public Executable
 #ifndef OPENMRN_FEATURE_EXECUTOR_SELECT
             DIE("select is not supported");
 #else
-            gcWrite_.reset(new HubDeviceSelect<HubFlow>(&gcHub_, fd, this));
+            auto *port = new HubDeviceSelect<HubFlow>(&gcHub_, fd, this);
+            // Several frames queued up for the socket go out in one write.
+            port->set_write_coalescing(16);
+            gcWrite_.reset(port);
 #endif
         } else {
             gcWrite_.reset(new FdHubPort<HubFlow>(&gcHub_, fd, this));
@@ -251,6 +251,9 @@ public:
 protected:
     // For barrier_.
     template <class HFlow> friend class HubDeviceSelectReadFlow;
+    template <class HFlow, unsigned N>
+    friend class HubDeviceSelectBatchReadFlow;
+    friend class SocketCanReadFlow;
     friend class openlcb::FdToTcpParser;
 
     /// Constructor
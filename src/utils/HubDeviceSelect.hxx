@@ -42,7 +42,16 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 #include <fcntl.h>
+#include <memory>
+#include <vector>
+
+#ifdef OPENMRN_FEATURE_HUB_WRITE_COALESCING
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 #include "executor/StateFlow.hxx"
 #include "utils/Hub.hxx"
@@ -76,6 +85,15 @@ template <> struct SelectBufferInfo<HubFlow::buffer_type>
     {
         return false;
     }
+    /// Unit of a batched read. Any number of bytes can go into one buffer.
+    static constexpr size_t RECORD_SIZE = 64;
+    /// Copies data from a batched read into a buffer. @param b is the
+    /// buffer, @param data is what was read, @param len how many bytes.
+    static void fill_target(HubFlow::buffer_type *b, const uint8_t *data,
+        size_t len)
+    {
+        b->data()->assign((const char *)data, len);
+    }
 };
 
 /// Partial template specialization of buffer traits for struct-typed hubs.
@@ -102,6 +120,16 @@ struct SelectBufferInfo<Buffer<HubContainer<StructContainer<T>>>>
     {
         return true;
     }
+    /// Each buffer carries exactly one structure.
+    static constexpr size_t RECORD_SIZE = sizeof(T);
+    /// Copies one structure from a batched read into a buffer. @param b is
+    /// the buffer, @param data is what was read, @param len must be
+    /// RECORD_SIZE.
+    static void fill_target(buffer_type *b, const uint8_t *data, size_t len)
+    {
+        HASSERT(len == RECORD_SIZE);
+        memcpy(b->data()->data(), data, len);
+    }
 };
 
 /// Partial template specialization of buffer traits for CAN frame-typed
@@ -130,6 +158,16 @@ struct SelectBufferInfo<Buffer<CanHubData>> {
     {
         return true;
     }
+    /// Each buffer carries exactly one CAN frame.
+    static constexpr size_t RECORD_SIZE = sizeof(struct can_frame);
+    /// Copies one CAN frame from a batched read into a buffer. @param b is
+    /// the buffer, @param data is what was read, @param len must be
+    /// RECORD_SIZE.
+    static void fill_target(buffer_type *b, const uint8_t *data, size_t len)
+    {
+        HASSERT(len == RECORD_SIZE);
+        memcpy(b->data()->mutable_frame(), data, len);
+    }
 };
 
 /// State flow implementing select-aware fd reads.
@@ -241,6 +279,146 @@ private:
     typename HFlow::port_type *skipMember_;
 };
 
+/// State flow implementing select-aware fd reads, taking many records per
+/// read() call. Each read asks for up to N records; the data is then split
+/// into one buffer per record (for string-typed hubs: one buffer per read)
+/// and sent to the hub. A trailing partial record is kept for the next
+/// read. Use it as the ReadFlow argument of HubDeviceSelect, for example
+/// HubDeviceSelect<CanHubFlow, HubDeviceSelectBatchReadFlow<CanHubFlow>>.
+///
+/// Datagram sockets (such as SocketCAN) return at most one record per read,
+/// so this flow does not make a difference there.
+template <class HFlow, unsigned N = 16>
+class HubDeviceSelectBatchReadFlow : public StateFlowBase
+{
+public:
+    /// Buffer type.
+    typedef typename HFlow::buffer_type buffer_type;
+    /// Traits of the buffer type.
+    typedef SelectBufferInfo<buffer_type> Info;
+
+    /// Constructor.
+    ///
+    /// @param device parent object.
+    /// @param dst hub to send the data read to.
+    /// @param skip_member source port designation of the data read.
+    HubDeviceSelectBatchReadFlow(FdHubPortService *device,
+        typename HFlow::port_type *dst, typename HFlow::port_type *skip_member)
+        : StateFlowBase(device)
+        , buf_(new uint8_t[N * Info::RECORD_SIZE])
+        , dst_(dst)
+        , skipMember_(skip_member)
+    {
+        this->start_flow(STATE(try_read));
+    }
+
+    /// Unregisters the current flow from the hub.
+    void shutdown()
+    {
+        auto *e = this->service()->executor();
+        if (e->is_selected(&selectHelper_))
+        {
+            e->unselect(&selectHelper_);
+        }
+        set_terminated();
+        notify_barrier();
+    }
+
+    /// @return the parent object.
+    FdHubPortService *device()
+    {
+        return static_cast<FdHubPortService *>(this->service());
+    }
+
+    /// @return how many read() calls returned data.
+    size_t num_reads()
+    {
+        return numReads_;
+    }
+
+    /// Reads as much as fits into the staging buffer. @return next state.
+    Action try_read()
+    {
+        return this->read_single(&selectHelper_, device()->fd(),
+            buf_.get() + have_, N * Info::RECORD_SIZE - have_,
+            STATE(read_done), 0);
+    }
+
+    /// Called when the read call is completed. @return next state.
+    Action read_done()
+    {
+        if (selectHelper_.hasError_)
+        {
+            /// Error reading the socket.
+            notify_barrier();
+            set_terminated();
+            device()->report_read_error();
+            return exit();
+        }
+        ++numReads_;
+        have_ = N * Info::RECORD_SIZE - selectHelper_.remaining_;
+        next_ = 0;
+        return call_immediately(STATE(next_record));
+    }
+
+    /// Allocates a buffer for the next record or goes back to reading if all
+    /// complete records are sent. @return next state.
+    Action next_record()
+    {
+        size_t len = Info::needs_read_fully() ? Info::RECORD_SIZE : have_;
+        if (have_ - next_ < len || !len)
+        {
+            // Keeps the partial record for the next read.
+            memmove(buf_.get(), buf_.get() + next_, have_ - next_);
+            have_ -= next_;
+            return call_immediately(STATE(try_read));
+        }
+        return this->allocate_and_call(dst_, STATE(send_record));
+    }
+
+    /// Fills the allocated buffer and sends it to the hub. @return next
+    /// state.
+    Action send_record()
+    {
+        auto *b = this->get_allocation_result(dst_);
+        size_t len = Info::needs_read_fully() ? Info::RECORD_SIZE : have_;
+        b->data()->skipMember_ = skipMember_;
+        Info::fill_target(b, buf_.get() + next_, len);
+        next_ += len;
+        dst_->send(b, 0);
+        return call_immediately(STATE(next_record));
+    }
+
+private:
+    /** Calls into the parent flow's barrier notify, but makes sure to
+     * only do this once in the lifetime of *this. */
+    void notify_barrier()
+    {
+        if (barrierOwned_)
+        {
+            barrierOwned_ = false;
+            device()->barrier_.notify();
+        }
+    }
+
+    /// true iff pending parent->barrier_.notify()
+    bool barrierOwned_{true};
+    /// Helper object for read/write FD asynchronously.
+    StateFlowSelectHelper selectHelper_{this};
+    /// Staging area for the data read, N records long.
+    std::unique_ptr<uint8_t[]> buf_;
+    /// Number of valid bytes in buf_.
+    size_t have_{0};
+    /// Offset in buf_ of the next record to send.
+    size_t next_{0};
+    /// Number of successful read calls.
+    size_t numReads_{0};
+    /// Where do we forward the messages we created.
+    typename HFlow::port_type *dst_;
+    /// What should be the source port designation.
+    typename HFlow::port_type *skipMember_;
+};
+
 /// HubPort that connects a select-aware device to a strongly typed Hub.
 ///
 /// The device is given by either the path to the device or the fd to an opened
@@ -252,6 +430,10 @@ private:
 /// hub: for string-typed hubs in 64 bytes units; for hubs of specific
 /// structures (such as CAN frame, dcc Packets or dcc Feedback structures) in
 /// the units ofthe size of the structure.
+///
+/// With set_write_coalescing() the write flow takes all buffers queued up for
+/// the port (up to a limit) and writes them with a single writev() call, or
+/// on datagram sockets a single sendmmsg() call with one message per buffer.
 template <class HFlow, class ReadFlow = HubDeviceSelectReadFlow<HFlow>>
 class HubDeviceSelect : public FdHubPortService, private Atomic
 {
@@ -282,7 +464,7 @@ public:
     /// @param on_error notifiable that will be called when a write or read
     /// error is encountered.
     HubDeviceSelect(HFlow *hub, int fd, Notifiable *on_error = nullptr)
-        : FdHubPortService(hub->service()->executor(), fd)
+        : FdHubPortService(hub->service()->executor(), set_nonblocking(fd))
         , hub_(hub)
         , readFlow_(this, hub, &writeFlow_)
         , writeFlow_(this)
@@ -291,12 +473,6 @@ public:
         barrier_.reset(
             on_error ? on_error : EmptyNotifiable::DefaultInstance());
         barrier_.new_child();
-#ifdef __WINNT__
-        unsigned long par = 1;
-        ioctlsocket(fd_, FIONBIO, &par);
-#else
-        ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
-#endif
         hub_->register_port(write_port());
     }
 
@@ -336,6 +512,12 @@ public:
         return &writeFlow_;
     }
 
+    /// @return the read flow belonging to this device.
+    ReadFlow *read_flow()
+    {
+        return &readFlow_;
+    }
+
     /// Removes the current write port from the registry of the source hub.
     void unregister_write_port()
     {
@@ -357,6 +539,27 @@ public:
         return writeFlow_.is_waiting();
     }
 
+    /// Turns on writing several queued buffers with one system call. Must be
+    /// called on the executor of the hub, or before any data is sent to the
+    /// port. Does nothing where writev() is not available, and on datagram
+    /// sockets where sendmmsg() is not available.
+    ///
+    /// @param max_buffers how many buffers to write in one call at most. 1
+    /// turns coalescing off.
+    /// @param max_delay_nsec if non-zero, and nothing else is queued behind
+    /// a buffer, waits this long for more data before writing. Zero writes
+    /// whatever is queued right away.
+    void set_write_coalescing(unsigned max_buffers, long long max_delay_nsec = 0)
+    {
+        writeFlow_.set_coalescing(max_buffers, max_delay_nsec);
+    }
+
+    /// @return how many write system calls the port has made.
+    size_t num_write_calls()
+    {
+        return writeFlow_.numWriteCalls_;
+    }
+
 protected:
     /// Base stateflow for the WriteFlow.
     typedef StateFlow<typename HFlow::buffer_type, QList<1>> WriteFlowBase;
@@ -403,6 +606,18 @@ protected:
             if (device()->fd() < 0) {
                 return this->release_and_exit();
             }
+#ifdef OPENMRN_FEATURE_HUB_WRITE_COALESCING
+            if (maxBatch_ > 1)
+            {
+                if (maxDelay_ && this->queue_empty())
+                {
+                    return this->sleep_and_call(
+                        &timer_, maxDelay_, STATE(collect_batch));
+                }
+                return this->call_immediately(STATE(collect_batch));
+            }
+#endif
+            ++numWriteCalls_;
             return this->write_repeated(&selectHelper_, device()->fd(),
                 this->message()->data()->data(),
                 this->message()->data()->size(), STATE(write_done),
@@ -418,9 +633,189 @@ protected:
             return this->release_and_exit();
         }
 
+#ifdef OPENMRN_FEATURE_HUB_WRITE_COALESCING
+        /// Sets the coalescing parameters; see
+        /// HubDeviceSelect::set_write_coalescing.
+        void set_coalescing(unsigned max_buffers, long long max_delay_nsec)
+        {
+            int type = 0;
+            socklen_t len = sizeof(type);
+            datagram_ = ::getsockopt(device()->fd(), SOL_SOCKET, SO_TYPE,
+                            &type, &len) == 0 &&
+                type != SOCK_STREAM;
+#ifndef __linux__
+            if (datagram_)
+            {
+                // No sendmmsg.
+                max_buffers = 1;
+            }
+#endif
+            if (max_buffers > IOV_MAX)
+            {
+                max_buffers = IOV_MAX;
+            }
+            maxBatch_ = max_buffers ? max_buffers : 1;
+            maxDelay_ = max_delay_nsec;
+        }
+
+        /// Takes the current message and whatever else is queued, up to the
+        /// batch limit. @return next state.
+        StateFlowBase::Action collect_batch()
+        {
+            batch_.push_back(this->transfer_message());
+            while (batch_.size() < maxBatch_ && this->take_next_message())
+            {
+                batch_.push_back(this->transfer_message());
+            }
+            iov_.resize(batch_.size());
+            for (unsigned i = 0; i < batch_.size(); ++i)
+            {
+                iov_[i].iov_base = (void *)batch_[i]->data()->data();
+                iov_[i].iov_len = batch_[i]->data()->size();
+            }
+            nextIov_ = 0;
+            return this->call_immediately(STATE(try_write_batch));
+        }
+
+        /// Writes the collected buffers, as many as the fd takes. @return
+        /// next state.
+        StateFlowBase::Action try_write_batch()
+        {
+            if (device()->fd() < 0)
+            {
+                // Shut down while we were waiting.
+                return this->call_immediately(STATE(batch_done));
+            }
+            while (nextIov_ < iov_.size() && !iov_[nextIov_].iov_len)
+            {
+                // Empty buffers, e.g. the shutdown marker.
+                ++nextIov_;
+            }
+            if (nextIov_ >= iov_.size())
+            {
+                return this->call_immediately(STATE(batch_done));
+            }
+            ++numWriteCalls_;
+            int count;
+            if (datagram_)
+            {
+                count = send_datagrams();
+            }
+            else
+            {
+                count = ::writev(device()->fd(), &iov_[nextIov_],
+                    iov_.size() - nextIov_);
+                if (count > 0)
+                {
+                    consume_bytes(count);
+                }
+            }
+            if (count > 0)
+            {
+                return this->again();
+            }
+            if (count < 0 &&
+                (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            {
+                // Blocked. Waits until the fd is writable.
+                selectHelper_.reset(
+                    Selectable::WRITE, device()->fd(), this->priority());
+                selectHelper_.set_wakeup(this);
+                this->service()->executor()->select(&selectHelper_);
+                return this->wait();
+            }
+            device()->report_write_error();
+            return this->call_immediately(STATE(batch_done));
+        }
+
+        /// Releases all buffers of the batch. @return next state.
+        StateFlowBase::Action batch_done()
+        {
+            for (auto *b : batch_)
+            {
+                b->unref();
+            }
+            batch_.clear();
+            return this->exit();
+        }
+
+        /// Advances the iovec array after a partial write. @param count is
+        /// how many bytes were written.
+        void consume_bytes(size_t count)
+        {
+            while (count)
+            {
+                struct iovec &v = iov_[nextIov_];
+                if (count < v.iov_len)
+                {
+                    v.iov_base = (uint8_t *)v.iov_base + count;
+                    v.iov_len -= count;
+                    return;
+                }
+                count -= v.iov_len;
+                v.iov_len = 0;
+                ++nextIov_;
+            }
+        }
+
+        /// Sends the remaining buffers as separate datagrams. @return number
+        /// of datagrams sent, or -1 with errno set.
+        int send_datagrams()
+        {
+#ifdef __linux__
+            std::vector<struct mmsghdr> msgs(iov_.size() - nextIov_);
+            memset(msgs.data(), 0, msgs.size() * sizeof(msgs[0]));
+            for (unsigned i = 0; i < msgs.size(); ++i)
+            {
+                msgs[i].msg_hdr.msg_iov = &iov_[nextIov_ + i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int count = ::sendmmsg(
+                device()->fd(), msgs.data(), msgs.size(), MSG_DONTWAIT);
+            if (count > 0)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    iov_[nextIov_ + i].iov_len = 0;
+                }
+                nextIov_ += count;
+            }
+            return count;
+#else
+            DIE("sendmmsg not supported");
+#endif
+        }
+#else
+        /// Coalescing is not supported on this platform.
+        void set_coalescing(unsigned max_buffers, long long max_delay_nsec)
+        {
+        }
+#endif
+
     private:
+        friend class HubDeviceSelect;
+
         /// Helper class for asynchronous writes.
         StateFlowBase::StateFlowSelectHelper selectHelper_{this};
+        /// Number of write system calls made.
+        size_t numWriteCalls_{0};
+#ifdef OPENMRN_FEATURE_HUB_WRITE_COALESCING
+        /// Waits for more data before a coalesced write.
+        StateFlowBase::StateFlowTimer timer_{this};
+        /// Buffers being written by a coalesced write.
+        std::vector<typename HFlow::buffer_type *> batch_;
+        /// Remaining data of each buffer in batch_.
+        std::vector<struct iovec> iov_;
+        /// Index of the first entry in iov_ with data left to write.
+        unsigned nextIov_{0};
+        /// Max number of buffers in one write. 1 if coalescing is off.
+        unsigned maxBatch_{1};
+        /// How long to wait for more data before a coalesced write.
+        long long maxDelay_{0};
+        /// True if the fd is a datagram socket; each buffer is then sent as
+        /// a separate message.
+        bool datagram_{false};
+#endif
     };
 
 protected:
@@ -449,6 +844,20 @@ protected:
         }
     }
 
+    /// Puts an fd into nonblocking mode. This has to happen before the read
+    /// flow is started, otherwise its first read may block the executor.
+    /// @param fd the filedes. @return fd.
+    static int set_nonblocking(int fd)
+    {
+#ifdef __WINNT__
+        unsigned long par = 1;
+        ioctlsocket(fd, FIONBIO, &par);
+#else
+        ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
+#endif
+        return fd;
+    }
+
     /// Hub whose data we are trying to send.
     HFlow *hub_;
     /// StateFlow for reading data from the fd. Woken when data arrives.
@@ -0,0 +1,154 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file LatencyHistogram.hxx
+ *
+ * Fixed size histogram of latency samples with power-of-two buckets.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _UTILS_LATENCYHISTOGRAM_HXX_
+#define _UTILS_LATENCYHISTOGRAM_HXX_
+
+#include <stdint.h>
+#include <string.h>
+
+/// Collects latency samples into buckets of power-of-two microseconds, so
+/// that percentiles can be reported without storing the samples. Bucket 0
+/// counts samples under 1 usec, bucket i counts samples in [2^(i-1), 2^i)
+/// usec, and the last bucket everything above. Percentiles are reported as
+/// the upper bound of the bucket they fall in, so they are accurate within a
+/// factor of two.
+///
+/// No locking; the user has to make sure samples are added from one thread
+/// (typically the executor of the flow doing the measurement).
+class LatencyHistogram
+{
+public:
+    /// Number of buckets. The last one collects everything above 2^30 usec.
+    static constexpr unsigned NUM_BUCKETS = 32;
+
+    LatencyHistogram()
+    {
+        clear();
+    }
+
+    /// Forgets all samples.
+    void clear()
+    {
+        memset(buckets_, 0, sizeof(buckets_));
+        count_ = 0;
+        maxNsec_ = 0;
+    }
+
+    /// Adds a sample. @param nsec the measured latency in nanoseconds.
+    void add(long long nsec)
+    {
+        if (nsec < 0)
+        {
+            nsec = 0;
+        }
+        ++buckets_[bucket(nsec)];
+        ++count_;
+        if (nsec > maxNsec_)
+        {
+            maxNsec_ = nsec;
+        }
+    }
+
+    /// @return the number of samples added since the last clear().
+    uint32_t count() const
+    {
+        return count_;
+    }
+
+    /// @return the largest sample in nanoseconds, or 0 if there were none.
+    long long max_nsec() const
+    {
+        return maxNsec_;
+    }
+
+    /// @param bucket index, 0 .. NUM_BUCKETS-1
+    /// @return how many samples fell into that bucket.
+    uint32_t bucket_count(unsigned bucket) const
+    {
+        return buckets_[bucket];
+    }
+
+    /// @param pct which percentile to compute, 0..100.
+    /// @return an upper bound of the given percentile of the samples in
+    /// nanoseconds, or 0 if there were no samples. Never more than the
+    /// largest sample.
+    long long percentile_nsec(unsigned pct) const
+    {
+        if (!count_)
+        {
+            return 0;
+        }
+        // Rank of the sample we are looking for, 1-based, rounded up.
+        uint64_t rank = ((uint64_t)count_ * pct + 99) / 100;
+        if (rank < 1)
+        {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += buckets_[i];
+            if (seen >= rank)
+            {
+                long long limit = (1000LL << i);
+                return limit < maxNsec_ ? limit : maxNsec_;
+            }
+        }
+        return maxNsec_;
+    }
+
+private:
+    /// @return the bucket index for a sample of nsec nanoseconds.
+    static unsigned bucket(long long nsec)
+    {
+        uint64_t usec = nsec / 1000;
+        unsigned b = 0;
+        while (usec && b < NUM_BUCKETS - 1)
+        {
+            usec >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+    /// Sample counts per bucket.
+    uint32_t buckets_[NUM_BUCKETS];
+    /// Total number of samples.
+    uint32_t count_;
+    /// Largest sample seen.
+    long long maxNsec_;
+};
+
+#endif // _UTILS_LATENCYHISTOGRAM_HXX_
@@ -73,6 +73,8 @@ protected:
     /** ActiveTimers needs to iterate through the queue. */
     friend class ExecutorBase;
     friend class TimerTest;
+    /** Lock-free queue that links the members itself. */
+    template <unsigned ITEMS> friend class QListMpsc;
 };
 
 #endif /* _UTILS_QMEMBER_HXX_ */
@@ -38,6 +38,12 @@
 #include <cstdlib>
 #include <cstdarg>
 
+#include "openmrn_features.h"
+
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+#include <atomic>
+#endif
+
 #include "executor/Executable.hxx"
 #include "executor/Notifiable.hxx"
 #include "os/OS.hxx"
@@ -597,6 +603,134 @@ private:
  */
 template<unsigned items> using QListProtected = QList<items>;
 
+#if OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+/** A list of queues with lock-free insertion from any number of threads, and
+ * removal from a single consumer thread. Index 0 is the highest priority.
+ *
+ * Each priority band has an inbox, which is a stack that producers push onto
+ * with a compare-and-swap, and an outbox, which only the consumer touches.
+ * When the outbox runs empty, the consumer takes the entire inbox with one
+ * exchange and reverses it into the outbox, which restores FIFO order.
+ */
+template <unsigned ITEMS> class QListMpsc
+{
+public:
+    QListMpsc()
+    {
+    }
+
+    ~QListMpsc()
+    {
+    }
+
+    typedef ::Result Result;
+
+    /** Add an item to the back of the queue. Can be called from any thread.
+     * @param item to add to queue
+     * @param index in the list to operate on
+     */
+    void insert(QMember *item, unsigned index)
+    {
+        HASSERT(item->next == nullptr);
+        if (index >= ITEMS)
+        {
+            index = ITEMS - 1;
+        }
+        count_.fetch_add(1);
+        std::atomic<QMember *> &inbox = list_[index].inbox;
+        QMember *head = inbox.load(std::memory_order_relaxed);
+        do
+        {
+            item->next = head;
+        } while (!inbox.compare_exchange_weak(head, item));
+    }
+
+    /** Get an item from the front of the queue in priority order. Must be
+     * called from the consumer thread only.
+     * @return item retrieved from queue + index, NULL if no item available
+     */
+    Result next()
+    {
+        if (!count_.load())
+        {
+            return Result();
+        }
+        for (unsigned i = 0; i < ITEMS; ++i)
+        {
+            Band &b = list_[i];
+            QMember *result = b.outbox;
+            if (!result && b.inbox.load(std::memory_order_relaxed))
+            {
+                result = reverse(b.inbox.exchange(nullptr));
+            }
+            if (result)
+            {
+                b.outbox = result->next;
+                result->next = nullptr;
+                count_.fetch_sub(1);
+                return Result(result, i);
+            }
+        }
+        return Result();
+    }
+
+    /** @return the total number of pending items in all queues in the list.
+     * Can be called from any thread. */
+    size_t pending()
+    {
+        return count_.load();
+    }
+
+    /// @return how many entries are enqueued right now (across all lists).
+    size_t size()
+    {
+        return pending();
+    }
+
+    /** Test if all the queues are empty. Can be called from any thread.
+     * @return true if empty (all lists), else false
+     */
+    bool empty()
+    {
+        return count_.load() == 0;
+    }
+
+private:
+    /// One priority band.
+    struct Band
+    {
+        /// Items inserted by the producers, newest first.
+        std::atomic<QMember *> inbox {nullptr};
+        /// Items taken over by the consumer, oldest first.
+        QMember *outbox {nullptr};
+    };
+
+    /// Reverses a linked list. @param head first member of the list. @return
+    /// the new first member.
+    static QMember *reverse(QMember *head)
+    {
+        QMember *result = nullptr;
+        while (head)
+        {
+            QMember *n = head->next;
+            head->next = result;
+            result = head;
+            head = n;
+        }
+        return result;
+    }
+
+    /// Number of items in all bands. Incremented before the item is visible
+    /// in the inbox, so that empty() never reports a queue with items in it
+    /// as empty.
+    std::atomic<size_t> count_ {0};
+    /// The priority bands.
+    Band list_[ITEMS];
+
+    DISALLOW_COPY_AND_ASSIGN(QListMpsc);
+};
+#endif // OPENMRN_FEATURE_LOCKFREE_EXECUTOR_QUEUE
+
 
 #if 0
 /** A BufferQueue that adds the ability to wait on the next buffer.
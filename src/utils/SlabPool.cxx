@@ -0,0 +1,316 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file SlabPool.cxx
+ *
+ * A buffer pool with power-of-two size classes and per-thread caches, for
+ * multi-threaded hosts.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include "utils/SlabPool.hxx"
+
+#if OPENMRN_FEATURE_SLAB_POOL
+
+#include <stdlib.h>
+
+constexpr unsigned SlabPool::MIN_SHIFT;
+constexpr unsigned SlabPool::MAX_SHIFT;
+constexpr unsigned SlabPool::NUM_CLASSES;
+constexpr unsigned SlabPool::MAGAZINE_SIZE;
+constexpr unsigned SlabPool::BATCH_SIZE;
+
+SlabPool::SlabPool()
+    : DynamicPool(Bucket::init(0, 0))
+{
+    int ret = pthread_key_create(&key_, &SlabPool::thread_exit);
+    HASSERT(ret == 0);
+}
+
+SlabPool::~SlabPool()
+{
+    pthread_setspecific(key_, nullptr);
+    pthread_key_delete(key_);
+    while (caches_)
+    {
+        ThreadCache *c = caches_;
+        caches_ = c->next;
+        for (unsigned cls = 0; cls < NUM_CLASSES; ++cls)
+        {
+            Magazine *m = &c->mags[cls];
+            for (unsigned i = 0; i < m->count.load(); ++i)
+            {
+                ::free(m->items[i]);
+            }
+        }
+        delete c;
+    }
+    for (unsigned cls = 0; cls < NUM_CLASSES; ++cls)
+    {
+        void *block = classes_[cls].freeList;
+        while (block)
+        {
+            void *next = *static_cast<void **>(block);
+            ::free(block);
+            block = next;
+        }
+    }
+}
+
+SlabPool::ThreadCache *SlabPool::create_cache()
+{
+    ThreadCache *c = new ThreadCache;
+    c->pool = this;
+    {
+        OSMutexLock h(&cacheLock_);
+        c->next = caches_;
+        caches_ = c;
+    }
+    int ret = pthread_setspecific(key_, c);
+    HASSERT(ret == 0);
+    return c;
+}
+
+void SlabPool::release_cache(ThreadCache *c)
+{
+    OSMutexLock h(&cacheLock_);
+    for (ThreadCache **p = &caches_; *p; p = &(*p)->next)
+    {
+        if (*p == c)
+        {
+            *p = c->next;
+            break;
+        }
+    }
+    for (unsigned cls = 0; cls < NUM_CLASSES; ++cls)
+    {
+        Magazine *m = &c->mags[cls];
+        return_blocks(cls, m, m->count.load(std::memory_order_relaxed));
+        OSMutexLock l(&classes_[cls].lock);
+        classes_[cls].retiredHits += m->hits.load(std::memory_order_relaxed);
+        classes_[cls].retiredMisses +=
+            m->misses.load(std::memory_order_relaxed);
+    }
+    delete c;
+}
+
+void SlabPool::thread_exit(void *arg)
+{
+    ThreadCache *c = static_cast<ThreadCache *>(arg);
+    c->pool->release_cache(c);
+}
+
+void SlabPool::flush_thread_cache()
+{
+    ThreadCache *c = static_cast<ThreadCache *>(pthread_getspecific(key_));
+    if (!c)
+    {
+        return;
+    }
+    for (unsigned cls = 0; cls < NUM_CLASSES; ++cls)
+    {
+        Magazine *m = &c->mags[cls];
+        return_blocks(cls, m, m->count.load(std::memory_order_relaxed));
+    }
+}
+
+bool SlabPool::refill(unsigned cls, Magazine *m)
+{
+    SizeClass *sc = &classes_[cls];
+    unsigned n = 0;
+    OSMutexLock h(&sc->lock);
+    while (n < BATCH_SIZE && sc->freeList)
+    {
+        m->items[n++] = sc->freeList;
+        sc->freeList = *static_cast<void **>(sc->freeList);
+    }
+    sc->freeCount -= n;
+    m->count.store(n, std::memory_order_relaxed);
+    return n > 0;
+}
+
+void SlabPool::return_blocks(unsigned cls, Magazine *m, unsigned num)
+{
+    if (!num)
+    {
+        return;
+    }
+    unsigned count = m->count.load(std::memory_order_relaxed);
+    HASSERT(num <= count);
+    // Links the blocks into a chain outside of the lock, then splices the
+    // whole chain into the freelist at once.
+    void *head = m->items[count - num];
+    void *tail = head;
+    for (unsigned i = count - num + 1; i < count; ++i)
+    {
+        *static_cast<void **>(tail) = m->items[i];
+        tail = m->items[i];
+    }
+    m->count.store(count - num, std::memory_order_relaxed);
+    SizeClass *sc = &classes_[cls];
+    OSMutexLock h(&sc->lock);
+    *static_cast<void **>(tail) = sc->freeList;
+    sc->freeList = head;
+    sc->freeCount += num;
+}
+
+/** Get a free item out of the pool.
+ * @param size tells how much to allocate (in bytes)
+ * @param flow if !NULL, then the alloc call is considered async and will
+ *        behave as if @ref alloc_async() was called.
+ * @return the allocated buffer.
+ */
+BufferBase *SlabPool::alloc_untyped(size_t size, Executable *flow)
+{
+    void *block;
+    int cls = size_class(size);
+    if (cls < 0)
+    {
+        /* big items are just malloc'd freely */
+        block = malloc(size);
+        __atomic_add_fetch(&totalSize, size, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        Magazine *m = &get_cache()->mags[cls];
+        unsigned count = m->count.load(std::memory_order_relaxed);
+        if (count == 0 && refill(cls, m))
+        {
+            count = m->count.load(std::memory_order_relaxed);
+        }
+        if (count)
+        {
+            block = m->items[--count];
+            m->count.store(count, std::memory_order_relaxed);
+            // Only the owner thread writes the counters, so there is no need
+            // for a locked increment.
+            m->hits.store(m->hits.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        }
+        else
+        {
+            block = malloc(class_size(cls));
+            m->misses.store(m->misses.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            {
+                OSMutexLock h(&classes_[cls].lock);
+                ++classes_[cls].highWater;
+            }
+            __atomic_add_fetch(
+                &totalSize, class_size(cls), __ATOMIC_RELAXED);
+        }
+    }
+    BufferBase *result = static_cast<BufferBase *>(block);
+    new (result) BufferBase(size, this);
+    if (flow)
+    {
+        flow->alloc_result(result);
+    }
+    return result;
+}
+
+/** Release an item back to the free pool.
+ * @param item pointer to item to release
+ */
+void SlabPool::free(BufferBase *item)
+{
+    size_t size = item->size();
+    int cls = size_class(size);
+    if (cls < 0)
+    {
+        /* big items are just freed */
+        __atomic_sub_fetch(&totalSize, size, __ATOMIC_RELAXED);
+        ::free(item);
+        return;
+    }
+    Magazine *m = &get_cache()->mags[cls];
+    unsigned count = m->count.load(std::memory_order_relaxed);
+    if (count == MAGAZINE_SIZE)
+    {
+        return_blocks(cls, m, BATCH_SIZE);
+        count -= BATCH_SIZE;
+    }
+    m->items[count] = item;
+    m->count.store(count + 1, std::memory_order_relaxed);
+}
+
+void SlabPool::get_stats(unsigned cls, Stats *stats)
+{
+    HASSERT(cls < NUM_CLASSES);
+    stats->size = class_size(cls);
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->freeItems = 0;
+    OSMutexLock h(&cacheLock_);
+    for (ThreadCache *c = caches_; c; c = c->next)
+    {
+        Magazine *m = &c->mags[cls];
+        stats->hits += m->hits.load(std::memory_order_relaxed);
+        stats->misses += m->misses.load(std::memory_order_relaxed);
+        stats->freeItems += m->count.load(std::memory_order_relaxed);
+    }
+    SizeClass *sc = &classes_[cls];
+    OSMutexLock l(&sc->lock);
+    stats->hits += sc->retiredHits;
+    stats->misses += sc->retiredMisses;
+    stats->highWater = sc->highWater;
+    stats->freeItems += sc->freeCount;
+}
+
+/** Number of free items in the pool.
+ * @return number of free items in the pool
+ */
+size_t SlabPool::free_items()
+{
+    size_t total = 0;
+    for (unsigned cls = 0; cls < NUM_CLASSES; ++cls)
+    {
+        Stats s;
+        get_stats(cls, &s);
+        total += s.freeItems;
+    }
+    return total;
+}
+
+/** Number of free items in the pool for a given allocation size.
+ * @param size size of interest
+ * @return number of free items in the pool for a given allocation size
+ */
+size_t SlabPool::free_items(size_t size)
+{
+    int cls = size_class(size);
+    if (cls < 0)
+    {
+        return 0;
+    }
+    Stats s;
+    get_stats(cls, &s);
+    return s.freeItems;
+}
+
+#endif // OPENMRN_FEATURE_SLAB_POOL
@@ -0,0 +1,215 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file SlabPool.hxx
+ *
+ * A buffer pool with power-of-two size classes and per-thread caches, for
+ * multi-threaded hosts.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _UTILS_SLABPOOL_HXX_
+#define _UTILS_SLABPOOL_HXX_
+
+#include "openmrn_features.h"
+
+#if OPENMRN_FEATURE_SLAB_POOL
+
+#include <atomic>
+#include <pthread.h>
+
+#include "os/OS.hxx"
+#include "utils/Buffer.hxx"
+
+/// Buffer pool for multi-threaded hosts. Can be used instead of the
+/// bucket-based DynamicPool as the main buffer pool (see the
+/// main_buffer_pool_use_slab constant).
+///
+/// Allocations are rounded up to a power-of-two size class between
+/// 2^MIN_SHIFT and 2^MAX_SHIFT bytes; larger ones go to malloc. Each thread
+/// keeps a magazine of free blocks per size class, so most allocations and
+/// frees touch no lock at all. When a magazine is empty or full, BATCH_SIZE
+/// blocks are moved from or to the size class' shared freelist under a lock
+/// held by that class only. Blocks are never returned to the heap.
+class SlabPool : public DynamicPool
+{
+public:
+    /// Log2 of the smallest size class.
+    static constexpr unsigned MIN_SHIFT = 5;
+    /// Log2 of the largest size class.
+    static constexpr unsigned MAX_SHIFT = 13;
+    /// Number of size classes.
+    static constexpr unsigned NUM_CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+    /// How many free blocks a thread may keep per size class.
+    static constexpr unsigned MAGAZINE_SIZE = 32;
+    /// How many blocks move between a magazine and the shared freelist at a
+    /// time.
+    static constexpr unsigned BATCH_SIZE = MAGAZINE_SIZE / 2;
+
+    SlabPool();
+    ~SlabPool();
+
+    /// Usage statistics of a size class.
+    struct Stats
+    {
+        /// Block size of this class in bytes.
+        size_t size;
+        /// Allocations served from a magazine or the shared freelist.
+        size_t hits;
+        /// Allocations that had to get a new block from the heap.
+        size_t misses;
+        /// Number of blocks ever allocated from the heap, which is the
+        /// highest number of blocks that were in use at the same time.
+        size_t highWater;
+        /// Number of free blocks in the shared freelist and the magazines.
+        size_t freeItems;
+    };
+
+    /// @return the size class for an allocation size, or -1 if the size is
+    /// larger than the largest class. @param size bytes needed.
+    static int size_class(size_t size)
+    {
+        if (size <= (1u << MIN_SHIFT))
+        {
+            return 0;
+        }
+        if (size > (1u << MAX_SHIFT))
+        {
+            return -1;
+        }
+        unsigned bits = sizeof(unsigned) * 8 - __builtin_clz(size - 1);
+        return bits - MIN_SHIFT;
+    }
+
+    /// @return the block size of a size class. @param cls size class.
+    static size_t class_size(unsigned cls)
+    {
+        return size_t(1) << (cls + MIN_SHIFT);
+    }
+
+    /// Fills in the statistics of a size class. @param cls size class, less
+    /// than NUM_CLASSES. @param stats will be filled in.
+    void get_stats(unsigned cls, Stats *stats);
+
+    /// Returns all blocks cached by the calling thread to the shared
+    /// freelists.
+    void flush_thread_cache();
+
+    /// @return the number of free blocks in the pool.
+    size_t free_items() override;
+
+    /// @return the number of free blocks in the pool that are suitable for
+    /// a given allocation size. @param size bytes needed.
+    size_t free_items(size_t size) override;
+
+private:
+    /// Free blocks of one size class owned by one thread.
+    struct Magazine
+    {
+        /// Number of valid entries in items. Only the owner thread writes it.
+        std::atomic<unsigned> count{0};
+        /// Allocations served from this magazine (including refills).
+        std::atomic<size_t> hits{0};
+        /// Allocations that had to go to the heap.
+        std::atomic<size_t> misses{0};
+        /// Free blocks.
+        void *items[MAGAZINE_SIZE];
+    };
+
+    /// Per-thread state of the pool.
+    struct ThreadCache
+    {
+        /// Pool this cache belongs to.
+        SlabPool *pool;
+        /// Next cache in the pool's list of caches.
+        ThreadCache *next;
+        /// One magazine per size class.
+        Magazine mags[NUM_CLASSES];
+    };
+
+    /// Shared state of a size class.
+    struct SizeClass
+    {
+        /// Protects the fields of this struct.
+        ::OSMutex lock;
+        /// Singly linked list of free blocks, linked through the first word.
+        void *freeList{nullptr};
+        /// Number of blocks in freeList.
+        size_t freeCount{0};
+        /// Number of blocks ever allocated from the heap.
+        size_t highWater{0};
+        /// Hits of threads that have exited.
+        size_t retiredHits{0};
+        /// Misses of threads that have exited.
+        size_t retiredMisses{0};
+    };
+
+    BufferBase *alloc_untyped(size_t size, Executable *flow) override;
+    void free(BufferBase *item) override;
+
+    /// @return the calling thread's cache, creating it if needed.
+    ThreadCache *get_cache()
+    {
+        ThreadCache *c = static_cast<ThreadCache *>(pthread_getspecific(key_));
+        return c ? c : create_cache();
+    }
+
+    /// Allocates a cache for the calling thread. @return the new cache.
+    ThreadCache *create_cache();
+
+    /// Moves all blocks of a cache to the shared freelists, folds its
+    /// statistics into the size classes and frees it. @param c cache.
+    void release_cache(ThreadCache *c);
+
+    /// Called by pthreads when a thread with a cache exits. @param arg the
+    /// ThreadCache.
+    static void thread_exit(void *arg);
+
+    /// Fills an empty magazine from the shared freelist. @param cls size
+    /// class. @param m magazine. @return true if any blocks were moved.
+    bool refill(unsigned cls, Magazine *m);
+
+    /// Moves blocks from the top of a magazine to the shared freelist.
+    /// @param cls size class. @param m magazine. @param num how many blocks.
+    void return_blocks(unsigned cls, Magazine *m, unsigned num);
+
+    /// Key for the per-thread cache.
+    pthread_key_t key_;
+    /// Protects caches_.
+    ::OSMutex cacheLock_;
+    /// All live thread caches.
+    ThreadCache *caches_{nullptr};
+    /// Shared state per size class.
+    SizeClass classes_[NUM_CLASSES];
+
+    DISALLOW_COPY_AND_ASSIGN(SlabPool);
+};
+
+#endif // OPENMRN_FEATURE_SLAB_POOL
+
+#endif // _UTILS_SLABPOOL_HXX_
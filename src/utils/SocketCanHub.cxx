@@ -0,0 +1,231 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file SocketCanHub.cxx
+ *
+ * Hub port for linux SocketCAN interfaces, reading and writing many frames
+ * per system call.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#include "utils/SocketCanHub.hxx"
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+
+SocketCanReadFlow::SocketCanReadFlow(FdHubPortService *device,
+    CanHubFlow::port_type *dst, CanHubFlow::port_type *skip_member)
+    : StateFlowBase(device)
+    , dst_(dst)
+    , skipMember_(skip_member)
+{
+    memset(msgs_, 0, sizeof(msgs_));
+    for (unsigned i = 0; i < MAX_BATCH; ++i)
+    {
+        iov_[i].iov_base = &frames_[i];
+        iov_[i].iov_len = sizeof(frames_[i]);
+        msgs_[i].msg_hdr.msg_iov = &iov_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_control = cmsg_[i];
+    }
+    // Software receive timestamps. These are taken by the kernel when the
+    // frame arrives from the driver. Sockets that do not support them just
+    // deliver no timestamps.
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    ::setsockopt(
+        device->fd(), SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+    start_flow(STATE(read_frames));
+}
+
+void SocketCanReadFlow::shutdown()
+{
+    auto *e = this->service()->executor();
+    if (e->is_selected(&selectHelper_))
+    {
+        e->unselect(&selectHelper_);
+    }
+    set_terminated();
+    notify_barrier();
+}
+
+StateFlowBase::Action SocketCanReadFlow::wait_for_data()
+{
+    selectHelper_.reset(Selectable::READ, device()->fd(), 0);
+    selectHelper_.set_wakeup(this);
+    this->service()->executor()->select(&selectHelper_);
+    return wait_and_call(STATE(read_frames));
+}
+
+StateFlowBase::Action SocketCanReadFlow::read_frames()
+{
+    for (unsigned i = 0; i < MAX_BATCH; ++i)
+    {
+        // The kernel overwrites these with the actual lengths.
+        msgs_[i].msg_hdr.msg_controllen = CMSG_SIZE;
+        msgs_[i].msg_hdr.msg_flags = 0;
+    }
+    int ret = ::recvmmsg(device()->fd(), msgs_, MAX_BATCH, MSG_DONTWAIT, 0);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return call_immediately(STATE(wait_for_data));
+    }
+    if (ret <= 0)
+    {
+        // Error or EOF on the socket.
+        notify_barrier();
+        set_terminated();
+        device()->report_read_error();
+        return exit();
+    }
+    ++numReads_;
+    count_ = ret;
+    next_ = 0;
+    return call_immediately(STATE(next_frame));
+}
+
+StateFlowBase::Action SocketCanReadFlow::next_frame()
+{
+    while (next_ < count_ && msgs_[next_].msg_len != sizeof(struct can_frame))
+    {
+        // Truncated or CAN-FD frame; we do not handle these.
+        ++next_;
+    }
+    if (next_ >= count_)
+    {
+        // Goes back through the select, so that a busy bus does not keep the
+        // executor from running other work. If more frames arrived while we
+        // were busy, the select returns right away.
+        return call_immediately(STATE(wait_for_data));
+    }
+    return allocate_and_call(dst_, STATE(send_frame));
+}
+
+StateFlowBase::Action SocketCanReadFlow::send_frame()
+{
+    auto *b = get_allocation_result(dst_);
+    b->data()->skipMember_ = skipMember_;
+    *b->data()->mutable_frame() = frames_[next_];
+    long long ts = rx_timestamp(next_);
+    if (ts)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        rxLatency_.add(now.tv_sec * 1000000000LL + now.tv_nsec - ts);
+    }
+    ++numFrames_;
+    ++next_;
+    dst_->send(b, 0);
+    return call_immediately(STATE(next_frame));
+}
+
+long long SocketCanReadFlow::rx_timestamp(unsigned i)
+{
+    struct msghdr *h = &msgs_[i].msg_hdr;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(h); c; c = CMSG_NXTHDR(h, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING &&
+            c->cmsg_len >= CMSG_LEN(sizeof(struct timespec)))
+        {
+            // The first of three timespecs is the software timestamp.
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+    }
+    return 0;
+}
+
+SocketCanHubPort::SocketCanHubPort(
+    CanHubFlow *hub, int fd, Notifiable *on_error)
+    : HubDeviceSelect<CanHubFlow, SocketCanReadFlow>(hub, fd, on_error)
+{
+    set_write_coalescing(SocketCanReadFlow::MAX_BATCH);
+}
+
+int SocketCanHubPort::open_socket(const char *ifname, int loopback)
+{
+    int s = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (s < 0)
+    {
+        return -1;
+    }
+
+    // Set the blocking limit to the minimum allowed, typically 1024 in Linux
+    int sndbuf = 0;
+    ::setsockopt(s, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    ::setsockopt(
+        s, SOL_CAN_RAW, CAN_RAW_LOOPBACK, &loopback, sizeof(loopback));
+
+    can_err_mask_t err_mask = CAN_ERR_TX_TIMEOUT | CAN_ERR_LOSTARB |
+        CAN_ERR_CRTL | CAN_ERR_PROT | CAN_ERR_TRX | CAN_ERR_ACK |
+        CAN_ERR_BUSOFF | CAN_ERR_BUSERROR | CAN_ERR_RESTARTED;
+    ::setsockopt(
+        s, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask));
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+    int ret = ::ioctl(s, SIOCGIFINDEX, &ifr);
+    if (ret == 0)
+    {
+        struct sockaddr_can addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = ifr.ifr_ifindex;
+        ret = ::bind(s, (struct sockaddr *)&addr, sizeof(addr));
+    }
+    if (ret < 0)
+    {
+        int e = errno;
+        ::close(s);
+        errno = e;
+        return -1;
+    }
+    return s;
+}
+
+bool SocketCanHubPort::set_filters(const std::vector<struct can_filter> &filters)
+{
+    if (filters.empty())
+    {
+        struct can_filter all;
+        all.can_id = 0;
+        all.can_mask = 0;
+        return ::setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, &all,
+                   sizeof(all)) == 0;
+    }
+    return ::setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(),
+               filters.size() * sizeof(filters[0])) == 0;
+}
+
+#endif // __linux__
@@ -0,0 +1,200 @@
+/** \copyright
+ * Copyright (c) 2026, Balazs Racz
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file SocketCanHub.hxx
+ *
+ * Hub port for linux SocketCAN interfaces, reading and writing many frames
+ * per system call.
+ *
+ * @author Balazs Racz
+ * @date 16 Oct 2026
+ */
+
+#ifndef _UTILS_SOCKETCANHUB_HXX_
+#define _UTILS_SOCKETCANHUB_HXX_
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <vector>
+
+#include "utils/HubDeviceSelect.hxx"
+#include "utils/LatencyHistogram.hxx"
+
+/// Read flow for SocketCAN sockets. Takes all frames the kernel has queued
+/// (up to MAX_BATCH) with one recvmmsg() call, then sends them to the hub one
+/// by one. The receive timestamp the kernel puts on each frame is used to
+/// collect the latency between the frame arriving and it being handed to
+/// the hub.
+class SocketCanReadFlow : public StateFlowBase
+{
+public:
+    /// How many frames to take with one recvmmsg() call.
+    static constexpr unsigned MAX_BATCH = 32;
+
+    /// Constructor.
+    ///
+    /// @param device parent object.
+    /// @param dst hub to send the frames read to.
+    /// @param skip_member source port designation of the frames read.
+    SocketCanReadFlow(FdHubPortService *device, CanHubFlow::port_type *dst,
+        CanHubFlow::port_type *skip_member);
+
+    /// Unregisters the current flow from the hub.
+    void shutdown();
+
+    /// @return the parent object.
+    FdHubPortService *device()
+    {
+        return static_cast<FdHubPortService *>(this->service());
+    }
+
+    /// @return how many recvmmsg() calls returned frames.
+    size_t num_reads()
+    {
+        return numReads_;
+    }
+
+    /// @return how many frames were received.
+    size_t num_frames()
+    {
+        return numFrames_;
+    }
+
+    /// @return latency samples from the kernel receive timestamp to the frame
+    /// being sent to the hub. Empty if the socket does not deliver
+    /// timestamps. Must be accessed on the executor of the hub.
+    LatencyHistogram *rx_latency()
+    {
+        return &rxLatency_;
+    }
+
+private:
+    /// Waits for the socket to become readable. @return next state.
+    Action wait_for_data();
+    /// Takes all queued frames from the kernel. @return next state.
+    Action read_frames();
+    /// Allocates a buffer for the next received frame. @return next state.
+    Action next_frame();
+    /// Sends the next received frame to the hub. @return next state.
+    Action send_frame();
+
+    /// Calls into the parent flow's barrier notify, but makes sure to only do
+    /// this once in the lifetime of *this.
+    void notify_barrier()
+    {
+        if (barrierOwned_)
+        {
+            barrierOwned_ = false;
+            device()->barrier_.notify();
+        }
+    }
+
+    /// @return the receive timestamp of the frame at index i in
+    /// nanoseconds, or 0 if there is none.
+    long long rx_timestamp(unsigned i);
+
+    /// Space for the ancillary data of one message (the timestamps).
+    static constexpr unsigned CMSG_SIZE = 64;
+
+    /// true iff pending parent->barrier_.notify()
+    bool barrierOwned_{true};
+    /// Helper object for waiting for the fd.
+    StateFlowSelectHelper selectHelper_{this};
+    /// Message headers for recvmmsg.
+    struct mmsghdr msgs_[MAX_BATCH];
+    /// One frame per message.
+    struct iovec iov_[MAX_BATCH];
+    /// Received frames.
+    struct can_frame frames_[MAX_BATCH];
+    /// Ancillary data (timestamps) per message.
+    uint8_t cmsg_[MAX_BATCH][CMSG_SIZE];
+    /// Number of messages returned by the last recvmmsg.
+    unsigned count_{0};
+    /// Index of the next message to send to the hub.
+    unsigned next_{0};
+    /// Number of successful recvmmsg calls.
+    size_t numReads_{0};
+    /// Number of frames received.
+    size_t numFrames_{0};
+    /// Receive latency samples.
+    LatencyHistogram rxLatency_;
+    /// Where do we forward the messages we created.
+    CanHubFlow::port_type *dst_;
+    /// What should be the source port designation.
+    CanHubFlow::port_type *skipMember_;
+};
+
+/// Hub port for a SocketCAN raw socket. Reads with recvmmsg() (see
+/// SocketCanReadFlow) and writes all frames queued for the port with one
+/// sendmmsg() call. Receive filters can be installed in the kernel so that
+/// frames nobody is interested in never reach userspace.
+///
+/// Usage:
+///   int fd = SocketCanHubPort::open_socket("can0");
+///   if (fd >= 0) new SocketCanHubPort(&can_hub, fd);
+class SocketCanHubPort : public HubDeviceSelect<CanHubFlow, SocketCanReadFlow>
+{
+public:
+    /// Creates a hub port for an open SocketCAN socket.
+    ///
+    /// @param hub the hub to open the port on
+    /// @param fd the socket. It can also be any datagram socket exchanging
+    /// struct can_frame records (e.g. a socketpair in tests).
+    /// @param on_error notifiable that will be called when a write or read
+    /// error is encountered.
+    SocketCanHubPort(CanHubFlow *hub, int fd, Notifiable *on_error = nullptr);
+
+    /// Opens a raw CAN socket on a network interface.
+    ///
+    /// @param ifname name of the interface, such as "can0" or "vcan0".
+    /// @param loopback 1 to let other sockets on this host see the frames we
+    /// send, 0 to not.
+    /// @return the socket, or -1 on error (errno set).
+    static int open_socket(const char *ifname, int loopback = 1);
+
+    /// Replaces the kernel receive filters of the socket. A frame is
+    /// delivered if it matches any of the filters, i.e. (can_id & mask) ==
+    /// (filter.can_id & mask). Error frames are not affected.
+    ///
+    /// @param filters the new filters. Empty accepts every frame.
+    /// @return true on success.
+    bool set_filters(const std::vector<struct can_filter> &filters);
+
+    /// @return latency samples of received frames. Must be accessed on the
+    /// executor of the hub.
+    LatencyHistogram *rx_latency()
+    {
+        return read_flow()->rx_latency();
+    }
+};
+
+#endif // __linux__
+
+#endif // _UTILS_SOCKETCANHUB_HXX_
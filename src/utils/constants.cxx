@@ -85,6 +85,20 @@
  * vs the overhead used by the framework.
  */
 
+/** @var _sym_executor_use_epoll
+ *
+ * @brief Whether the executors should use epoll (Linux only) instead of
+ * select to wait for file descriptors. Worth turning on for processes that
+ * watch many FDs, such as a hub with lots of TCP clients.
+ */
+
+/** @var _sym_main_buffer_pool_use_slab
+ *
+ * @brief Whether the main buffer pool should use power-of-two size classes
+ * with per-thread caches (SlabPool) instead of the four fixed buckets. Worth
+ * turning on for multi-threaded hosts, such as a MultiThreadExecutor.
+ */
+
 /** @var _sym_can_tx_buffer_size
  * @brief default software buffer size for CAN transmission
  */
@@ -131,6 +145,8 @@ DEFAULT_CONST(main_thread_priority, 0xdefa01);
 DEFAULT_CONST(main_thread_stack_size, 2048);
 DEFAULT_CONST(executor_max_sleep_msec, 40);
 DEFAULT_CONST(executor_select_prescaler, 5);
+DEFAULT_CONST_FALSE(executor_use_epoll);
+DEFAULT_CONST_FALSE(main_buffer_pool_use_slab);
 
 DEFAULT_CONST(can_tx_buffer_size, 16);
 DEFAULT_CONST(can_rx_buffer_size, 16);
@@ -34,10 +34,17 @@
 //#define LOGLEVEL VERBOSE
 
 #include <stdint.h>
+#include <string.h>
 #include "utils/logging.h"
 #include "utils/gc_format.h"
 #include "can_frame.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 extern "C" {
 
 /** Build an ASCII character representation of a nibble value (uppercase hex).
@@ -78,10 +85,117 @@ static int ascii_to_nibble(const char c)
     return -1;
 }
 
+/** Converts 16 hex characters (both upper and lowercase) to 8 bytes.
+    @param src is the characters to convert.
+    @param dst is where to write the bytes.
+    @return false if an invalid character was encountered.
+*/
+static bool hex16_to_bytes(const char *src, uint8_t *dst)
+{
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+    // Digits are 0..9 after subtracting '0'; letters are 0..5 after folding
+    // to lowercase and subtracting 'a'. Everything else is out of range.
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i a = _mm_sub_epi8(
+        _mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF)
+    {
+        return false;
+    }
+    __m128i nib = _mm_or_si128(_mm_and_si128(is_digit, d),
+        _mm_and_si128(is_alpha, _mm_add_epi8(a, _mm_set1_epi8(10))));
+    // Each 16-bit lane has the high nibble in its low byte and the low nibble
+    // in its high byte.
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0xff)), 4);
+    __m128i lo = _mm_srli_epi16(nib, 8);
+    __m128i bytes =
+        _mm_packus_epi16(_mm_or_si128(hi, lo), _mm_setzero_si128());
+    _mm_storel_epi64((__m128i *)dst, bytes);
+    return true;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t v = vld1q_u8((const uint8_t *)src);
+    uint8x16_t d = vsubq_u8(v, vdupq_n_u8('0'));
+    uint8x16_t is_digit = vcleq_u8(d, vdupq_n_u8(9));
+    uint8x16_t a =
+        vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t is_alpha = vcleq_u8(a, vdupq_n_u8(5));
+    if (vminvq_u8(vorrq_u8(is_digit, is_alpha)) == 0)
+    {
+        return false;
+    }
+    uint8x16_t nib = vbslq_u8(is_digit, d, vaddq_u8(a, vdupq_n_u8(10)));
+    uint8x8_t hi = vget_low_u8(vuzp1q_u8(nib, nib));
+    uint8x8_t lo = vget_low_u8(vuzp2q_u8(nib, nib));
+    vst1_u8(dst, vorr_u8(vshl_n_u8(hi, 4), lo));
+    return true;
+#else
+    for (int i = 0; i < 8; ++i)
+    {
+        int nh = ascii_to_nibble(src[2 * i]);
+        int nl = ascii_to_nibble(src[2 * i + 1]);
+        if (nh < 0 || nl < 0)
+        {
+            return false;
+        }
+        dst[i] = (nh << 4) | nl;
+    }
+    return true;
+#endif
+}
+
+/** Converts 8 bytes to 16 uppercase hex characters.
+    @param src is the bytes to convert.
+    @param dst is where to write the characters.
+*/
+static void bytes_to_hex16(const uint8_t *src, char *dst)
+{
+#if defined(__SSE2__)
+    __m128i b = _mm_loadl_epi64((const __m128i *)src);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), mask);
+    __m128i lo = _mm_and_si128(b, mask);
+    __m128i nib = _mm_unpacklo_epi8(hi, lo);
+    __m128i letter = _mm_and_si128(
+        _mm_cmpgt_epi8(nib, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    _mm_storeu_si128((__m128i *)dst,
+        _mm_add_epi8(_mm_add_epi8(nib, _mm_set1_epi8('0')), letter));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x8_t b = vld1_u8(src);
+    uint8x8x2_t z = vzip_u8(vshr_n_u8(b, 4), vand_u8(b, vdup_n_u8(0xf)));
+    uint8x16_t nib = vcombine_u8(z.val[0], z.val[1]);
+    uint8x16_t letter =
+        vandq_u8(vcgtq_u8(nib, vdupq_n_u8(9)), vdupq_n_u8('A' - '0' - 10));
+    vst1q_u8((uint8_t *)dst,
+        vaddq_u8(vaddq_u8(nib, vdupq_n_u8('0')), letter));
+#else
+    for (int i = 0; i < 8; ++i)
+    {
+        dst[2 * i] = nibble_to_ascii(src[i] >> 4);
+        dst[2 * i + 1] = nibble_to_ascii(src[i] & 0xf);
+    }
+#endif
+}
 
 int gc_format_parse(const char* buf, struct can_frame* can_frame)
 {
+    return gc_format_parse_packet(buf, strlen(buf), can_frame);
+}
+
+int gc_format_parse_packet(
+    const char *buf, unsigned len, struct can_frame *can_frame)
+{
+    const char *end = buf + len;
+    // Clears the ID bits that the ID parsing below would not overwrite.
+    can_frame->can_id = 0;
     CLR_CAN_FRAME_ERR(*can_frame);
+    if (buf == end)
+    {
+        SET_CAN_FRAME_ERR(*can_frame);
+        return -1;
+    }
     if (*buf == 'X')
     {
         SET_CAN_FRAME_EFF(*can_frame);
@@ -99,6 +213,12 @@ int gc_format_parse(const char* buf, struct can_frame* can_frame)
     uint32_t id = 0;
     while (1)
     {
+        if (buf == end)
+        {
+            // Packet ended within the ID.
+            SET_CAN_FRAME_ERR(*can_frame);
+            return -1;
+        }
         int nibble = ascii_to_nibble(*buf);
         if (nibble >= 0)
         {
@@ -135,19 +255,37 @@ int gc_format_parse(const char* buf, struct can_frame* can_frame)
     { 
         SET_CAN_FRAME_ID(*can_frame, id);
     }
-    int index = 0;
-    while (*buf)
+    unsigned data_len = end - buf;
+    if ((data_len & 1) || data_len > 16)
     {
-        int nh = ascii_to_nibble(*buf++);
-        int nl = ascii_to_nibble(*buf++);
-        if (nh < 0 || nl < 0)
+        // Odd number of hex characters or more than 8 bytes.
+        SET_CAN_FRAME_ERR(*can_frame);
+        return -1;
+    }
+    if (data_len == 16)
+    {
+        if (!hex16_to_bytes(buf, can_frame->data))
         {
             SET_CAN_FRAME_ERR(*can_frame);
             return -1;
         }
-        can_frame->data[index++] = (nh << 4) | nl;
-    } // while parsing data
-    can_frame->can_dlc = index;
+    }
+    else
+    {
+        int index = 0;
+        while (buf < end)
+        {
+            int nh = ascii_to_nibble(*buf++);
+            int nl = ascii_to_nibble(*buf++);
+            if (nh < 0 || nl < 0)
+            {
+                SET_CAN_FRAME_ERR(*can_frame);
+                return -1;
+            }
+            can_frame->data[index++] = (nh << 4) | nl;
+        } // while parsing data
+    }
+    can_frame->can_dlc = data_len / 2;
     CLR_CAN_FRAME_ERR(*can_frame);
     return 0;
 }
@@ -236,10 +374,18 @@ char* gc_format_generate(const struct can_frame* can_frame, char* buf, int doubl
     {
         output(buf, 'N');
     }
-    for (offset = 0; offset < can_frame->can_dlc; ++offset)
+    if (!double_format && can_frame->can_dlc == 8)
     {
-        output(buf, nibble_to_ascii(can_frame->data[offset] >> 4));
-        output(buf, nibble_to_ascii(can_frame->data[offset] & 0xf));
+        bytes_to_hex16(can_frame->data, buf);
+        buf += 16;
+    }
+    else
+    {
+        for (offset = 0; offset < can_frame->can_dlc; ++offset)
+        {
+            output(buf, nibble_to_ascii(can_frame->data[offset] >> 4));
+            output(buf, nibble_to_ascii(can_frame->data[offset] & 0xf));
+        }
     }
     output(buf, ';');
     if (config_gc_generate_newlines()) {
@@ -248,4 +394,65 @@ char* gc_format_generate(const struct can_frame* can_frame, char* buf, int doubl
     return buf;
 }
 
+char *gc_format_generate_frames(const struct can_frame *frames, unsigned count,
+    char *buf, int double_format)
+{
+    if (double_format)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            buf = gc_format_generate(frames + i, buf, double_format);
+        }
+        return buf;
+    }
+    bool newlines = config_gc_generate_newlines();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const struct can_frame *f = frames + i;
+        if (IS_CAN_FRAME_ERR(*f))
+        {
+            continue;
+        }
+        *buf++ = ':';
+        uint32_t id;
+        int offset;
+        if (IS_CAN_FRAME_EFF(*f))
+        {
+            id = GET_CAN_FRAME_ID_EFF(*f);
+            *buf++ = 'X';
+            offset = 28;
+        }
+        else
+        {
+            id = GET_CAN_FRAME_ID(*f);
+            *buf++ = 'S';
+            offset = 8;
+        }
+        for (; offset >= 0; offset -= 4)
+        {
+            *buf++ = nibble_to_ascii(id >> offset);
+        }
+        *buf++ = IS_CAN_FRAME_RTR(*f) ? 'R' : 'N';
+        if (f->can_dlc == 8)
+        {
+            bytes_to_hex16(f->data, buf);
+            buf += 16;
+        }
+        else
+        {
+            for (offset = 0; offset < f->can_dlc; ++offset)
+            {
+                *buf++ = nibble_to_ascii(f->data[offset] >> 4);
+                *buf++ = nibble_to_ascii(f->data[offset] & 0xf);
+            }
+        }
+        *buf++ = ';';
+        if (newlines)
+        {
+            *buf++ = '\n';
+        }
+    }
+    return buf;
+}
+
 }
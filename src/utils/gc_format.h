@@ -60,6 +60,21 @@ DECLARE_CONST(gc_generate_newlines);
 */
 int gc_format_parse(const char* buf, struct can_frame* can_frame);
 
+/** Parses a GridConnect packet that is not zero-terminated.
+
+    @param buf points to the first character after the leading ':'.
+
+    @param len is the number of characters before the trailing ';'.
+
+    @param can_frame is the CAN frame that will be filled based on the source
+    packet.
+
+    @return 0 in case of success, -1 if there was a packet format error (in
+    this case the frame is set to an error frame).
+*/
+int gc_format_parse_packet(
+    const char *buf, unsigned len, struct can_frame *can_frame);
+
 /** Formats a can frame in the GridConnect protocol.
 
     If requested, it can create the double protocol with leading !!, trailing ;;
@@ -79,6 +94,29 @@ int gc_format_parse(const char* buf, struct can_frame* can_frame);
 */
 char* gc_format_generate(const struct can_frame* can_frame, char* buf, int double_format);
 
+/// Maximum number of characters gc_format_generate writes for a frame in the
+/// single format, including the newline.
+#define GC_FORMAT_MAX_FRAME_LENGTH 29
+
+/** Formats an array of can frames in the GridConnect protocol, back to back
+    into one buffer. Error frames are skipped.
+
+    @param frames is the input frames.
+
+    @param count is the number of frames.
+
+    @param buf is the output buffer. The caller must ensure this is big enough
+    to hold count * GC_FORMAT_MAX_FRAME_LENGTH bytes (twice that for the
+    double format).
+
+    @param double_format if non-zero, the doubling format will be generated.
+
+    @return the pointer to the buffer character after the last formatted can
+    frame.
+*/
+char *gc_format_generate_frames(const struct can_frame *frames, unsigned count,
+    char *buf, int double_format);
+
 #ifdef __cplusplus
 }
 #endif